@@ -0,0 +1,20 @@
+TEMPLATE = app
+TARGET = kubach
+DEPENDPATH += .
+INCLUDEPATH += .
+
+QMAKE_CXXFLAGS += -std=c++0x -O3 -DGL_GLEXT_PROTOTYPES
+QT += core gui opengl
+LIBS += -lGLU
+
+include(../core/core.pri)
+
+# Input
+HEADERS += main_window.h render.h \
+    entity_renderer.h \
+    debris_renderer.h \
+    chunk_renderer.h
+SOURCES += main.cpp main_window.cpp render.cpp \
+    entity_renderer.cpp \
+    debris_renderer.cpp \
+    chunk_renderer.cpp
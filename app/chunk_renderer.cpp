@@ -0,0 +1,259 @@
+#include "chunk_renderer.h"
+#include "memory_stats.h"
+
+#include <QtOpenGL>
+
+#include <GL/gl.h>
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/glext.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+// Vertices the buffer starts with; it doubles whenever a mesh doesn't fit
+static const std::size_t initial_capacity = 1 << 16;
+
+static bool supports_indirect ( )
+{
+    const char * version = reinterpret_cast<const char *>(glGetString(GL_VERSION));
+    int major = 0, minor = 0;
+    if (version && std::sscanf(version, "%d.%d", &major, &minor) == 2 && (major > 4 || (major == 4 && minor >= 3)))
+        return true;
+
+    const char * extensions = reinterpret_cast<const char *>(glGetString(GL_EXTENSIONS));
+    return extensions && std::strstr(extensions, "GL_ARB_multi_draw_indirect");
+}
+
+chunk_renderer::chunk_renderer ( )
+    : indirect(false)
+    , vertex_buffer(0)
+    , command_buffer(0)
+    , command_bytes(0)
+    , layout_changed(true)
+    , has_eye_cell(false)
+{
+    stats_.chunks = stats_.uploaded = stats_.commands = stats_.rebuilds = 0;
+    stats_.buffer_bytes = stats_.used_bytes = 0;
+    stats_.indirect = false;
+}
+
+void chunk_renderer::init ( )
+{
+    indirect = supports_indirect();
+    stats_.indirect = indirect;
+
+    glGenBuffers(1, &command_buffer);
+    reserve(initial_capacity);
+}
+
+void chunk_renderer::reserve (std::size_t vertices)
+{
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertices * sizeof(vertex), nullptr, GL_DYNAMIC_DRAW);
+
+    // The ranges keep their offsets, so the old contents are copied over
+    // on the GPU
+    std::size_t old_bytes = ranges.capacity() * sizeof(vertex);
+    if (vertex_buffer != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, vertex_buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &vertex_buffer);
+        memory_freed(memory_gpu, old_bytes);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    vertex_buffer = buffer;
+    ranges.grow(vertices);
+    memory_allocated(memory_gpu, vertices * sizeof(vertex));
+}
+
+void chunk_renderer::upload (slot & s, const chunk_mesh & m)
+{
+    if (s.count > 0)
+        ranges.free(s.first, s.count);
+
+    s.version = m.version;
+    s.count = m.vertices.size();
+    s.first = 0;
+    if (s.count == 0)
+        return;
+
+    s.first = ranges.allocate(s.count);
+    if (s.first == range_allocator::none)
+    {
+        reserve(std::max(ranges.capacity() * 2, ranges.capacity() + s.count));
+        s.first = ranges.allocate(s.count);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, s.first * sizeof(vertex), s.count * sizeof(vertex), m.vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ++stats_.uploaded;
+}
+
+void chunk_renderer::update (const mesh_cache & meshes, double eye_x, double eye_y, double eye_z, frame_arena & arena)
+{
+    translucent.clear();
+
+    // Both maps are ordered the same way
+    auto s = placed_meshes.begin();
+    for (auto const & m : meshes.meshes())
+    {
+        while (s != placed_meshes.end() && s->first < m.first)
+        {
+            ranges.free(s->second.first, s->second.count);
+            s = placed_meshes.erase(s);
+            layout_changed = true;
+        }
+
+        if (s == placed_meshes.end() || !(s->first == m.first))
+        {
+            slot fresh;
+            fresh.first = fresh.count = 0;
+            fresh.version = 0;
+            s = placed_meshes.insert(s, std::make_pair(m.first, fresh));
+        }
+
+        if (s->second.version != m.second.version)
+        {
+            upload(s->second, m.second);
+            layout_changed = true;
+        }
+
+        if (m.second.translucent > 0)
+        {
+            double dx = (m.first.x + 0.5) * chunk_size - eye_x, dy = (m.first.y + 0.5) * chunk_size - eye_y, dz = (m.first.z + 0.5) * chunk_size - eye_z;
+            translucent_draw d;
+            d.distance = dx * dx + dy * dy + dz * dz;
+            d.count = m.second.indices.size();
+            d.indices = m.second.indices.data();
+            d.base = s->second.first;
+            translucent.push_back(d);
+        }
+        ++s;
+    }
+    while (s != placed_meshes.end())
+    {
+        ranges.free(s->second.first, s->second.count);
+        s = placed_meshes.erase(s);
+        layout_changed = true;
+    }
+
+    // Back to front, so they blend over what is behind them
+    std::sort(translucent.begin(), translucent.end(), [](const translucent_draw & a, const translucent_draw & b){ return a.distance > b.distance; });
+    translucent_counts.clear();
+    translucent_indices.clear();
+    translucent_bases.clear();
+    for (translucent_draw const & d : translucent)
+    {
+        translucent_counts.push_back(d.count);
+        translucent_indices.push_back(d.indices);
+        translucent_bases.push_back(d.base);
+    }
+
+    // faces_eye only changes its mind when the eye crosses a chunk border
+    int cell[3] = {
+        static_cast<int>(std::floor((eye_x + 0.5) / chunk_size)),
+        static_cast<int>(std::floor((eye_y + 0.5) / chunk_size)),
+        static_cast<int>(std::floor((eye_z + 0.5) / chunk_size))
+    };
+    if (layout_changed || !has_eye_cell || !std::equal(cell, cell + 3, eye_cell))
+    {
+        rebuild(meshes, eye_x, eye_y, eye_z, arena);
+        std::copy(cell, cell + 3, eye_cell);
+        has_eye_cell = true;
+        layout_changed = false;
+    }
+
+    stats_.chunks = placed_meshes.size();
+    stats_.buffer_bytes = ranges.capacity() * sizeof(vertex);
+    stats_.used_bytes = ranges.used() * sizeof(vertex);
+}
+
+void chunk_renderer::rebuild (const mesh_cache & meshes, double eye_x, double eye_y, double eye_z, frame_arena & arena)
+{
+    // Every mesh has its slot now, in the same order
+    arena_vector<std::size_t> slot_firsts{arena_allocator<std::size_t>(arena)};
+    slot_firsts.reserve(placed_meshes.size());
+    for (auto const & s : placed_meshes)
+        slot_firsts.push_back(s.second.first);
+
+    build_draw_commands(meshes, slot_firsts.data(), eye_x, eye_y, eye_z, arena, commands);
+
+    firsts.clear();
+    counts.clear();
+    for (draw_command const & c : commands)
+    {
+        firsts.push_back(c.first);
+        counts.push_back(c.count);
+    }
+
+    if (indirect)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(draw_command), commands.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        if (command_bytes > 0)
+            memory_freed(memory_gpu, command_bytes);
+        command_bytes = commands.size() * sizeof(draw_command);
+        memory_allocated(memory_gpu, command_bytes);
+    }
+
+    stats_.commands = commands.size();
+    ++stats_.rebuilds;
+}
+
+void chunk_renderer::bind_vertices ( ) const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    glVertexPointer(3, GL_FLOAT, sizeof(vertex), reinterpret_cast<void *>(offsetof(vertex, position)));
+    glTexCoordPointer(3, GL_FLOAT, sizeof(vertex), reinterpret_cast<void *>(offsetof(vertex, tex_coord)));
+    glNormalPointer(GL_FLOAT, sizeof(vertex), reinterpret_cast<void *>(offsetof(vertex, normal)));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(vertex), reinterpret_cast<void *>(offsetof(vertex, color)));
+}
+
+void chunk_renderer::draw_opaque ( ) const
+{
+    if (commands.empty())
+        return;
+
+    bind_vertices();
+    if (indirect)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+        glMultiDrawArraysIndirect(GL_QUADS, nullptr, commands.size(), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else
+        glMultiDrawArrays(GL_QUADS, firsts.data(), counts.data(), firsts.size());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void chunk_renderer::draw_translucent ( ) const
+{
+    if (translucent_counts.empty())
+        return;
+
+    // The indices stay in client memory, since sorting changes them often
+    bind_vertices();
+    glMultiDrawElementsBaseVertex(GL_QUADS, translucent_counts.data(), GL_UNSIGNED_INT, translucent_indices.data(),
+        translucent_counts.size(), translucent_bases.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+chunk_renderer::statistics chunk_renderer::take_stats ( )
+{
+    statistics result = stats_;
+    stats_.uploaded = 0;
+    stats_.rebuilds = 0;
+    return result;
+}
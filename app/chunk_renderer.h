@@ -0,0 +1,99 @@
+#ifndef CHUNK_RENDERER_H
+#define CHUNK_RENDERER_H
+
+#include "mesh.h"
+#include "face_mesher.h"
+#include "range_allocator.h"
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Keeps the meshes of all chunks in one vertex buffer, each in a range
+// of its own, and draws all opaque faces with one multi-draw call. The
+// commands only change when a mesh does or when the eye moves into
+// another chunk, which is what decides which face groups face it; they
+// are then sorted front to back and, where glMultiDrawArraysIndirect is
+// available, uploaded once to an indirect buffer.
+class chunk_renderer
+{
+public:
+    struct statistics
+    {
+        std::size_t chunks;
+        std::size_t uploaded;
+        std::size_t commands;
+        std::size_t rebuilds;
+        std::size_t buffer_bytes;
+        std::size_t used_bytes;
+        bool indirect;
+    };
+
+    chunk_renderer ( );
+
+    // Needs a current GL context
+    void init ( );
+
+    // Uploads the meshes that changed since the last call, drops those of
+    // chunks that are gone, and rebuilds the commands if needed. Call
+    // after mesh_cache::sort_translucent. Sorting the commands takes its
+    // scratch from arena.
+    void update (const mesh_cache & meshes, double eye_x, double eye_y, double eye_z, frame_arena & arena);
+
+    // Use the current program, textures and matrices
+    void draw_opaque ( ) const;
+    void draw_translucent ( ) const;
+
+    // Counters are for everything since the last call
+    statistics take_stats ( );
+
+private:
+    typedef packed_vertex vertex;
+
+    struct slot
+    {
+        std::size_t first;
+        std::size_t count;
+        std::uint64_t version;
+    };
+
+    bool indirect;
+    unsigned int vertex_buffer;
+    unsigned int command_buffer;
+    std::size_t command_bytes;
+    range_allocator ranges;
+
+    std::map<chunk_position, slot> placed_meshes;
+
+    bool layout_changed;
+    bool has_eye_cell;
+    int eye_cell[3];
+
+    std::vector<draw_command> commands;
+    std::vector<int> firsts;
+    std::vector<int> counts;
+
+    struct translucent_draw
+    {
+        double distance;
+        int count;
+        const void * indices;
+        int base;
+    };
+
+    // Rebuilt every update, as sorting moves faces
+    std::vector<translucent_draw> translucent;
+    std::vector<int> translucent_counts;
+    std::vector<const void *> translucent_indices;
+    std::vector<int> translucent_bases;
+
+    statistics stats_;
+
+    void reserve (std::size_t vertices);
+    void upload (slot & s, const chunk_mesh & m);
+    void rebuild (const mesh_cache & meshes, double eye_x, double eye_y, double eye_z, frame_arena & arena);
+    void bind_vertices ( ) const;
+};
+
+#endif // CHUNK_RENDERER_H
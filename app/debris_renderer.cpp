@@ -0,0 +1,155 @@
+#include "debris_renderer.h"
+#include "memory_stats.h"
+#include "render.h"
+
+#include <QtOpenGL>
+
+#include <GL/gl.h>
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/glext.h>
+
+#include <vector>
+
+enum attribute
+{
+    attribute_position = 1,
+    attribute_normal = 2,
+    attribute_x = 3,
+    attribute_y = 4,
+    attribute_z = 5,
+    attribute_life = 6,
+    attribute_color = 7
+};
+
+debris_renderer::debris_renderer ( )
+    : program(0)
+    , mesh_buffer(0)
+    , instance_buffer(0)
+    , vertex_count(0)
+    , count(0)
+    , instance_bytes(0)
+{ }
+
+void debris_renderer::init ( )
+{
+    std::vector<float> mesh;
+    box_triangles(-1, -1, -1, 1, 1, 1, mesh);
+    vertex_count = mesh.size() / 6;
+
+    glGenBuffers(1, &mesh_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer);
+    glBufferData(GL_ARRAY_BUFFER, mesh.size() * sizeof(float), mesh.data(), GL_STATIC_DRAW);
+    memory_allocated(memory_gpu, mesh.size() * sizeof(float));
+
+    glGenBuffers(1, &instance_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Particles shrink away during their last second
+    const char * vertex_shader_code = "\
+    #version 120\n\
+    attribute vec3 position; \
+    attribute vec3 normal; \
+    attribute float x; \
+    attribute float y; \
+    attribute float z; \
+    attribute float life; \
+    attribute vec4 instance_color; \
+    varying vec4 color; \
+    void main() { \
+        float size = 0.12 * clamp(life, 0.0, 1.0); \
+        gl_Position = gl_ModelViewProjectionMatrix * vec4(position * size + vec3(x, y, z), 1.0); \
+        float light = 0.6 + 0.4 * abs(dot(normal, normalize(vec3(0.3, 1.0, 0.5)))); \
+        color = vec4(instance_color.rgb * light, instance_color.a); \
+    }";
+    const char * fragment_shader_code = "\
+    varying vec4 color; \
+    void main() { \
+        gl_FragColor = color; \
+    }";
+
+    program = compile_program("Debris", vertex_shader_code, fragment_shader_code);
+
+    glBindAttribLocation(program, attribute_position, "position");
+    glBindAttribLocation(program, attribute_normal, "normal");
+    glBindAttribLocation(program, attribute_x, "x");
+    glBindAttribLocation(program, attribute_y, "y");
+    glBindAttribLocation(program, attribute_z, "z");
+    glBindAttribLocation(program, attribute_life, "life");
+    glBindAttribLocation(program, attribute_color, "instance_color");
+
+    link_program("Debris", program);
+}
+
+void debris_renderer::upload (const debris & d)
+{
+    count = d.size();
+    if (count == 0)
+        return;
+
+    std::size_t floats = count * sizeof(float);
+    std::size_t bytes = 4 * floats + count * sizeof(std::uint32_t);
+
+    // Respecifying the whole store lets the driver hand out fresh memory
+    // instead of waiting for the previous frame to finish with it
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0 * floats, floats, d.x());
+    glBufferSubData(GL_ARRAY_BUFFER, 1 * floats, floats, d.y());
+    glBufferSubData(GL_ARRAY_BUFFER, 2 * floats, floats, d.z());
+    glBufferSubData(GL_ARRAY_BUFFER, 3 * floats, floats, d.life());
+    glBufferSubData(GL_ARRAY_BUFFER, 4 * floats, count * sizeof(std::uint32_t), d.colors());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (instance_bytes > 0)
+        memory_freed(memory_gpu, instance_bytes);
+    instance_bytes = bytes;
+    memory_allocated(memory_gpu, instance_bytes);
+}
+
+void debris_renderer::draw ( ) const
+{
+    if (count == 0)
+        return;
+
+    // The world is drawn from client-side arrays; keep them out of the way
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+
+    glUseProgram(program);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer);
+    glEnableVertexAttribArray(attribute_position);
+    glEnableVertexAttribArray(attribute_normal);
+    glVertexAttribPointer(attribute_position, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), reinterpret_cast<void *>(0));
+    glVertexAttribPointer(attribute_normal, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), reinterpret_cast<void *>(3 * sizeof(float)));
+
+    const int per_instance[5] = {attribute_x, attribute_y, attribute_z, attribute_life, attribute_color};
+    std::size_t floats = count * sizeof(float);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    for (int a = 0; a < 4; ++a)
+        glVertexAttribPointer(per_instance[a], 1, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void *>(a * floats));
+    glVertexAttribPointer(attribute_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, reinterpret_cast<void *>(4 * floats));
+    for (int attribute : per_instance)
+    {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+
+    glDrawArraysInstanced(GL_TRIANGLES, 0, vertex_count, count);
+
+    for (int attribute : per_instance)
+    {
+        glVertexAttribDivisor(attribute, 0);
+        glDisableVertexAttribArray(attribute);
+    }
+    glDisableVertexAttribArray(attribute_position);
+    glDisableVertexAttribArray(attribute_normal);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glPopClientAttrib();
+}
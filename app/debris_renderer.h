@@ -0,0 +1,35 @@
+#ifndef DEBRIS_RENDERER_H
+#define DEBRIS_RENDERER_H
+
+#include "debris.h"
+
+#include <cstddef>
+
+// Draws debris as small cubes with a single instanced draw call. The
+// particle arrays are copied into one buffer as they are, one after the
+// other, and every array feeds its own attribute, so nothing is
+// interleaved on the CPU.
+class debris_renderer
+{
+public:
+    debris_renderer ( );
+
+    // Needs a current GL context
+    void init ( );
+
+    void upload (const debris & d);
+
+    // Uses the current modelview and projection matrices
+    void draw ( ) const;
+
+private:
+    unsigned int program;
+    unsigned int mesh_buffer;
+    unsigned int instance_buffer;
+    int vertex_count;
+
+    std::size_t count;
+    std::size_t instance_bytes;
+};
+
+#endif // DEBRIS_RENDERER_H
@@ -0,0 +1,152 @@
+#include "entity_renderer.h"
+#include "player.h"
+#include "memory_stats.h"
+#include "render.h"
+
+#include <QtOpenGL>
+
+#include <GL/gl.h>
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/glext.h>
+
+const int entity_renderer::floats_per_instance;
+
+enum attribute
+{
+    attribute_position = 1,
+    attribute_normal = 2,
+    attribute_instance_position = 3,
+    attribute_instance_color = 4
+};
+
+entity_renderer::entity_renderer ( )
+    : program(0)
+    , mesh_buffer(0)
+    , instance_buffer(0)
+    , vertex_count(0)
+    , instance_bytes(0)
+    , count(0)
+{ }
+
+void entity_renderer::init ( )
+{
+    std::vector<float> mesh;
+    // Local axes: -z is where the entity looks, like the player
+    box_triangles(-player::size_x, -player::size_y_bottom, -player::size_z, player::size_x, player::size_y_top, player::size_z, mesh);
+    vertex_count = mesh.size() / 6;
+
+    glGenBuffers(1, &mesh_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer);
+    glBufferData(GL_ARRAY_BUFFER, mesh.size() * sizeof(float), mesh.data(), GL_STATIC_DRAW);
+    memory_allocated(memory_gpu, mesh.size() * sizeof(float));
+
+    glGenBuffers(1, &instance_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    const char * vertex_shader_code = "\
+    #version 120\n\
+    attribute vec3 position; \
+    attribute vec3 normal; \
+    attribute vec4 instance_position; \
+    attribute vec4 instance_color; \
+    varying vec4 color; \
+    void main() { \
+        float c = cos(instance_position.w); \
+        float s = sin(instance_position.w); \
+        vec3 p = vec3(position.x * c - position.z * s, position.y, position.x * s + position.z * c); \
+        vec3 n = vec3(normal.x * c - normal.z * s, normal.y, normal.x * s + normal.z * c); \
+        gl_Position = gl_ModelViewProjectionMatrix * vec4(p + instance_position.xyz, 1.0); \
+        float light = 0.6 + 0.4 * abs(dot(n, normalize(vec3(0.3, 1.0, 0.5)))); \
+        if (normal.z < -0.5) light *= 0.5; \
+        color = vec4(instance_color.rgb * light, instance_color.a); \
+    }";
+    const char * fragment_shader_code = "\
+    varying vec4 color; \
+    void main() { \
+        gl_FragColor = color; \
+    }";
+
+    program = compile_program("Entity", vertex_shader_code, fragment_shader_code);
+
+    glBindAttribLocation(program, attribute_position, "position");
+    glBindAttribLocation(program, attribute_normal, "normal");
+    glBindAttribLocation(program, attribute_instance_position, "instance_position");
+    glBindAttribLocation(program, attribute_instance_color, "instance_color");
+
+    link_program("Entity", program);
+}
+
+void entity_renderer::clear ( )
+{
+    instances.clear();
+    count = 0;
+}
+
+void entity_renderer::add (const kubeman & k, const color & c)
+{
+    const float instance[floats_per_instance] = {
+        float(k.x), float(k.y), float(k.z), float(k.alpha),
+        float(c.data[0]), float(c.data[1]), float(c.data[2]), float(c.data[3])
+    };
+    instances.insert(instances.end(), instance, instance + floats_per_instance);
+    ++count;
+}
+
+void entity_renderer::upload ( )
+{
+    if (count == 0)
+        return;
+
+    // Respecifying the whole store lets the driver hand out fresh memory
+    // instead of waiting for the previous frame to finish with it
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(float), instances.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (instance_bytes > 0)
+        memory_freed(memory_gpu, instance_bytes);
+    instance_bytes = instances.size() * sizeof(float);
+    memory_allocated(memory_gpu, instance_bytes);
+}
+
+void entity_renderer::draw ( ) const
+{
+    if (count == 0)
+        return;
+
+    // The world is drawn from client-side arrays; keep them out of the way
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+
+    glUseProgram(program);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer);
+    glEnableVertexAttribArray(attribute_position);
+    glEnableVertexAttribArray(attribute_normal);
+    glVertexAttribPointer(attribute_position, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), reinterpret_cast<void *>(0));
+    glVertexAttribPointer(attribute_normal, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), reinterpret_cast<void *>(3 * sizeof(float)));
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    glEnableVertexAttribArray(attribute_instance_position);
+    glEnableVertexAttribArray(attribute_instance_color);
+    glVertexAttribPointer(attribute_instance_position, 4, GL_FLOAT, GL_FALSE, floats_per_instance * sizeof(float), reinterpret_cast<void *>(0));
+    glVertexAttribPointer(attribute_instance_color, 4, GL_FLOAT, GL_FALSE, floats_per_instance * sizeof(float), reinterpret_cast<void *>(4 * sizeof(float)));
+    glVertexAttribDivisor(attribute_instance_position, 1);
+    glVertexAttribDivisor(attribute_instance_color, 1);
+
+    glDrawArraysInstanced(GL_TRIANGLES, 0, vertex_count, count);
+
+    glVertexAttribDivisor(attribute_instance_position, 0);
+    glVertexAttribDivisor(attribute_instance_color, 0);
+    glDisableVertexAttribArray(attribute_position);
+    glDisableVertexAttribArray(attribute_normal);
+    glDisableVertexAttribArray(attribute_instance_position);
+    glDisableVertexAttribArray(attribute_instance_color);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glPopClientAttrib();
+}
@@ -0,0 +1,44 @@
+#ifndef ENTITY_RENDERER_H
+#define ENTITY_RENDERER_H
+
+#include "cube.h"
+#include "kubeman.h"
+
+#include <vector>
+
+// Draws all entities as player-sized boxes with a single instanced draw
+// call: the box mesh lives in one buffer, the per-entity position, heading
+// and colour in another one that is refilled once per frame.
+class entity_renderer
+{
+public:
+    entity_renderer ( );
+
+    // Needs a current GL context
+    void init ( );
+
+    void clear ( );
+    void add (const kubeman & k, const color & c);
+    void upload ( );
+
+    // Uses the current modelview and projection matrices
+    void draw ( ) const;
+
+    std::size_t size ( ) const { return count; }
+
+private:
+    static const int floats_per_instance = 8;
+
+    unsigned int program;
+    unsigned int mesh_buffer;
+    unsigned int instance_buffer;
+    int vertex_count;
+
+    // Last size of the instance buffer, for memory_gpu
+    std::size_t instance_bytes;
+
+    std::vector<float> instances;
+    std::size_t count;
+};
+
+#endif // ENTITY_RENDERER_H
@@ -0,0 +1,50 @@
+#include "main_window.h"
+#include <QApplication>
+
+#include <QGLFormat>
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+
+    bool vsync = true;
+    for (int i = 1; i < argc; ++i)
+        if (std::strcmp(argv[i], "--no-vsync") == 0)
+            vsync = false;
+
+    // Has to be set before the window creates its context
+    QGLFormat format = QGLFormat::defaultFormat();
+    format.setSwapInterval(vsync ? 1 : 0);
+    QGLFormat::setDefaultFormat(format);
+
+    main_window w;
+
+    // With vsync the swaps pace the frames, unless a rate is given
+    w.set_frame_rate(vsync ? 0.0 : 60.0);
+
+    std::string heightmap, colors;
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--heightmap") == 0)
+            heightmap = argv[i + 1];
+        else if (std::strcmp(argv[i], "--colors") == 0)
+            colors = argv[i + 1];
+        else if (std::strcmp(argv[i], "--connect") == 0)
+            w.connect_to(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--fps") == 0)
+            w.set_frame_rate(std::atof(argv[i + 1]));
+        else if (std::strcmp(argv[i], "--memory-log") == 0)
+            w.set_memory_log(std::atof(argv[i + 1]));
+    }
+
+    if (!heightmap.empty())
+        w.import_terrain(heightmap, colors);
+
+    //w.showFullScreen();
+    w.show();
+    return app.exec();
+}
@@ -0,0 +1,1248 @@
+#include "main_window.h"
+#include "generator.h"
+#include "heightmap_import.h"
+#include "physics.h"
+#include "mesh.h"
+#include "render.h"
+#include "minimap.h"
+#include "raycast.h"
+#include "region.h"
+
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QApplication>
+#include <QTimer>
+
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <iostream>
+
+#include <GL/gl.h>
+#include <GL/glu.h>
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/glext.h>
+
+#include <cmath>
+
+main_window::main_window(QGLWidget *parent)
+    : QGLWidget (parent)
+    , cells(terrain, workers)
+{
+    QApplication::setOverrideCursor(Qt::BlankCursor);
+    setMouseTracking(true);
+
+    setFixedSize(600, 200);
+
+    randomf = std::bind(std::uniform_real_distribution<double>(0.0, 1.0), std::default_random_engine());
+
+    int start = (-1) << 0;
+
+    hue = 0.0;
+    brightness = 0.4;
+
+    generate_world(terrain, world_size, start, discrete_hue(), discrete_brightness());
+    terrain.share_identical();
+
+    std::cout << terrain.size() << '\n';
+
+    brightness = 1.0 + 0.5 / sphere_y;
+    hue = -3.0 / sphere_x;
+
+    sphere_hue = hue;
+    sphere_brightness = brightness;
+
+    pl.x = world_size * 0.5;
+    pl.z = world_size * 0.5;
+    pl.y = standing_height(terrain, pl.x, pl.z, start + 10);
+    pl.vy = 0.0;
+    pl.init();
+
+    has_chosen_plane = false;
+    has_selection[0] = has_selection[1] = false;
+    show_minimap = true;
+
+    simulation_time = 0.0;
+    current_material = material_cube;
+    chunks_rebuilt = 0;
+    autosave_time = 0.0;
+    unsaved_changes = journal_reader(terrain.journal());
+    unsaved = true;
+
+    enable_gravity = true;
+    on_surface = false;
+
+    rainbow = false;
+
+    health = 1.0;
+
+    spawned = false;
+    jump_requested = false;
+
+    cursor_centered = false;
+    input_pending = false;
+    latency_sum = latency_max = 0.0;
+    latency_samples = 0;
+
+    last_frame = 0.0;
+    frames_since_title = 0;
+    memory_log_interval = 0.0;
+    memory_log_time = 0.0;
+
+    // paintGL swaps itself, right after drawing
+    setAutoBufferSwap(false);
+    render_paused = false;
+    step_timer = startTimer(0);
+}
+
+void main_window::set_frame_rate (double rate)
+{
+    scheduler.set_frame_rate(rate);
+}
+
+void main_window::set_memory_log (double seconds)
+{
+    memory_log_interval = seconds;
+    memory_log_time = 0.0;
+}
+
+bool main_window::import_terrain (const std::string & heightmap, const std::string & colors)
+{
+    if (connection)
+        return false;
+
+    heightmap_import_options o;
+    o.colors = colors;
+
+    terrain.clear();
+    heightmap_import_statistics s;
+    bool ok = import_heightmap(terrain, workers, heightmap, o, s);
+    std::cout << (ok ? "imported " : "importing failed after ") << s.chunks << " chunks, " << s.cubes << " cubes of "
+        << heightmap << " in " << s.total_ms << " ms" << std::endl;
+
+    // Nothing was read, so the generated terrain comes back
+    if (s.bands == 0)
+        generate_world(terrain, world_size, o.base_height, o.hue, o.brightness);
+    terrain.share_identical();
+
+    int size_x = s.bands > 0 ? s.width : world_size, size_z = s.bands > 0 ? s.height : world_size;
+    pl.x = size_x * 0.5;
+    pl.z = size_z * 0.5;
+    pl.y = standing_height(terrain, pl.x, pl.z, o.base_height + o.height_range + 10);
+    pl.vy = 0.0;
+    pl.init();
+    return ok;
+}
+
+main_window::~main_window()
+{ }
+
+void main_window::initializeGL ( )
+{
+    // Without vsync, drawing as fast as swaps allow would use a whole core
+    if (format().swapInterval() <= 0 && scheduler.frame_rate() == 0.0)
+        scheduler.set_frame_rate(60.0);
+
+    glDepthFunc(GL_LEQUAL);
+
+    texture_array textures;
+    generate_material_textures(workers, texture_size, textures);
+
+    glGenTextures(1, &texture_id);
+
+    glActiveTexture(GL_TEXTURE0);
+
+    // Mipmaps keep distant faces from shimmering; close up the texels stay sharp
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, textures.levels.size() - 1);
+
+    for (std::size_t l = 0; l < textures.levels.size(); ++l)
+    {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, l, GL_RGBA8, textures.level_size(l), textures.level_size(l), textures.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, textures.levels[l].data());
+        memory_allocated(memory_gpu, textures.levels[l].size());
+    }
+
+    const char * vertex_shader_code = "\
+    uniform vec4 relocate; \
+    varying vec3 texCoord; \
+    varying vec4 position; \
+    varying vec4 normal; \
+    uniform vec4 playerPos; \
+    void main() { \
+        if (dot(gl_Vertex - playerPos, gl_Vertex - playerPos) < 0.0) { } \
+        gl_Position = gl_ModelViewProjectionMatrix * (gl_Vertex + relocate); \
+        position = gl_Vertex; \
+        normal = vec4(gl_Normal, 0.0); \
+        gl_FrontColor = gl_Color; \
+        gl_BackColor = gl_Color; \
+        texCoord = gl_MultiTexCoord0.xyz; \
+    }";
+    const char * fragment_shader_code = "\
+    #extension GL_EXT_texture_array : enable\n\
+    uniform float health; \
+    uniform sampler2DArray texture; \
+    varying vec3 texCoord; \
+    vec4 texColor; \
+    varying vec4 position; \
+    varying vec4 normal; \
+    uniform vec4 playerPos; \
+    vec4 delta; \
+    float light; \
+    void main() { \
+        delta = playerPos - position; \
+        delta[3] = 0.0; \
+        light = dot(normalize(delta), normal); \
+        texColor = texture2DArray(texture, texCoord); \
+        gl_FragColor[0] = texColor[0] * gl_Color[0]; \
+        gl_FragColor[1] = texColor[1] * gl_Color[1]; \
+        gl_FragColor[2] = texColor[2] * gl_Color[2]; \
+        gl_FragColor[3] = texColor[3] * gl_Color[3]; \
+        if (texCoord[0] < 1.0 / 32.0 || texCoord[0] > 31.0 / 32.0 || texCoord[1] < 1.0 / 32.0 || texCoord[1] > 31.0 / 32.0) \
+        { \
+            gl_FragColor = mix(gl_FragColor, vec4(0.0, 0.0, 0.0, 1.0), 0.5); \
+        } \
+        gl_FragColor = mix(vec4(0.75, 0.75, 0.75, 1.0), gl_FragColor, min(10.0 / dot(delta, delta), 1.0)); \
+        gl_FragColor[0] = gl_FragColor[0] + health * (1.0 - gl_FragColor[0]); \
+        gl_FragColor[1] = gl_FragColor[1] + health * (0.0 - gl_FragColor[1]); \
+        gl_FragColor[2] = gl_FragColor[2] + health * (0.0 - gl_FragColor[2]); \
+    }";
+    unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    unsigned int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+
+    glShaderSource(vertex_shader, 1, &vertex_shader_code, 0);
+    glShaderSource(fragment_shader, 1, &fragment_shader_code, 0);
+
+    glCompileShader(vertex_shader);
+    glCompileShader(fragment_shader);
+
+    int shader_compiled;
+    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &shader_compiled);
+    if (!shader_compiled) qDebug("Vertex shader failed to compile");
+    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &shader_compiled);
+    if (!shader_compiled) qDebug("Fragment shader failed to compile");
+
+    program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+
+    glLinkProgram(program);
+
+    glUseProgram(program);
+
+    uniform_satan = glGetUniformLocation(program, "health");
+    relocate_addr = glGetUniformLocation(program, "relocate");
+    playerpos_addr = glGetUniformLocation(program, "playerPos");
+    std::cerr << "Health: " << uniform_satan << "\nRelocate: " << relocate_addr << "\nPlayer pos: " << playerpos_addr << "\n";
+
+    unsigned int simple_vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    unsigned int simple_fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+
+    const char * simple_vertex_shader_code = " \
+    void main ( ) \
+    { \
+        gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex; \
+        gl_FrontColor = gl_Color; \
+        gl_BackColor = gl_Color; \
+    }";
+
+    const char * simple_fragment_shader_code = " \
+    void main ( ) \
+    { \
+        gl_FragColor = gl_Color; \
+    }";
+
+    glShaderSource(simple_vertex_shader, 1, &simple_vertex_shader_code, 0);
+    glShaderSource(simple_fragment_shader, 1, &simple_fragment_shader_code, 0);
+
+    glCompileShader(simple_vertex_shader);
+    glCompileShader(simple_fragment_shader);
+
+    glGetShaderiv(simple_vertex_shader, GL_COMPILE_STATUS, &shader_compiled);
+    if (!shader_compiled) qDebug("Simple vertex shader failed to compile");
+    glGetShaderiv(simple_fragment_shader, GL_COMPILE_STATUS, &shader_compiled);
+    if (!shader_compiled) qDebug("Simple fragment shader failed to compile");
+
+    simple_program = glCreateProgram();
+    glAttachShader(simple_program, simple_vertex_shader);
+    glAttachShader(simple_program, simple_fragment_shader);
+
+    glLinkProgram(simple_program);
+
+    entities.init();
+    particle_renderer.init();
+    chunk_draws.init();
+
+}
+
+void main_window::resizeGL (int width, int height)
+{
+    this->width = width;
+    this->height = height;
+
+    QCursor::setPos(normalGeometry().topLeft() + QPoint(width / 2, height / 2));
+
+    pl.alpha = 0.0;
+    pl.beta = 0.0;
+
+    ratio = static_cast<double>(width) / (2 * height);
+}
+
+color main_window::get_current_color ( ) const
+{
+    color res = get_color(discrete_brightness(), discrete_hue());
+    return res;
+}
+
+void main_window::set_color (color c) const
+{
+    glColor4dv(c.data);
+}
+
+int truncate (double x, int add)
+{
+    if (x >= 0)
+        return x + add;
+    else
+        return x + add - 1;
+}
+
+double main_window::discrete_brightness ( ) const
+{
+    return truncate((brightness - 1.0) * sphere_y, 0) / static_cast<double>(sphere_y) + 1.0;
+}
+
+double main_window::discrete_hue ( ) const
+{
+    return truncate(hue * sphere_x / 6.0, 1) / static_cast<double>(sphere_x) * 6.0;
+}
+
+void main_window::add_cube (int x, int y, int z)
+{
+    if (connection)
+        connection->add_cube(cube_position(x, y, z), discrete_hue(), discrete_brightness(), current_material);
+    else
+    {
+        terrain.add_cube(cube_position(x, y, z), discrete_hue(), discrete_brightness(), current_material);
+        cells.activate_around(cube_position(x, y, z));
+    }
+}
+
+void main_window::remove_cube (cube_position p)
+{
+    if (connection)
+        connection->remove_cube(p);
+    else
+    {
+        terrain.remove_cube(p);
+        cells.activate_around(p);
+    }
+}
+
+void main_window::paint (cube_position p, int plane)
+{
+    if (connection)
+        connection->paint(p, plane, discrete_hue(), discrete_brightness());
+    else
+        terrain.paint(p, plane, discrete_hue(), discrete_brightness());
+}
+
+void main_window::pick ( )
+{
+    double dx = std::sin(pl.alpha) * std::cos(pl.beta);
+    double dy = -std::sin(pl.beta);
+    double dz = -std::cos(pl.alpha) * std::cos(pl.beta);
+
+    ray_hit hit;
+    has_chosen_plane = cast_ray(terrain, pl._x, pl._y, pl._z, dx, dy, dz, pick_distance, hit);
+    if (has_chosen_plane)
+    {
+        chosen_cube = hit.cube;
+        chosen_plane_index = hit.plane;
+    }
+}
+
+void main_window::copy_selection ( )
+{
+    if (!has_selection[0] || !has_selection[1])
+        return;
+
+    copy_schematic(terrain, selection[0], selection[1], clipboard);
+
+    std::size_t raw = clipboard.volume() * sizeof(voxel);
+    std::cout << "copied " << clipboard.size_x << 'x' << clipboard.size_y << 'x' << clipboard.size_z << " cells, "
+        << clipboard.palette.size() << " distinct, " << clipboard.bytes() / 1024 << " KiB instead of " << raw / 1024 << " KiB" << std::endl;
+}
+
+void main_window::paste_clipboard (cube_position origin)
+{
+    if (clipboard.volume() == 0)
+        return;
+
+    cube_position last(origin.x + clipboard.size_x - 1, origin.y + clipboard.size_y - 1, origin.z + clipboard.size_z - 1);
+
+    if (!connection)
+    {
+        stamp(terrain, clipboard, origin);
+
+        // Sand and water in the box or next to it may fall now
+        region around = region::box(cube_position(origin.x - 1, origin.y - 1, origin.z - 1), cube_position(last.x + 1, last.y + 1, last.z + 1));
+        cube_filter dynamic;
+        dynamic.materials = (1u << material_sand) | (1u << material_water);
+        for_each_in_region(terrain, around, dynamic, [this](cube_position p, const voxel &)
+        {
+            cells.activate(p);
+        });
+        return;
+    }
+
+    // The server only takes single edits
+    std::size_t i = 0;
+    for (int x = origin.x; x <= last.x; ++x)
+        for (int y = origin.y; y <= last.y; ++y)
+            for (int z = origin.z; z <= last.z; ++z, ++i)
+            {
+                cube_position p(x, y, z);
+                voxel const & v = clipboard.palette[clipboard.cells[i]];
+                if (!v.solid)
+                {
+                    if (terrain.has_cube(p))
+                        connection->remove_cube(p);
+                    continue;
+                }
+
+                connection->add_cube(p, v.hue[0], v.brightness[0], v.material);
+                for (int f = 1; f < 6; ++f)
+                    if (v.hue[f] != v.hue[0] || v.brightness[f] != v.brightness[0])
+                        connection->paint(p, f, v.hue[f], v.brightness[f]);
+            }
+}
+
+void main_window::explode (cube_position center)
+{
+    std::vector<std::pair<cube_position, voxel>> removed;
+    if (connection)
+    {
+        // The server only takes single edits
+        for_each_in_region(terrain, region::sphere(center.x, center.y, center.z, explosion_radius), cube_filter(), [&removed](cube_position p, const voxel & v)
+        {
+            removed.push_back(std::make_pair(p, v));
+        });
+        for (auto const & r : removed)
+            connection->remove_cube(r.first);
+    }
+    else
+    {
+        terrain.remove_sphere(center.x, center.y, center.z, explosion_radius, removed);
+
+        // Sand and water around the hole may fall now
+        cube_filter dynamic;
+        dynamic.materials = (1u << material_sand) | (1u << material_water);
+        for_each_in_region(terrain, region::sphere(center.x, center.y, center.z, explosion_radius + 1.5), dynamic, [this](cube_position p, const voxel &)
+        {
+            cells.activate(p);
+        });
+    }
+
+    particles.spawn(removed, center.x, center.y, center.z, explosion_speed);
+}
+
+bool main_window::connect_to (const std::string & address)
+{
+    net_address server_address;
+    if (!parse_address(address, default_port, server_address))
+    {
+        std::cerr << "Unknown server address " << address << '\n';
+        return false;
+    }
+
+    network.reset(new udp_transport());
+    if (!network->is_open())
+    {
+        std::cerr << "Failed to open a UDP socket\n";
+        network.reset();
+        return false;
+    }
+
+    terrain.clear();
+    cells.clear();
+    connection.reset(new client(*network, server_address, &terrain));
+    spawned = false;
+    return true;
+}
+
+void main_window::update_connection ( )
+{
+    player_input input;
+    input.move_forward = pl.move_forward;
+    input.move_sideward = pl.move_sideward;
+    input.move_upward = pl.move_upward;
+    input.alpha = pl.alpha;
+    input.beta = pl.beta;
+    input.jump = jump_requested;
+    input.gravity = enable_gravity;
+    jump_requested = false;
+
+    connection->update(last_frame, input);
+    connection->remote_players(kubemen);
+
+    if (!connection->connected())
+    {
+        spawned = false;
+        return;
+    }
+
+    if (!spawned)
+    {
+        kubeman const & spawn = connection->spawn();
+        pl.x = spawn.x;
+        pl.y = spawn.y;
+        pl.z = spawn.z;
+        pl.vy = 0.0;
+        pl.init();
+        spawned = true;
+    }
+
+    // The server is authoritative; only correct us when we drift noticeably
+    kubeman own;
+    if (connection->own_state(own))
+    {
+        auto sqr = [](double x){ return x * x; };
+        if (sqr(own.x - pl.x) + sqr(own.y - pl.y) + sqr(own.z - pl.z) > 4.0)
+        {
+            pl.x = own.x;
+            pl.y = own.y;
+            pl.z = own.z;
+            pl.init();
+        }
+    }
+}
+
+void main_window::paintGL ( )
+{
+    glUseProgram(program);
+
+    float dispersion = 1.0 - health;
+    glClearColor(0.75 + 0.25 * (1.0 - health), 0.75 * health, 0.75 * health, 1.0);
+    //glClearColor(0.75, 0.75, 0.75, 0.0);
+
+    glViewport(0, 0, width / 2, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glEnable(GL_DEPTH_TEST);
+
+    /*glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);*/
+
+    // Only the translucent pass blends
+    glDisable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glFrustum(- ratio * 0.01, ratio * 0.01, -0.01, 0.01, 0.01, 1000.0);
+    //glOrtho(-10.0, 10.0, -10.0, 10.0, -100.0, 100.0);
+
+    glMatrixMode(GL_MODELVIEW);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+
+    render_arena.reset();
+
+    glUniform1f(uniform_satan, dispersion);
+    double h = health;
+    std::function<float()> & r = randomf;
+    auto random_earthquake = [h, &r](){ return 0.1 * (1.0 - h) * (2.0 * r() - 1.0); };
+    glUniform4f(relocate_addr, random_earthquake(), random_earthquake(), random_earthquake(), 0.0);
+    glUniform4f(playerpos_addr, pl._x, pl._y, pl._z, 0.0);
+
+    // Only chunks that changed since the last frame are meshed again
+    chunks_rebuilt += world_meshes.update(terrain);
+    world_meshes.sort_translucent(pl._x, pl._y, pl._z, render_arena);
+
+    // Uploads what changed into the shared buffer; the draw commands stay
+    // as they are unless something moved
+    chunk_draws.update(world_meshes, pl._x, pl._y, pl._z, render_arena);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    //glVertexAttribPointer(relocate_addr, 4, GL_DOUBLE, GL_FALSE, 0, relocations.data());
+
+    entities.clear();
+    if (!connection)
+    {
+        kubemen.clear();
+        npcs.walkers(kubemen);
+    }
+    for (kubeman const & k : kubemen)
+        entities.add(k, get_color(0.8, k.id * 1.3));
+    entities.upload();
+    particle_renderer.upload(particles);
+
+    // As late as possible, so the view is the freshest the mouse can give
+    latch_camera();
+
+    int old_move_sideward = pl.move_sideward;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        const double dalpha = 0.2;
+        const double focus = 5000.0;
+
+        if (i == 0)
+        {
+            pl.move_sideward = 1;
+            pl.alpha -= dalpha / focus;
+        }
+        if (i == 1)
+        {
+            pl.move_sideward = -1;
+            pl.alpha += dalpha / focus;
+        }
+
+        pl.fake_move(dalpha);
+
+        glLoadIdentity();
+        transform(pl);
+        glViewport(i * width / 2, 0, width / 2, height);
+
+        chunk_draws.draw_opaque();
+
+        entities.draw();
+        particle_renderer.draw();
+        glUseProgram(program);
+
+        // Translucent faces don't hide what is drawn after them
+        glEnable(GL_BLEND);
+        glDepthMask(GL_FALSE);
+        chunk_draws.draw_translucent();
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+
+        pl.fake_move(-dalpha);
+
+        if (i == 0)
+        {
+            pl.alpha += dalpha / focus;
+        }
+        if (i == 1)
+        {
+            pl.alpha -= dalpha / focus;
+        }
+    }
+
+    pl.move_sideward = old_move_sideward;
+
+    glDisable(GL_TEXTURE_2D);
+
+    glDisable(GL_DEPTH_TEST);
+
+    if (show_minimap)
+        draw_minimap();
+
+    /*glLoadIdentity();
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(-ratio, ratio, -1.0, 1.0, -1.0, 1.0);
+
+    glMatrixMode(GL_MODELVIEW);
+
+    glUseProgram(simple_program);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        glViewport(i * width / 2, 0, width / 2, height);
+        glColor3f(0.0, 0.0, 0.0);
+        glBegin(GL_LINES);
+            glVertex2d(-cross_size, 0.0);
+            glVertex2d(cross_size, 0.0);
+            glVertex2d(0.0, -cross_size);
+            glVertex2d(0.0, cross_size);
+        glEnd();
+    }*/
+
+    swapBuffers();
+    scheduler.frame_presented();
+
+    auto now = std::chrono::high_resolution_clock::now();
+    frames.push(now);
+
+    // Until the frame is handed over; the display adds its own delay
+    if (input_pending)
+    {
+        double latency = std::chrono::duration<double, std::milli>(now - input_time).count();
+        latency_sum += latency;
+        latency_max = std::max(latency_max, latency);
+        ++latency_samples;
+        input_pending = false;
+    }
+
+    if (frames.size() > average_frames)
+    {
+        double fps = average_frames / std::chrono::duration<double>(now - frames.front()).count();
+        frames.pop();
+
+        // Building the title allocates, so don't do it every frame
+        if (++frames_since_title >= average_frames)
+        {
+            frames_since_title = 0;
+
+            frame_arena::statistics const & arena_stats = render_arena.stats();
+            frame_scheduler::statistics pacing = scheduler.take_stats();
+            chunk_renderer::statistics draws = chunk_draws.take_stats();
+
+            // Chunks away from the player are packed until something touches them
+            cube_position eye(std::floor(pl._x + 0.5), std::floor(pl._y + 0.5), std::floor(pl._z + 0.5));
+            terrain.update_residency(chunk_of(eye), residency_radius);
+            world::storage_statistics const & storage = terrain.storage_stats();
+            std::size_t lookups = std::max<std::size_t>(storage.cache_hits + storage.cache_misses, 1);
+
+            std::ostringstream oss;
+            oss << pl.vy << " Kubach. Try mouse buttons! FPS: " << (int)fps
+                << " Frame memory: " << arena_stats.last_frame_bytes / 1024 << " KiB"
+                << " (" << arena_stats.last_frame_heap_allocations << " heap allocations)"
+                << " Chunks meshed: " << chunks_rebuilt
+                << " Draws: " << draws.commands << (draws.indirect ? " indirect" : "") << ", "
+                << draws.uploaded << " uploads, " << draws.rebuilds << " rebuilds"
+                << " World: " << storage.resident_bytes / 1024 << " KiB, "
+                << storage.cold_chunks << " packed chunks, "
+                << storage.cache_hits * 100 / lookups << "% cache hits"
+                << " Input latency: " << latency_sum / std::max(latency_samples, 1) << " ms, " << latency_max << " ms max"
+                << " Frame time: " << pacing.average_ms << " ms, " << pacing.jitter_ms << " ms jitter, " << pacing.worst_ms << " ms max"
+                << " Memory: " << memory_total() / 1024 << " KiB, meshes " << memory_stats(memory_meshes).bytes / 1024 << " KiB";
+            if (particles.size() > 0)
+                oss << " Debris: " << particles.size();
+            if (npcs.size() > 0)
+            {
+                crowd::statistics walkers = npcs.stats();
+                oss << " Kubemen: " << walkers.walkers << ", " << walkers.waiting << " waiting for a route, "
+                    << walkers.plan_ms << " ms planning";
+            }
+            chunks_rebuilt = 0;
+            latency_sum = latency_max = 0.0;
+            latency_samples = 0;
+            setWindowTitle(oss.str().c_str());
+        }
+    }
+}
+
+void main_window::draw_minimap ( )
+{
+    int px = static_cast<int>(std::floor(pl._x + 0.5));
+    int pz = static_cast<int>(std::floor(pl._z + 0.5));
+
+    // Reading the heightmap is cheap, but there is no need to do it every frame
+    if (frames_since_title == 0 || minimap_pixels.empty())
+    {
+        render_minimap(terrain, px, pz, minimap_size, minimap_pixels);
+
+        unsigned char * center = &minimap_pixels[((minimap_size / 2) * minimap_size + minimap_size / 2) * 3];
+        center[0] = 255;
+        center[1] = center[2] = 0;
+    }
+
+    // -z is up on the map, so rows are drawn from the top down
+    glUseProgram(0);
+    glViewport(0, 0, width, height);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glWindowPos2i(minimap_margin, minimap_margin + minimap_size * minimap_zoom);
+    glPixelZoom(minimap_zoom, -minimap_zoom);
+    glDrawPixels(minimap_size, minimap_size, GL_RGB, GL_UNSIGNED_BYTE, minimap_pixels.data());
+    glPixelZoom(1, 1);
+}
+
+void main_window::queue_input (input_event::kind_type kind, int code)
+{
+    input_event e;
+    e.kind = kind;
+    e.code = code;
+    e.time = std::chrono::high_resolution_clock::now();
+
+    // Only full if the game stopped ticking; losing input is better then
+    input.push(e);
+}
+
+void main_window::process_input ( )
+{
+    input_event e;
+    while (input.pop(e))
+    {
+        if (!input_pending)
+        {
+            input_pending = true;
+            input_time = e.time;
+        }
+
+        switch (e.kind)
+        {
+        case input_event::key_press:
+            apply_key_press(e.code);
+            break;
+        case input_event::key_release:
+            apply_key_release(e.code);
+            break;
+        case input_event::button_press:
+            apply_button_press(static_cast<Qt::MouseButton>(e.code));
+            break;
+        case input_event::button_release:
+            apply_button_release(static_cast<Qt::MouseButton>(e.code));
+            break;
+        case input_event::wheel:
+            hue += e.code / 120.0 * 6.0 / sphere_x;
+            break;
+        case input_event::mouse_move:
+            // Applied in latch_camera
+            break;
+        }
+    }
+}
+
+void main_window::latch_camera ( )
+{
+    QPoint center = normalGeometry().topLeft() + QPoint(width / 2, height / 2);
+    QPoint cursor = QCursor::pos();
+    int dx = cursor.x() - center.x();
+    int dy = cursor.y() - center.y();
+
+    // The cursor starts anywhere
+    if (!cursor_centered)
+    {
+        cursor_centered = true;
+        QCursor::setPos(center);
+        return;
+    }
+
+    if (dx == 0 && dy == 0)
+        return;
+
+    QCursor::setPos(center);
+    if (rainbow)
+    {
+        brightness -= dy * 0.0075;
+        if (brightness > 2.0) brightness = 2.0;
+        if (brightness < 0.0) brightness = 0.0;
+        hue -= dx * 0.0075;
+
+        sphere_hue = hue;
+        sphere_brightness = brightness;
+    }
+    else
+    {
+        pl.alpha += dx * 0.0075;
+        pl.beta += dy * 0.0075;
+        if (pl.beta > 3.1415926535 * 0.5) pl.beta = 3.1415926535 * 0.5;
+        if (pl.beta < - 3.1415926535 * 0.5) pl.beta = - 3.1415926535 * 0.5;
+    }
+}
+
+void main_window::mouseMoveEvent (QMouseEvent *)
+{
+    queue_input(input_event::mouse_move, 0);
+}
+
+void main_window::keyPressEvent (QKeyEvent * keyEvent)
+{
+    queue_input(input_event::key_press, keyEvent->key());
+    keyEvent->accept();
+}
+
+void main_window::keyReleaseEvent (QKeyEvent * keyEvent)
+{
+    queue_input(input_event::key_release, keyEvent->key());
+    keyEvent->accept();
+}
+
+void main_window::mousePressEvent (QMouseEvent * mouseEvent)
+{
+    queue_input(input_event::button_press, static_cast<int>(mouseEvent->button()));
+}
+
+void main_window::mouseReleaseEvent (QMouseEvent * mouseEvent)
+{
+    queue_input(input_event::button_release, static_cast<int>(mouseEvent->button()));
+}
+
+void main_window::wheelEvent (QWheelEvent * event)
+{
+    queue_input(input_event::wheel, event->delta());
+}
+
+void main_window::apply_key_press (int key)
+{
+    if (key == Qt::Key_Escape)
+    {
+        releaseMouse();
+        QApplication::restoreOverrideCursor();
+        QApplication::quit();
+    }
+    else if (key == Qt::Key_W)
+    {
+        pl.move_forward = 1;
+    }
+    else if (key == Qt::Key_S)
+    {
+        pl.move_forward = -1;
+    }
+    else if (key == Qt::Key_D)
+    {
+        pl.move_sideward = 1;
+    }
+    else if (key == Qt::Key_A)
+    {
+        pl.move_sideward = -1;
+    }
+    else if (key == Qt::Key_Space)
+    {
+        if (!enable_gravity)
+            pl.move_upward = 1;
+        else
+            if (on_surface)
+            {
+                pl.y += 0.5;
+                pl.vy = jump;
+                jump_requested = true;
+            }
+    }
+    else if (key == Qt::Key_Shift)
+    {
+        if (!enable_gravity)
+            pl.move_upward = -1;
+    }
+    else if (key == Qt::Key_G)
+    {
+        enable_gravity ^= true;
+        if (!enable_gravity)
+            pl.vy = 0.0;
+    }
+    else if (key == Qt::Key_O)
+    {
+        if (!terrain.has_cube(cube_position(0, 0, 0)))
+            add_cube(0, 0, 0);
+    }
+    else if (key == Qt::Key_R)
+    {
+        pl.x = world_size * 0.5;
+        pl.z = world_size * 0.5;
+        pl.y = standing_height(terrain, pl.x, pl.z, 5.0);
+        pl.vy = 0;
+        pl.init();
+    }
+    else if (key == Qt::Key_P)
+    {
+        render_paused ^= true;
+    }
+    else if (key == Qt::Key_M)
+    {
+        show_minimap ^= true;
+    }
+    else if (key == Qt::Key_N)
+    {
+        if (!connection)
+            npcs.spawn(terrain, pl.x, pl.z, npcs_per_spawn, 16);
+    }
+    else if (key == Qt::Key_1)
+    {
+        current_material = material_cube;
+    }
+    else if (key == Qt::Key_2)
+    {
+        current_material = material_sand;
+    }
+    else if (key == Qt::Key_3)
+    {
+        current_material = material_water;
+    }
+    else if (key == Qt::Key_4)
+    {
+        current_material = material_glass;
+    }
+    else if (key == Qt::Key_Z || key == Qt::Key_X)
+    {
+        int corner = key == Qt::Key_Z ? 0 : 1;
+        has_selection[corner] = has_chosen_plane;
+        selection[corner] = chosen_cube;
+    }
+    else if (key == Qt::Key_C)
+    {
+        copy_selection();
+    }
+    else if (key == Qt::Key_V)
+    {
+        if (has_chosen_plane)
+            paste_clipboard(make_mesh(chosen_cube).planes[chosen_plane_index].adjacent_cube());
+    }
+    else if (key == Qt::Key_B)
+    {
+        if (has_chosen_plane)
+        {
+            explode(chosen_cube);
+            has_chosen_plane = false;
+        }
+    }
+    else if (key == Qt::Key_T)
+    {
+        clipboard = rotated(clipboard, 1);
+    }
+    else if (key == Qt::Key_F6)
+    {
+        if (!save_schematic(clipboard, clipboard_file))
+            std::cout << "saving " << clipboard_file << " failed" << std::endl;
+    }
+    else if (key == Qt::Key_F7)
+    {
+        if (!load_schematic(clipboard_file, clipboard))
+            std::cout << "loading " << clipboard_file << " failed" << std::endl;
+    }
+    else if (key == Qt::Key_F5)
+    {
+        save_world(false);
+    }
+    else if (key == Qt::Key_F9)
+    {
+        // The server owns the world when playing online
+        if (!connection)
+            storage.load(save_file);
+    }
+}
+
+void main_window::apply_key_release (int key)
+{
+    if (key == Qt::Key_W)
+    {
+        pl.move_forward = 0;
+    }
+    else if (key == Qt::Key_S)
+    {
+        pl.move_forward = 0;
+    }
+    else if (key == Qt::Key_D)
+    {
+        pl.move_sideward = 0;
+    }
+    else if (key == Qt::Key_A)
+    {
+        pl.move_sideward = 0;
+    }
+    else if (key == Qt::Key_Space)
+    {
+        pl.move_upward = 0;
+    }
+    else if (key == Qt::Key_Shift)
+    {
+        pl.move_upward = 0;
+    }
+    else if (key == Qt::Key_Q)
+    {
+        if (has_chosen_plane)
+        {
+            paint(chosen_cube, chosen_plane_index);
+        }
+    }
+    else if (key == Qt::Key_E)
+    {
+        if (has_chosen_plane)
+        {
+            voxel const * v = terrain.find(chosen_cube);
+            if (v)
+            {
+                brightness = v->brightness[chosen_plane_index] + 0.5 / sphere_y;
+                hue = v->hue[chosen_plane_index] - 3.0 / sphere_x;
+            }
+        }
+    }
+}
+
+void main_window::apply_button_press (Qt::MouseButton button)
+{
+    if (button == Qt::MouseButton::RightButton)
+    {
+        if (has_chosen_plane)
+        {
+            cube_position to_add = make_mesh(chosen_cube).planes[chosen_plane_index].adjacent_cube();
+            if (!pl.has_collision(to_add))
+            {
+                add_cube(to_add.x, to_add.y, to_add.z);
+            }
+        }
+    }
+    else if (button == Qt::MouseButton::LeftButton)
+    {
+        if (has_chosen_plane)
+        {
+            remove_cube(chosen_cube);
+            has_chosen_plane = false;
+        }
+    }
+    else if (button == Qt::MouseButton::MiddleButton)
+    {
+        rainbow = true;
+    }
+}
+
+void main_window::apply_button_release (Qt::MouseButton button)
+{
+    if (button == Qt::MouseButton::MiddleButton)
+    {
+        rainbow = false;
+    }
+}
+
+void main_window::save_world (bool only_if_changed)
+{
+    if (connection)
+        return;
+
+    bool changed = false;
+    if (!unsaved_changes.read([&changed](const world_change &){ changed = true; }))
+        changed = true;
+    unsaved = unsaved || changed;
+    if (only_if_changed && !unsaved)
+        return;
+
+    if (storage.save(terrain, save_file))
+    {
+        unsaved = false;
+        std::cout << "saving: world stopped for " << storage.stats().pause_ms << " ms" << std::endl;
+    }
+}
+
+void main_window::finish_storage_job ( )
+{
+    world_storage::job done = storage.poll(terrain);
+    if (done == world_storage::job_none)
+        return;
+
+    world_storage::statistics const & s = storage.stats();
+    if (!s.ok)
+    {
+        std::cout << (done == world_storage::job_save ? "saving " : "loading ") << save_file << " failed" << std::endl;
+        return;
+    }
+
+    double mb_per_s = s.bytes / 1048576.0 / std::max(s.io_ms * 0.001, 1e-6);
+    if (done == world_storage::job_save)
+    {
+        std::cout << "saved " << s.chunks << " chunks, " << s.bytes / 1024 << " KiB in " << s.io_ms << " ms ("
+            << mb_per_s << " MiB/s), world stopped for " << s.pause_ms << " ms" << std::endl;
+        return;
+    }
+
+    // What was just loaded is what is on disk
+    unsaved_changes.read([](const world_change &){ });
+    unsaved = false;
+
+    std::cout << "loaded " << s.chunks << " chunks, " << s.bytes / 1024 << " KiB in " << s.io_ms << " ms ("
+        << mb_per_s << " MiB/s), world stopped for " << s.pause_ms << " ms" << std::endl;
+
+    // Whatever sand or water was still moving continues to
+    std::vector<cube_position> dynamic;
+    terrain.for_each_cube([&dynamic](cube_position p, voxel const & v)
+    {
+        if (is_dynamic(v.material))
+            dynamic.push_back(p);
+    });
+    cells.clear();
+    for (cube_position const & p : dynamic)
+        cells.activate(p);
+}
+
+void main_window::timerEvent (QTimerEvent * event)
+{
+    if (event->timerId() != step_timer)
+        return;
+
+    // Re-armed for every step, as the wait changes
+    killTimer(step_timer);
+    last_frame = scheduler.begin_step();
+
+    // Nobody sees the frames of a hidden window
+    scheduler.set_rendering(!render_paused && isVisible() && !isMinimized());
+
+    step();
+    if (scheduler.rendering())
+        updateGL();
+
+    step_timer = startTimer(scheduler.wait_ms());
+}
+
+void main_window::step ( )
+{
+    process_input();
+    finish_storage_job();
+
+    if (memory_log_interval > 0.0)
+    {
+        memory_log_time += last_frame;
+        if (memory_log_time >= memory_log_interval)
+        {
+            memory_log_time = 0.0;
+            dump_memory_stats(std::cerr);
+        }
+    }
+    if (connection)
+    {
+        // The server keeps this world; its edits are never ours to save
+        unsaved_changes.read([](const world_change &){ });
+    }
+    else
+    {
+        autosave_time += last_frame;
+        if (autosave_time >= autosave_interval)
+        {
+            autosave_time = 0.0;
+            save_world(true);
+        }
+    }
+
+    if (connection)
+    {
+        update_connection();
+
+        // Don't fall through the world while it is still arriving
+        if (connection->loading())
+            return;
+    }
+
+    // Sand and water move at the server's tick rate; don't try to catch up
+    // after a long stall
+    if (!connection)
+    {
+        simulation_time = std::min(simulation_time + last_frame, 3.0 / tick_rate);
+        while (simulation_time >= 1.0 / tick_rate)
+        {
+            simulation_time -= 1.0 / tick_rate;
+            cells.tick();
+        }
+
+        npcs.tick(terrain, last_frame, npc_budget_ms);
+    }
+
+    particles.tick(terrain, last_frame);
+
+    advance(pl, last_frame, enable_gravity);
+    pick();
+
+    bool old_on_surface = on_surface;
+    double old_vy = pl.vy;
+
+    on_surface = collide(pl, terrain);
+
+    if (!old_on_surface && on_surface)
+    {
+        if (old_vy < -3.0)
+            health = exp((old_vy + 3.0) * 0.4);
+    }
+
+    double sphere_k = 0.2;
+    sphere_hue += sphere_k * (hue - sphere_hue);
+    sphere_brightness += sphere_k * (brightness - sphere_brightness);
+
+    health += 0.01;
+    if (health > 1.0) health = 1.0;
+}
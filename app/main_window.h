@@ -0,0 +1,255 @@
+#ifndef MAIN_WINDOW_H
+#define MAIN_WINDOW_H
+
+#include "player.h"
+#include "cube.h"
+#include "kubeman.h"
+#include "crowd.h"
+#include "world.h"
+#include "frame_arena.h"
+#include "frame_scheduler.h"
+#include "mesh.h"
+#include "textures.h"
+#include "worker_pool.h"
+#include "simulation.h"
+#include "transport.h"
+#include "client.h"
+#include "world_file.h"
+#include "schematic.h"
+#include "entity_renderer.h"
+#include "debris_renderer.h"
+#include "chunk_renderer.h"
+#include "debris.h"
+#include "spsc_queue.h"
+#include "memory_stats.h"
+#include "change_journal.h"
+
+#include <QGLWidget>
+
+#include <vector>
+#include <chrono>
+#include <queue>
+#include <functional>
+#include <memory>
+#include <string>
+
+class main_window : public QGLWidget
+{
+    Q_OBJECT
+
+    int width, height;
+    player pl;
+
+    // Qt events are only queued; the game applies them once per tick, and
+    // the camera reads the cursor itself right before drawing
+    struct input_event
+    {
+        enum kind_type
+        {
+            key_press,
+            key_release,
+            button_press,
+            button_release,
+            mouse_move,
+            wheel
+        };
+
+        kind_type kind;
+        int code;
+        std::chrono::high_resolution_clock::time_point time;
+    };
+
+    spsc_queue<input_event, 256> input;
+    bool cursor_centered;
+
+    // Arrival of the oldest input that the next frame is the first to show
+    bool input_pending;
+    std::chrono::high_resolution_clock::time_point input_time;
+
+    double latency_sum, latency_max;
+    int latency_samples;
+
+    void queue_input (input_event::kind_type kind, int code);
+    void process_input ( );
+    void latch_camera ( );
+
+    void apply_key_press (int key);
+    void apply_key_release (int key);
+    void apply_button_press (Qt::MouseButton button);
+    void apply_button_release (Qt::MouseButton button);
+
+    double ratio;
+
+    const double cross_size = 0.05;
+
+    world terrain;
+
+    // Only ticked when playing alone; otherwise the server does it
+    worker_pool workers;
+    simulation cells;
+    double simulation_time;
+    int current_material;
+
+    mesh_cache world_meshes;
+    chunk_renderer chunk_draws;
+    std::size_t chunks_rebuilt;
+
+    // In chunks around the player
+    static const int residency_radius = 2;
+
+    // Saves in the background, so the game only stops for the snapshot
+    world_storage storage;
+    double autosave_time;
+    static const int autosave_interval = 60;
+    const std::string save_file = "world.kub";
+
+    // Autosaves are skipped while nothing has changed since the last save
+    journal_reader unsaved_changes;
+    bool unsaved;
+
+    void save_world (bool only_if_changed);
+    void finish_storage_job ( );
+
+    // A layer per material, drawn by the workers at startup
+    static const int texture_size = 32;
+    unsigned int texture_id;
+
+    // The cube under the cross, updated every frame
+    bool has_chosen_plane;
+    cube_position chosen_cube;
+    int chosen_plane_index;
+    static const int pick_distance = 8;
+
+    void pick ( );
+
+    // Corners are set with Z and X, then C copies what is between them
+    cube_position selection[2];
+    bool has_selection[2];
+    schematic clipboard;
+    const std::string clipboard_file = "clipboard.kbs";
+
+    void copy_selection ( );
+    void paste_clipboard (cube_position origin);
+
+    // B blows up the cells around the cube under the cross; what was there
+    // flies off as debris
+    debris particles;
+    debris_renderer particle_renderer;
+    const double explosion_radius = 4.5;
+    const double explosion_speed = 8.0;
+
+    void explode (cube_position center);
+
+    bool enable_gravity;
+
+    const double jump = 1.5;
+
+    bool on_surface;
+
+    // Steps are timed by the scheduler; last_frame is the length of the
+    // current one in seconds
+    frame_scheduler scheduler;
+    int step_timer;
+    bool render_paused;
+
+    void step ( );
+
+    // Seconds between dumps of memory_stats to stderr, 0 for none
+    double memory_log_interval;
+    double memory_log_time;
+
+    static const int average_frames = 10;
+    double last_frame;
+    std::queue<std::chrono::high_resolution_clock::time_point> frames;
+    int frames_since_title;
+
+    frame_arena render_arena;
+
+    std::vector<kubeman> kubemen;
+    entity_renderer entities;
+
+    // Walk around when playing alone; N adds more of them
+    crowd npcs;
+    static const int npcs_per_spawn = 20;
+    const double npc_budget_ms = 2.0;
+
+    static const int minimap_size = 48;
+    static const int minimap_zoom = 2;
+    static const int minimap_margin = 8;
+    bool show_minimap;
+    std::vector<unsigned char> minimap_pixels;
+
+    void draw_minimap ( );
+
+    double brightness, hue;
+    double discrete_brightness ( ) const;
+    double discrete_hue ( ) const;
+
+    color get_current_color ( ) const;
+    void set_color (color c) const;
+
+    void add_cube (int x, int y, int z);
+    void remove_cube (cube_position p);
+    void paint (cube_position p, int plane);
+
+    // Set when playing on a server; the terrain is then a replica
+    std::unique_ptr<udp_transport> network;
+    std::unique_ptr<client> connection;
+    bool spawned;
+    bool jump_requested;
+
+    void update_connection ( );
+
+    double sphere_hue, sphere_brightness;
+
+    const int sphere_x = 12;
+    const int sphere_y = 4;
+
+    const int world_size = 70;
+
+    bool rainbow;
+
+    double health;
+    int uniform_satan;
+    int relocate_addr;
+    int playerpos_addr;
+
+    unsigned int program;
+
+    unsigned int simple_program;
+
+    std::function<float()> randomf;
+    
+public:
+    main_window(QGLWidget *parent = 0);
+    ~main_window();
+
+    // Replaces the local world with the one of the server at address
+    bool connect_to (const std::string & address);
+
+    // Frames per second, or 0 to draw whenever the last swap is done
+    void set_frame_rate (double rate);
+
+    void set_memory_log (double seconds);
+
+    // Replaces the generated terrain with a heightmap, its top coloured
+    // from colors if that is not empty
+    bool import_terrain (const std::string & heightmap, const std::string & colors);
+
+    void initializeGL() override;
+    void resizeGL(int width, int height) override;
+    void paintGL() override;
+
+    void mouseMoveEvent(QMouseEvent * mouseEvent) override;
+    void keyPressEvent(QKeyEvent * keyEvent) override;
+    void keyReleaseEvent(QKeyEvent * keyEvent) override;
+
+    void mousePressEvent (QMouseEvent * mouseEvent) override;
+    void mouseReleaseEvent (QMouseEvent * mouseEvent) override;
+
+    void wheelEvent (QWheelEvent * event) override;
+
+    void timerEvent (QTimerEvent * event);
+};
+
+#endif // MAIN_WINDOW_H
@@ -0,0 +1,83 @@
+#include "render.h"
+#include "cube.h"
+
+#include <QtOpenGL>
+
+#include <GL/gl.h>
+
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/glext.h>
+
+void rotate (const player & pl)
+{
+    glRotated(pl.beta * 180.0 / 3.1415926535, 1.0, 0.0, 0.0);
+    glRotated(pl.alpha * 180.0 / 3.1415926535, 0.0, 1.0, 0.0);
+}
+
+void translate (const player & pl)
+{
+    glTranslated(-pl._x, -pl._y, -pl._z);
+}
+
+void transform (const player & pl)
+{
+    rotate(pl);
+    translate(pl);
+}
+
+void box_triangles (float x0, float y0, float z0, float x1, float y1, float z1, std::vector<float> & mesh)
+{
+    const float low[3] = {x0, y0, z0}, high[3] = {x1, y1, z1};
+    const int triangles[6] = {0, 1, 2, 0, 2, 3};
+    for (int f = 0; f < 6; ++f)
+        for (int t = 0; t < 6; ++t)
+        {
+            const double * c = face_corners[f][triangles[t]];
+            for (int a = 0; a < 3; ++a)
+                mesh.push_back(c[a] < 0 ? low[a] : high[a]);
+            for (int a = 0; a < 3; ++a)
+                mesh.push_back(face_normals[f][a]);
+        }
+}
+
+static void compile_shader (const char * name, const char * kind, unsigned int shader, const char * code)
+{
+    glShaderSource(shader, 1, &code, 0);
+    glCompileShader(shader);
+
+    int compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled)
+    {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), 0, log);
+        qDebug("%s %s shader failed to compile: %s", name, kind, log);
+    }
+}
+
+unsigned int compile_program (const char * name, const char * vertex_shader_code, const char * fragment_shader_code)
+{
+    unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    unsigned int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    compile_shader(name, "vertex", vertex_shader, vertex_shader_code);
+    compile_shader(name, "fragment", fragment_shader, fragment_shader_code);
+
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    return program;
+}
+
+void link_program (const char * name, unsigned int program)
+{
+    glLinkProgram(program);
+
+    int linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), 0, log);
+        qDebug("%s program failed to link: %s", name, log);
+    }
+}
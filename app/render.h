@@ -0,0 +1,24 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "player.h"
+
+#include <vector>
+
+// Fixed-function camera setup for the player from the core library
+
+void rotate (const player & pl);
+void translate (const player & pl);
+void transform (const player & pl);
+
+// The faces of cube.h stretched over the box from (x0, y0, z0) to
+// (x1, y1, z1), as triangles; every vertex is a position and a normal
+void box_triangles (float x0, float y0, float z0, float x1, float y1, float z1, std::vector<float> & mesh);
+
+// A program from the two shaders, not linked yet, so that attribute
+// locations can still be bound; failures are reported with qDebug under
+// name, like link_program does
+unsigned int compile_program (const char * name, const char * vertex_shader_code, const char * fragment_shader_code);
+void link_program (const char * name, unsigned int program);
+
+#endif // RENDER_H
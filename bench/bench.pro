@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = kubach-bench
+CONFIG += console
+CONFIG -= qt app_bundle
+DEPENDPATH += .
+INCLUDEPATH += .
+
+QMAKE_CXXFLAGS += -std=c++0x -O3
+
+include(../core/core.pri)
+
+# Input
+HEADERS += harness.h
+SOURCES += harness.cpp main.cpp
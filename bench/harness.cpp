@@ -0,0 +1,111 @@
+#include "harness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+typedef std::chrono::high_resolution_clock clock_type;
+
+void bench_registry::add (const std::string & name, const std::string & params, const bench_function & run)
+{
+    bench_case c;
+    c.name = name;
+    c.params = params;
+    c.run = run;
+    cases_.push_back(c);
+}
+
+static double time_ns (const bench_case & c, std::size_t iterations, std::size_t & items)
+{
+    auto start = clock_type::now();
+    items = c.run(iterations);
+    return std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+}
+
+std::vector<bench_result> bench_registry::run (const bench_options & options) const
+{
+    std::vector<bench_result> results;
+    for (bench_case const & c : cases_)
+    {
+        if ((c.name + ' ' + c.params).find(options.filter) == std::string::npos)
+            continue;
+
+        // Also warms up the caches and whatever the case allocates lazily
+        std::size_t iterations = 1, items = 0;
+        while (time_ns(c, iterations, items) < options.min_time_ms * 1e6 && iterations < (std::size_t(1) << 40))
+            iterations *= 2;
+
+        std::vector<double> times;
+        std::size_t total_items = 0;
+        for (int r = 0; r < std::max(options.repetitions, 1); ++r)
+        {
+            times.push_back(time_ns(c, iterations, items) / iterations);
+            total_items += items;
+        }
+        std::sort(times.begin(), times.end());
+
+        double total_ns = 0.0;
+        for (double t : times)
+            total_ns += t * iterations;
+
+        bench_result result;
+        result.name = c.name;
+        result.params = c.params;
+        result.iterations = iterations;
+        result.repetitions = times.size();
+        result.ns = times[times.size() / 2];
+        result.min_ns = times.front();
+        result.max_ns = times.back();
+        result.items_per_second = total_items / std::max(total_ns * 1e-9, 1e-12);
+        results.push_back(result);
+    }
+    return results;
+}
+
+static std::string json_string (const std::string & s)
+{
+    std::string result = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+void write_results (std::ostream & out, const std::vector<bench_result> & results, bench_options::format_type format)
+{
+    out << std::setprecision(6);
+
+    if (format == bench_options::format_csv)
+    {
+        out << "name,params,iterations,repetitions,ns,min_ns,max_ns,items_per_second\n";
+        for (bench_result const & r : results)
+            out << r.name << ',' << r.params << ',' << r.iterations << ',' << r.repetitions << ','
+                << r.ns << ',' << r.min_ns << ',' << r.max_ns << ',' << r.items_per_second << '\n';
+    }
+    else if (format == bench_options::format_json)
+    {
+        out << "{\n  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n  \"benchmarks\": [";
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            bench_result const & r = results[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << "    {\"name\": " << json_string(r.name) << ", \"params\": " << json_string(r.params)
+                << ", \"iterations\": " << r.iterations << ", \"repetitions\": " << r.repetitions
+                << ", \"ns\": " << r.ns << ", \"min_ns\": " << r.min_ns << ", \"max_ns\": " << r.max_ns
+                << ", \"items_per_second\": " << r.items_per_second << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+    else
+    {
+        out << std::fixed << std::setprecision(1);
+        for (bench_result const & r : results)
+            out << std::left << std::setw(24) << r.name << std::setw(40) << r.params << std::right
+                << std::setw(14) << r.ns << " ns" << std::setw(10) << r.items_per_second / 1e6 << " M items/s"
+                << "  (" << r.min_ns << " to " << r.max_ns << ", " << r.iterations << " x " << r.repetitions << ")\n";
+    }
+}
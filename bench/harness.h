@@ -0,0 +1,79 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// A case runs the measured operation the given number of times and
+// returns how many items that processed, e.g. cubes or faces
+typedef std::function<std::size_t (std::size_t iterations)> bench_function;
+
+struct bench_case
+{
+    std::string name;
+    std::string params;
+    bench_function run;
+};
+
+struct bench_options
+{
+    enum format_type
+    {
+        format_text,
+        format_csv,
+        format_json
+    };
+
+    std::string filter;
+    double min_time_ms;
+    int repetitions;
+    format_type format;
+
+    bench_options ( )
+        : min_time_ms(50.0)
+        , repetitions(5)
+        , format(format_text)
+    { }
+};
+
+// Times are per iteration, the median and the extremes of the repetitions
+struct bench_result
+{
+    std::string name;
+    std::string params;
+    std::size_t iterations;
+    int repetitions;
+    double ns;
+    double min_ns, max_ns;
+    double items_per_second;
+};
+
+// Every case is first run with more and more iterations until a run takes
+// min_time_ms, then repeated with that many
+class bench_registry
+{
+public:
+    void add (const std::string & name, const std::string & params, const bench_function & run);
+
+    const std::vector<bench_case> & cases ( ) const { return cases_; }
+
+    // Only the cases whose "name params" contains the filter
+    std::vector<bench_result> run (const bench_options & options) const;
+
+private:
+    std::vector<bench_case> cases_;
+};
+
+void write_results (std::ostream & out, const std::vector<bench_result> & results, bench_options::format_type format);
+
+// Keeps the compiler from dropping work whose result is never used
+template <typename T>
+inline void keep (const T & value)
+{
+    asm volatile ("" : : "r"(&value) : "memory");
+}
+
+#endif // HARNESS_H
@@ -0,0 +1,601 @@
+#include "harness.h"
+
+#include "cube.h"
+#include "player.h"
+#include "world.h"
+#include "generator.h"
+#include "physics.h"
+#include "mesh.h"
+#include "face_mesher.h"
+#include "frame_arena.h"
+#include "debris.h"
+#include "bodies.h"
+#include "raycast.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+static const int start = -1;
+
+// Either generated terrain, or a box of random cubes with the given
+// fraction of cells filled
+struct world_params
+{
+    int size;
+    double density;
+
+    std::string describe ( ) const
+    {
+        std::ostringstream oss;
+        oss << "size=" << size;
+        if (density > 0.0)
+            oss << " density=" << density;
+        else
+            oss << " terrain";
+        return oss.str();
+    }
+};
+
+// How chunk faces were meshed before face_mesher: the runtime-built
+// planes of make_mesh, copied into the arrays one value at a time
+class reference_arrays
+{
+public:
+    explicit reference_arrays (std::vector<double> & out)
+        : out(out)
+    { }
+
+    template <int Plane>
+    void face (int x, int y, int z, const color & c, int layer)
+    {
+        plane const & pl = make_mesh(cube_position(x, y, z)).planes[Plane];
+        for (int i = 0; i < 4; ++i)
+        {
+            out.push_back(pl.coords[3 * i + 0]);
+            out.push_back(pl.coords[3 * i + 1]);
+            out.push_back(pl.coords[3 * i + 2]);
+            out.push_back(pl.dx);
+            out.push_back(pl.dy);
+            out.push_back(pl.dz);
+            out.push_back(plane::tex_coords[2 * i + 0]);
+            out.push_back(plane::tex_coords[2 * i + 1]);
+            out.push_back(layer);
+            for (int k = 0; k < 4; ++k)
+                out.push_back(c.data[k]);
+        }
+    }
+
+private:
+    std::vector<double> & out;
+};
+
+// The opaque faces of all chunks; only the format differs between cases
+template <typename Format>
+static std::size_t mesh_chunks (const world & w, Format & out)
+{
+    std::size_t faces = 0;
+    for (auto const & cp : w.chunks())
+    {
+        if (cp.second.count == 0)
+            continue;
+        const voxel * voxels = w.cells(cp.first, cp.second);
+        for (int p = 0; p < 6; ++p)
+            faces += mesh_plane(p, w, cp.first, voxels, opaque_faces, out);
+    }
+    return faces;
+}
+
+static std::shared_ptr<world> make_world (world_params p)
+{
+    std::shared_ptr<world> w = std::make_shared<world>();
+    if (p.density <= 0.0)
+    {
+        generate_world(*w, p.size, start, 0.5, 0.25);
+        return w;
+    }
+
+    std::default_random_engine random(p.size);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    for (int x = 0; x < p.size; ++x)
+        for (int y = 0; y < chunk_size; ++y)
+            for (int z = 0; z < p.size; ++z)
+                if (chance(random) < p.density)
+                    w->add_cube(cube_position(x, start + y, z), 0.5, 0.25);
+    return w;
+}
+
+// Player positions relative to the middle of a world
+enum position_kind
+{
+    position_surface,
+    position_air,
+    position_buried
+};
+
+static const char * position_names[] = {"surface", "air", "buried"};
+
+static player place_player (const world & w, int size, position_kind kind)
+{
+    player pl;
+    pl.x = size * 0.5;
+    pl.z = size * 0.5;
+    double surface = standing_height(w, pl.x, pl.z, start + 10);
+    pl.y = kind == position_air ? surface + 10.0 : (kind == position_buried ? surface - 4.0 : surface);
+    pl.init();
+    return pl;
+}
+
+// Cubes around the origin, and where a player is among them
+static std::vector<cube_position> cube_block ( )
+{
+    std::vector<cube_position> cubes;
+    for (int x = -2; x <= 1; ++x)
+        for (int y = -2; y <= 1; ++y)
+            for (int z = -2; z <= 1; ++z)
+                cubes.push_back(cube_position(x, y, z));
+    return cubes;
+}
+
+static player player_near_block (position_kind kind)
+{
+    player pl;
+    pl.x = 0.3;
+    pl.z = 0.2;
+    pl.y = kind == position_air ? 12.0 : (kind == position_buried ? -0.7 : 2.2);
+    pl.init();
+    return pl;
+}
+
+static void add_primitive_cases (bench_registry & r)
+{
+    r.add("make_mesh", "", [](std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            cube c = make_mesh(cube_position(i & 31, (i >> 5) & 15, (i >> 9) & 31));
+            keep(c);
+        }
+        return n;
+    });
+
+    r.add("colored_cube", "", [](std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            cube c = colored_cube(cube_position(i & 31, (i >> 5) & 15, (i >> 9) & 31), (i & 63) / 64.0, 0.5);
+            keep(c);
+        }
+        return n;
+    });
+
+    for (int steps : {8, 1024})
+    {
+        std::ostringstream params;
+        params << "hues=" << steps;
+        r.add("get_color", params.str(), [steps](std::size_t n)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                color c = get_color(0.25 + (i & 3) * 0.25, static_cast<double>(i % steps) / steps);
+                keep(c);
+            }
+            return n;
+        });
+    }
+
+    std::vector<cube_position> cubes = cube_block();
+    for (position_kind kind : {position_surface, position_air, position_buried})
+    {
+        std::string params = std::string("position=") + position_names[kind];
+        player pl = player_near_block(kind);
+
+        r.add("player::has_collision", params, [pl, cubes](std::size_t n)
+        {
+            int hits = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                for (cube_position const & c : cubes)
+                    hits += pl.has_collision(c);
+            keep(hits);
+            return n * cubes.size();
+        });
+
+        r.add("player::collide", params, [pl, cubes](std::size_t n)
+        {
+            int landed = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                player moved = pl;
+                for (cube_position const & c : cubes)
+                    landed += moved.collide(c);
+            }
+            keep(landed);
+            return n * cubes.size();
+        });
+    }
+}
+
+static void add_world_cases (bench_registry & r, world_params p)
+{
+    std::shared_ptr<world> w = make_world(p);
+    std::string params = p.describe();
+
+    for (position_kind kind : {position_surface, position_air, position_buried})
+    {
+        player pl = place_player(*w, p.size, kind);
+        r.add("collide", params + " position=" + position_names[kind], [w, pl](std::size_t n)
+        {
+            int landed = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                player moved = pl;
+                landed += collide(moved, *w);
+            }
+            keep(landed);
+            return n;
+        });
+    }
+
+    player eye = place_player(*w, p.size, position_surface);
+
+    std::shared_ptr<frame_arena> arena = std::make_shared<frame_arena>();
+    r.add("build_mesh", params, [w, eye, arena](std::size_t n)
+    {
+        std::size_t faces = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            arena->reset();
+            mesh m(*arena);
+            build_mesh(*w, eye._x, eye._y, eye._z, m);
+            faces += m.faces;
+        }
+        return faces;
+    });
+
+    r.add("mesh_cache::update", params, [w](std::size_t n)
+    {
+        std::size_t faces = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            mesh_cache cache;
+            cache.update(*w);
+            faces += cache.faces();
+        }
+        return faces;
+    });
+
+    r.add("mesh_plane", params + " format=reference", [w](std::size_t n)
+    {
+        std::vector<double> out;
+        reference_arrays format(out);
+        std::size_t faces = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            out.clear();
+            faces += mesh_chunks(*w, format);
+        }
+        return faces;
+    });
+
+    r.add("mesh_plane", params + " format=doubles", [w](std::size_t n)
+    {
+        std::vector<double> vertices, tex_coords, colors, normals;
+        double_arrays<std::vector<double>> format(vertices, tex_coords, colors, normals);
+        std::size_t faces = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            vertices.clear();
+            tex_coords.clear();
+            colors.clear();
+            normals.clear();
+            faces += mesh_chunks(*w, format);
+        }
+        return faces;
+    });
+
+    r.add("mesh_plane", params + " format=packed", [w](std::size_t n)
+    {
+        std::vector<packed_vertex> vertices;
+        packed_vertices<std::vector<packed_vertex>> format(vertices);
+        std::size_t faces = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            vertices.clear();
+            faces += mesh_chunks(*w, format);
+        }
+        return faces;
+    });
+
+    // What chunk_renderer does on the CPU when the eye enters another chunk
+    // or a mesh changes: the draw commands, sorted, with every mesh placed
+    // right after the previous one
+    std::shared_ptr<mesh_cache> cache = std::make_shared<mesh_cache>();
+    cache->update(*w);
+    std::shared_ptr<std::vector<std::size_t>> firsts = std::make_shared<std::vector<std::size_t>>();
+    std::size_t placed = 0;
+    for (auto const & cm : cache->meshes())
+    {
+        firsts->push_back(placed);
+        placed += cm.second.vertices.size();
+    }
+    std::shared_ptr<frame_arena> scratch = std::make_shared<frame_arena>();
+    r.add("build_draw_commands", params, [cache, firsts, scratch, eye](std::size_t n)
+    {
+        std::vector<draw_command> commands;
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            scratch->reset();
+            build_draw_commands(*cache, firsts->data(), eye._x, eye._y, eye._z, *scratch, commands);
+            total += commands.size();
+        }
+        return total;
+    });
+}
+
+// Particles raining onto terrain; each iteration is one 60 Hz tick, and
+// the rain starts over whenever it has landed
+static void add_debris_cases (bench_registry & r)
+{
+    std::shared_ptr<world> w = make_world(world_params{70, 0.0});
+
+    for (std::size_t count : {10000, 100000})
+    {
+        std::ostringstream params;
+        params << "size=70 particles=" << count;
+        std::shared_ptr<debris> d = std::make_shared<debris>();
+        r.add("debris::tick", params.str(), [w, d, count](std::size_t n)
+        {
+            std::default_random_engine random(7);
+            std::uniform_real_distribution<float> coordinate(0.0f, 70.0f), height(4.0f, 24.0f), speed(-2.0f, 2.0f);
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                if (i % 120 == 0)
+                {
+                    d->clear();
+                    while (d->size() < count)
+                        d->add(coordinate(random), height(random), coordinate(random), speed(random), speed(random), speed(random), 0xffffffffu, 10.0f);
+                }
+                d->tick(*w, 1.0 / 60.0);
+            }
+            return n * count;
+        });
+    }
+}
+
+// Walkers standing on terrain, each holding a random direction, all
+// moved one tick: one at a time through advance and collide, and batched
+static std::vector<player> make_walkers (const world & w, int size, std::size_t count)
+{
+    std::default_random_engine random(13);
+    std::uniform_real_distribution<double> coordinate(0.0, size), angle(0.0, 6.28);
+    std::uniform_int_distribution<int> direction(-1, 1);
+
+    std::vector<player> walkers(count);
+    for (player & pl : walkers)
+    {
+        pl.x = pl._x = coordinate(random);
+        pl.z = pl._z = coordinate(random);
+        pl.y = pl._y = standing_height(w, pl.x, pl.z, start + 10);
+        pl.vy = 0.0;
+        pl.alpha = angle(random);
+        pl.beta = 0.0;
+        pl.move_forward = direction(random);
+        pl.move_sideward = direction(random);
+        pl.move_upward = 0;
+    }
+    return walkers;
+}
+
+static void add_body_cases (bench_registry & r)
+{
+    const int size = 128;
+    const double dt = 1.0 / 60.0;
+    std::shared_ptr<world> w = make_world(world_params{size, 0.0});
+    std::shared_ptr<worker_pool> pool = std::make_shared<worker_pool>();
+
+    for (std::size_t count : {1000, 10000})
+    {
+        std::ostringstream params;
+        params << "size=128 bodies=" << count;
+        std::shared_ptr<std::vector<player>> walkers = std::make_shared<std::vector<player>>(make_walkers(*w, size, count));
+
+        r.add("advance+collide", params.str(), [w, walkers, dt](std::size_t n)
+        {
+            std::vector<player> moved;
+            std::size_t landed = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                if (i % 120 == 0)
+                    moved = *walkers;
+                for (player & pl : moved)
+                {
+                    advance(pl, dt, true);
+                    landed += collide(pl, *w);
+                }
+            }
+            keep(landed);
+            return n * moved.size();
+        });
+
+        std::shared_ptr<bodies> b = std::make_shared<bodies>();
+        r.add("bodies::step", params.str(), [w, pool, walkers, b, dt](std::size_t n)
+        {
+            std::size_t landed = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                if (i % 120 == 0)
+                {
+                    b->clear();
+                    for (player const & pl : *walkers)
+                        b->add(pl);
+                }
+                b->step(*w, *pool, dt);
+                landed += b->stats().collisions;
+            }
+            keep(landed);
+            return n * b->size();
+        });
+    }
+}
+
+// Queries of the three kinds cast_rays is for, on terrain: picking from
+// where a player stands, sky light from cells under the surface, and
+// line of sight between walkers
+enum ray_kind
+{
+    rays_picking,
+    rays_sky,
+    rays_sight
+};
+
+static const char * ray_kind_names[] = {"picking", "sky", "sight"};
+
+static std::vector<ray> make_rays (const world & w, int size, ray_kind kind, std::size_t count)
+{
+    std::default_random_engine random(11);
+    std::uniform_real_distribution<double> coordinate(0.0, size), unit(-1.0, 1.0), depth(0.0, 6.0);
+    auto surface = [&w](double x, double z){ return standing_height(w, x, z, start + 10); };
+
+    std::vector<ray> rays;
+    while (rays.size() < count)
+    {
+        ray q;
+        q.x = coordinate(random);
+        q.z = coordinate(random);
+        q.y = surface(q.x, q.z) + 1.0;
+        if (kind == rays_picking)
+        {
+            q.dx = unit(random);
+            q.dy = unit(random);
+            q.dz = unit(random);
+            q.max_distance = 8.0 / std::sqrt(q.dx * q.dx + q.dy * q.dy + q.dz * q.dz);
+        }
+        else if (kind == rays_sky)
+        {
+            q.y -= depth(random);
+            q.dx = q.dz = 0.0;
+            q.dy = 1.0;
+            q.max_distance = 64.0;
+        }
+        else
+        {
+            // The whole way to the other walker is distance 1
+            double tx = coordinate(random), tz = coordinate(random);
+            q.dx = tx - q.x;
+            q.dy = surface(tx, tz) + 1.0 - q.y;
+            q.dz = tz - q.z;
+            q.max_distance = 1.0;
+        }
+        rays.push_back(q);
+    }
+    return rays;
+}
+
+static void add_ray_cases (bench_registry & r)
+{
+    const int size = 128;
+    const std::size_t count = 4096;
+    std::shared_ptr<world> w = make_world(world_params{size, 0.0});
+
+    for (ray_kind kind : {rays_picking, rays_sky, rays_sight})
+    {
+        std::shared_ptr<std::vector<ray>> rays = std::make_shared<std::vector<ray>>(make_rays(*w, size, kind, count));
+        std::string params = std::string("size=128 kind=") + ray_kind_names[kind];
+
+        r.add("cast_ray", params, [w, rays](std::size_t n)
+        {
+            std::size_t found = 0;
+            ray_hit hit;
+            for (std::size_t i = 0; i < n; ++i)
+                for (ray const & q : *rays)
+                    found += cast_ray(*w, q.x, q.y, q.z, q.dx, q.dy, q.dz, q.max_distance, hit);
+            keep(found);
+            return n * rays->size();
+        });
+
+        std::shared_ptr<std::vector<ray_hit>> hits = std::make_shared<std::vector<ray_hit>>(count);
+        r.add("cast_rays", params, [w, rays, hits](std::size_t n)
+        {
+            std::size_t found = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                found += cast_rays(*w, rays->data(), rays->size(), hits->data());
+            keep(found);
+            return n * rays->size();
+        });
+    }
+}
+
+static void usage (const char * name)
+{
+    std::cerr << "Usage: " << name << " [--filter TEXT] [--min-time MS] [--repetitions N] [--format text|csv|json] [--list]\n"
+        << "  --filter TEXT    only cases whose name and parameters contain TEXT\n"
+        << "  --min-time MS    shortest run to measure (default 50)\n"
+        << "  --repetitions N  runs per case; the median is reported (default 5)\n"
+        << "  --format F       text for people, csv or json for scripts (default text)\n"
+        << "  --list           print the cases and exit\n";
+}
+
+int main (int argc, char ** argv)
+{
+    bench_options options;
+    bool list = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            options.filter = argv[++i];
+        else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            options.min_time_ms = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+            options.repetitions = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            std::string format = argv[++i];
+            if (format == "csv")
+                options.format = bench_options::format_csv;
+            else if (format == "json")
+                options.format = bench_options::format_json;
+            else if (format == "text")
+                options.format = bench_options::format_text;
+            else
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--list") == 0)
+            list = true;
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bench_registry registry;
+    add_primitive_cases(registry);
+
+    world_params worlds[] = {{32, 0.0}, {70, 0.0}, {128, 0.0}, {32, 0.1}, {32, 0.5}, {32, 0.9}};
+    for (world_params const & p : worlds)
+        add_world_cases(registry, p);
+    add_debris_cases(registry);
+    add_body_cases(registry);
+    add_ray_cases(registry);
+
+    if (list)
+    {
+        for (bench_case const & c : registry.cases())
+            std::cout << c.name << ' ' << c.params << '\n';
+        return 0;
+    }
+
+    write_results(std::cout, registry.run(options), options.format);
+    return 0;
+}
@@ -0,0 +1,345 @@
+#include "bodies.h"
+#include "physics.h"
+
+#include <algorithm>
+#include <cmath>
+
+// player::has_collision ignores cubes further than 4 units away, and
+// collide only looks that far
+static const int reach = 4;
+
+// Bodies integrated by one task
+static const std::size_t integrate_range = 256;
+
+body_shape body_shape::of_player ( )
+{
+    body_shape s;
+    s.size_x = player::size_x;
+    s.size_y_top = player::size_y_top;
+    s.size_y_bottom = player::size_y_bottom;
+    s.size_z = player::size_z;
+    return s;
+}
+
+bodies::bodies ( )
+    : step_(0)
+{
+    stats_.count = stats_.groups = stats_.masks_built = stats_.cells_tested = stats_.collisions = 0;
+}
+
+std::size_t bodies::add (const player & pl, const body_shape & shape)
+{
+    x_.push_back(pl.x);
+    y_.push_back(pl.y);
+    z_.push_back(pl.z);
+    sx_.push_back(pl._x);
+    sy_.push_back(pl._y);
+    sz_.push_back(pl._z);
+    vy_.push_back(pl.vy);
+    alpha_.push_back(pl.alpha);
+    size_x_.push_back(shape.size_x);
+    size_top_.push_back(shape.size_y_top);
+    size_bottom_.push_back(shape.size_y_bottom);
+    size_z_.push_back(shape.size_z);
+    forward_.push_back(pl.move_forward);
+    sideward_.push_back(pl.move_sideward);
+    upward_.push_back(pl.move_upward);
+    gravity_.push_back(1);
+    on_surface_.push_back(0);
+
+    stats_.count = size();
+    return size() - 1;
+}
+
+template <typename Vector>
+static void move_last (Vector & v, std::size_t i)
+{
+    v[i] = v.back();
+    v.pop_back();
+}
+
+void bodies::remove (std::size_t i)
+{
+    move_last(x_, i);
+    move_last(y_, i);
+    move_last(z_, i);
+    move_last(sx_, i);
+    move_last(sy_, i);
+    move_last(sz_, i);
+    move_last(vy_, i);
+    move_last(alpha_, i);
+    move_last(size_x_, i);
+    move_last(size_top_, i);
+    move_last(size_bottom_, i);
+    move_last(size_z_, i);
+    move_last(forward_, i);
+    move_last(sideward_, i);
+    move_last(upward_, i);
+    move_last(gravity_, i);
+    move_last(on_surface_, i);
+
+    stats_.count = size();
+}
+
+void bodies::clear ( )
+{
+    for (double_vector * v : {&x_, &y_, &z_, &sx_, &sy_, &sz_, &vy_, &alpha_, &size_x_, &size_top_, &size_bottom_, &size_z_})
+        v->clear();
+    for (flag_vector * v : {&forward_, &sideward_, &upward_, &gravity_, &on_surface_})
+        v->clear();
+
+    // The blocking cells stay, for the bodies added next
+    stats_.count = 0;
+}
+
+void bodies::steer (std::size_t i, int forward, int sideward, int upward, double alpha, bool gravity)
+{
+    forward_[i] = forward;
+    sideward_[i] = sideward;
+    upward_[i] = upward;
+    alpha_[i] = alpha;
+    gravity_[i] = gravity;
+}
+
+void bodies::set_position (std::size_t i, const player & pl)
+{
+    x_[i] = pl.x;
+    y_[i] = pl.y;
+    z_[i] = pl.z;
+    sx_[i] = pl._x;
+    sy_[i] = pl._y;
+    sz_[i] = pl._z;
+    vy_[i] = pl.vy;
+}
+
+void bodies::get (std::size_t i, player & pl) const
+{
+    pl.x = x_[i];
+    pl.y = y_[i];
+    pl.z = z_[i];
+    pl._x = sx_[i];
+    pl._y = sy_[i];
+    pl._z = sz_[i];
+    pl.vy = vy_[i];
+}
+
+// advance, written out the way player::move and player::smooth compute it
+void bodies::integrate (std::size_t first, std::size_t last, double dt)
+{
+    double step = player_speed * dt;
+    double smooth = 0.99;
+    for (std::size_t i = first; i < last; ++i)
+    {
+        if (gravity_[i])
+            vy_[i] -= gravity * dt;
+
+        double scale = step;
+        if (forward_[i] != 0 && sideward_[i] != 0)
+            scale /= sqrt(2.0);
+
+        double s = sin(alpha_[i]), c = cos(alpha_[i]);
+        x_[i] += scale * forward_[i] * s;
+        z_[i] -= scale * forward_[i] * c;
+        x_[i] += scale * sideward_[i] * c;
+        z_[i] += scale * sideward_[i] * s;
+        y_[i] += step * upward_[i];
+        y_[i] += vy_[i] * step;
+
+        sx_[i] += (x_[i] - sx_[i]) * step * smooth;
+        sy_[i] += (y_[i] - sy_[i]) * step * smooth;
+        sz_[i] += (z_[i] - sz_[i]) * step * smooth;
+    }
+}
+
+const bodies::blocking_cells * bodies::mask (const world & w, chunk_position p)
+{
+    auto c = w.chunks().find(p);
+    if (c == w.chunks().end() || c->second.count == 0)
+        return nullptr;
+
+    auto inserted = masks_.insert(std::make_pair(p, blocking_cells()));
+    blocking_cells & m = inserted.first->second;
+    if (inserted.second || m.revision != c->second.revision)
+    {
+        // Water doesn't stop anyone
+        const voxel * voxels = w.cells(p, c->second);
+        m.revision = c->second.revision;
+        m.blocks = 0;
+        std::fill(m.cells, m.cells + chunk_volume / 64, 0);
+        for (int i = 0; i < chunk_volume; ++i)
+            if (voxels[i].solid && voxels[i].material != material_water)
+            {
+                m.cells[i / 64] |= std::uint64_t(1) << (i % 64);
+                m.blocks |= std::uint64_t(1) << block_of(i);
+            }
+        ++stats_.masks_built;
+    }
+    m.used = step_;
+    return m.blocks != 0 ? &m : nullptr;
+}
+
+// collide, visiting the cubes in the order for_each_in_region does, and
+// skipping the blocks that can't touch the body where it is by then
+void bodies::collide (std::size_t i, const group & g, std::size_t & tested, std::size_t & collided)
+{
+    const double size_x = size_x_[i], size_y_top = size_top_[i], size_y_bottom = size_bottom_[i], size_z = size_z_[i];
+    double & x = x_[i], & y = y_[i], & z = z_[i];
+    double & _x = sx_[i], & _y = sy_[i], & _z = sz_[i];
+
+    int px = static_cast<int>(std::floor(_x + 0.5));
+    int py = static_cast<int>(std::floor(_y + 0.5));
+    int pz = static_cast<int>(std::floor(_z + 0.5));
+    cube_position min(px - reach, py - reach, pz - reach), max(px + reach, py + reach, pz + reach);
+    chunk_position lo = chunk_of(min), hi = chunk_of(max);
+
+    bool on_surface = false;
+    for (int cx = lo.x; cx <= hi.x; ++cx)
+        for (int cy = lo.y; cy <= hi.y; ++cy)
+            for (int cz = lo.z; cz <= hi.z; ++cz)
+            {
+                const blocking_cells * m = g.around[(cx - g.chunk.x + 1) * 9 + (cy - g.chunk.y + 1) * 3 + (cz - g.chunk.z + 1)];
+                if (!m)
+                    continue;
+
+                int base_x = cx * chunk_size, base_y = cy * chunk_size, base_z = cz * chunk_size;
+                int x0 = std::max(min.x - base_x, 0), x1 = std::min(max.x - base_x, chunk_size - 1);
+                int y0 = std::max(min.y - base_y, 0), y1 = std::min(max.y - base_y, chunk_size - 1);
+                int z0 = std::max(min.z - base_z, 0), z1 = std::min(max.z - base_z, chunk_size - 1);
+
+                for (int bx = x0 / block_size; bx <= x1 / block_size; ++bx)
+                    for (int by = y0 / block_size; by <= y1 / block_size; ++by)
+                        for (int bz = z0 / block_size; bz <= z1 / block_size; ++bz)
+                        {
+                            if (!((m->blocks >> block_index(bx, by, bz)) & 1))
+                                continue;
+
+                            int lx0 = std::max(bx * block_size, x0), lx1 = std::min(bx * block_size + block_size - 1, x1);
+                            int ly0 = std::max(by * block_size, y0), ly1 = std::min(by * block_size + block_size - 1, y1);
+                            int lz0 = std::max(bz * block_size, z0), lz1 = std::min(bz * block_size + block_size - 1, z1);
+
+                            // The tests below fail for every cube of the block
+                            if (_x - (base_x + lx1) >= 0.5 + size_x || _x - (base_x + lx0) <= - 0.5 - size_x
+                                || _y - (base_y + ly1) >= 0.5 + size_y_bottom || _y - (base_y + ly0) <= - 0.5 - size_y_top
+                                || _z - (base_z + lz1) >= 0.5 + size_z || _z - (base_z + lz0) <= - 0.5 - size_z)
+                                continue;
+
+                            for (int lx = lx0; lx <= lx1; ++lx)
+                                for (int ly = ly0; ly <= ly1; ++ly)
+                                    for (int lz = lz0; lz <= lz1; ++lz)
+                                    {
+                                        int index = voxel_index(lx, ly, lz);
+                                        if (!((m->cells[index / 64] >> (index % 64)) & 1))
+                                            continue;
+                                        ++tested;
+
+                                        // From here on player::collide, for the cube at c
+                                        cube_position c(base_x + lx, base_y + ly, base_z + lz);
+                                        double tx = _x - c.x;
+                                        double ty = _y - c.y;
+                                        double tz = _z - c.z;
+
+                                        if (tx * tx + ty * ty + tz * tz > 16.0)
+                                            continue;
+
+                                        double dx = fabs(tx);
+                                        double dy = fabs(ty);
+                                        double dz = fabs(tz);
+
+                                        bool collision = (dx < 0.5 + size_x) && ((ty > 0 && ty < 0.5 + size_y_bottom) || (ty < 0 && ty > - 0.5 - size_y_top)) && (dz < 0.5 + size_z);
+                                        if (!collision)
+                                            continue;
+                                        ++collided;
+
+                                        if (dx > dy && dx > dz)
+                                        {
+                                            if (tx > 0 && tx < 0.5 + size_x) x = c.x + 0.5 + size_x;
+                                            if (tx < 0 && tx > - 0.5 - size_x) x = c.x - 0.5 - size_x;
+                                            _x = x;
+                                        }
+                                        else if (dy > dz)
+                                        {
+                                            if (dx < 0.5 && dz < 0.5)
+                                            {
+                                                if (ty > 0 && ty < 0.5 + size_y_bottom)
+                                                {
+                                                    y = c.y + 0.5 + size_y_bottom;
+                                                    on_surface = true;
+                                                    vy_[i] = 0.0;
+                                                }
+                                                if (ty < 0 && ty > - 0.5 - size_y_top) y = c.y - 0.5 - size_y_top;
+                                                _y = y;
+                                            }
+                                        }
+                                        else
+                                        {
+                                            if (tz > 0 && tz < 0.5 + size_z) z = c.z + 0.5 + size_z;
+                                            if (tz < 0 && tz > - 0.5 - size_z) z = c.z - 0.5 - size_z;
+                                            _z = z;
+                                        }
+                                    }
+                        }
+            }
+
+    on_surface_[i] = on_surface;
+}
+
+void bodies::step (const world & w, worker_pool & pool, double dt)
+{
+    ++step_;
+    std::size_t n = size();
+    stats_.groups = stats_.masks_built = stats_.cells_tested = stats_.collisions = 0;
+
+    pool.run((n + integrate_range - 1) / integrate_range, [this, n, dt](std::size_t item, unsigned int)
+    {
+        integrate(item * integrate_range, std::min(n, (item + 1) * integrate_range), dt);
+    });
+
+    // Bodies in the same chunk look at the same blocking cells
+    order_.clear();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        cube_position cell(static_cast<int>(std::floor(sx_[i] + 0.5)), static_cast<int>(std::floor(sy_[i] + 0.5)), static_cast<int>(std::floor(sz_[i] + 0.5)));
+        order_.push_back(std::make_pair(chunk_of(cell), i));
+    }
+    std::sort(order_.begin(), order_.end());
+
+    groups_.clear();
+    for (std::size_t i = 0; i < n; )
+    {
+        group g;
+        g.first = i;
+        g.chunk = order_[i].first;
+        while (i < n && order_[i].first == g.chunk)
+            ++i;
+        g.count = i - g.first;
+
+        for (int dx = -1; dx <= 1; ++dx)
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dz = -1; dz <= 1; ++dz)
+                    g.around[(dx + 1) * 9 + (dy + 1) * 3 + (dz + 1)] = mask(w, chunk_position(g.chunk.x + dx, g.chunk.y + dy, g.chunk.z + dz));
+        groups_.push_back(g);
+    }
+
+    // Chunks no body is near any more; the others keep their addresses
+    for (auto it = masks_.begin(); it != masks_.end(); )
+        if (it->second.used != step_)
+            it = masks_.erase(it);
+        else
+            ++it;
+
+    tested_.assign(pool.size(), 0);
+    collided_.assign(pool.size(), 0);
+    pool.run(groups_.size(), [this](std::size_t item, unsigned int worker)
+    {
+        group const & g = groups_[item];
+        for (std::size_t k = g.first; k < g.first + g.count; ++k)
+            collide(order_[k].second, g, tested_[worker], collided_[worker]);
+    });
+
+    stats_.groups = groups_.size();
+    for (unsigned int k = 0; k < pool.size(); ++k)
+    {
+        stats_.cells_tested += tested_[k];
+        stats_.collisions += collided_[k];
+    }
+}
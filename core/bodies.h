@@ -0,0 +1,118 @@
+#ifndef BODIES_H
+#define BODIES_H
+
+#include "player.h"
+#include "world.h"
+#include "worker_pool.h"
+#include "memory_stats.h"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// How far a body reaches from its position: the player is a box of
+// size_x by size_z around it, from size_y_bottom below to size_y_top above
+struct body_shape
+{
+    double size_x, size_y_top, size_y_bottom, size_z;
+
+    static body_shape of_player ( );
+};
+
+// Many boxes that move and collide with the world like the player does,
+// with advance and collide, and end up exactly where those would put
+// them. Every component is a separate array. A step integrates them all,
+// then sorts them by chunk and lets the workers resolve the collisions of
+// a chunk's bodies each. What blocks bodies is read from a bit per cell,
+// made once per chunk revision on the calling thread, so the workers
+// never touch the voxels or the world's cache.
+class bodies
+{
+public:
+    typedef std::vector<double, tracked_allocator<double, memory_bodies>> double_vector;
+    typedef std::vector<signed char, tracked_allocator<signed char, memory_bodies>> flag_vector;
+
+    struct statistics
+    {
+        std::size_t count;
+
+        // In the last step
+        std::size_t groups;
+        std::size_t masks_built;
+        std::size_t cells_tested;
+        std::size_t collisions;
+    };
+
+    bodies ( );
+
+    // Returns the index of the new body
+    std::size_t add (const player & pl, const body_shape & shape = body_shape::of_player());
+
+    // The last body takes the place of the removed one
+    void remove (std::size_t i);
+    void clear ( );
+
+    std::size_t size ( ) const { return x_.size(); }
+
+    // What the player's move_ fields and alpha do
+    void steer (std::size_t i, int forward, int sideward, int upward, double alpha, bool gravity);
+    void set_position (std::size_t i, const player & pl);
+    void set_vy (std::size_t i, double vy) { vy_[i] = vy; }
+
+    // Copies the position, smoothed position and speed into pl
+    void get (std::size_t i, player & pl) const;
+
+    bool on_surface (std::size_t i) const { return on_surface_[i] != 0; }
+
+    // The smoothed positions, as player::_x and so on
+    const double * x ( ) const { return sx_.data(); }
+    const double * y ( ) const { return sy_.data(); }
+    const double * z ( ) const { return sz_.data(); }
+
+    // advance, then collide, for every body
+    void step (const world & w, worker_pool & pool, double dt);
+
+    const statistics & stats ( ) const { return stats_; }
+
+private:
+    // Cells that block bodies, solid and not water, in voxel_index order,
+    // and a bit per block that has any
+    struct blocking_cells
+    {
+        unsigned int revision;
+        unsigned int used;
+        std::uint64_t blocks;
+        std::uint64_t cells[chunk_volume / 64];
+    };
+
+    // Bodies in one chunk, and the blocking cells of it and its neighbours
+    struct group
+    {
+        std::size_t first, count;
+        chunk_position chunk;
+        const blocking_cells * around[27];
+    };
+
+    double_vector x_, y_, z_;
+    double_vector sx_, sy_, sz_;
+    double_vector vy_, alpha_;
+    double_vector size_x_, size_top_, size_bottom_, size_z_;
+    flag_vector forward_, sideward_, upward_;
+    flag_vector gravity_, on_surface_;
+
+    std::unordered_map<chunk_position, blocking_cells, chunk_position_hash> masks_;
+    unsigned int step_;
+
+    std::vector<std::pair<chunk_position, std::size_t>> order_;
+    std::vector<group> groups_;
+    std::vector<std::size_t> tested_, collided_;
+
+    statistics stats_;
+
+    const blocking_cells * mask (const world & w, chunk_position p);
+    void integrate (std::size_t first, std::size_t last, double dt);
+    void collide (std::size_t i, const group & g, std::size_t & tested, std::size_t & collided);
+};
+
+#endif // BODIES_H
@@ -0,0 +1,129 @@
+#include "byte_stream.h"
+
+#include <cstring>
+
+void byte_writer::write_u8 (unsigned int value)
+{
+    data.push_back(value & 0xff);
+}
+
+void byte_writer::write_u16 (unsigned int value)
+{
+    write_u8(value);
+    write_u8(value >> 8);
+}
+
+void byte_writer::write_u32 (std::uint32_t value)
+{
+    write_u16(value);
+    write_u16(value >> 16);
+}
+
+void byte_writer::write_u64 (std::uint64_t value)
+{
+    write_u32(value);
+    write_u32(value >> 32);
+}
+
+void byte_writer::write_f64 (double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    write_u64(bits);
+}
+
+void byte_writer::write_varint (std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        write_u8((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    write_u8(value);
+}
+
+void byte_writer::write_svarint (std::int64_t value)
+{
+    write_varint((static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+void byte_writer::write_bytes (const unsigned char * bytes, std::size_t size)
+{
+    data.insert(data.end(), bytes, bytes + size);
+}
+
+byte_reader::byte_reader (const unsigned char * data, std::size_t size)
+    : data(data)
+    , size(size)
+    , offset(0)
+    , ok_(true)
+{ }
+
+unsigned int byte_reader::read_u8 ( )
+{
+    if (offset >= size)
+    {
+        ok_ = false;
+        return 0;
+    }
+    return data[offset++];
+}
+
+unsigned int byte_reader::read_u16 ( )
+{
+    unsigned int low = read_u8();
+    return low | (read_u8() << 8);
+}
+
+std::uint32_t byte_reader::read_u32 ( )
+{
+    std::uint32_t low = read_u16();
+    return low | (static_cast<std::uint32_t>(read_u16()) << 16);
+}
+
+std::uint64_t byte_reader::read_u64 ( )
+{
+    std::uint64_t low = read_u32();
+    return low | (static_cast<std::uint64_t>(read_u32()) << 32);
+}
+
+double byte_reader::read_f64 ( )
+{
+    std::uint64_t bits = read_u64();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::uint64_t byte_reader::read_varint ( )
+{
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        unsigned int b = read_u8();
+        value |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return value;
+    }
+    ok_ = false;
+    return 0;
+}
+
+std::int64_t byte_reader::read_svarint ( )
+{
+    std::uint64_t value = read_varint();
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+const unsigned char * byte_reader::read_bytes (std::size_t count)
+{
+    if (count > size - offset)
+    {
+        ok_ = false;
+        offset = size;
+        return nullptr;
+    }
+    const unsigned char * result = data + offset;
+    offset += count;
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef BYTE_STREAM_H
+#define BYTE_STREAM_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Little-endian binary encoding shared by the network protocol and
+// anything else that has to put world data into bytes
+
+class byte_writer
+{
+public:
+    std::vector<unsigned char> data;
+
+    void write_u8 (unsigned int value);
+    void write_u16 (unsigned int value);
+    void write_u32 (std::uint32_t value);
+    void write_u64 (std::uint64_t value);
+    void write_f64 (double value);
+    void write_varint (std::uint64_t value);
+    void write_svarint (std::int64_t value);
+    void write_bytes (const unsigned char * bytes, std::size_t size);
+
+    std::size_t size ( ) const { return data.size(); }
+};
+
+// Reading past the end returns zeros and clears ok(), so a message can be
+// decoded without checks after every field and validated once at the end
+class byte_reader
+{
+public:
+    byte_reader (const unsigned char * data, std::size_t size);
+
+    unsigned int read_u8 ( );
+    unsigned int read_u16 ( );
+    std::uint32_t read_u32 ( );
+    std::uint64_t read_u64 ( );
+    double read_f64 ( );
+    std::uint64_t read_varint ( );
+    std::int64_t read_svarint ( );
+    const unsigned char * read_bytes (std::size_t size);
+
+    bool ok ( ) const { return ok_; }
+    std::size_t remaining ( ) const { return size - offset; }
+
+private:
+    const unsigned char * data;
+    std::size_t size;
+    std::size_t offset;
+    bool ok_;
+};
+
+#endif // BYTE_STREAM_H
@@ -0,0 +1,150 @@
+#include "change_journal.h"
+
+#include <algorithm>
+
+const std::size_t change_journal::capacity;
+const int change_journal::max_readers;
+const std::uint64_t change_journal::unused;
+
+change_journal::change_journal ( )
+    : slots_(new slot[capacity])
+    , written_(0)
+{
+    for (std::size_t i = 0; i < capacity; ++i)
+        slots_[i].sequence.store(unused, std::memory_order_relaxed);
+    for (int r = 0; r < max_readers; ++r)
+        cursors_[r].store(unused, std::memory_order_relaxed);
+
+    stats_.recorded = stats_.coalesced = 0;
+    stats_.readers = 0;
+    memory_allocated(memory_chunks, capacity * sizeof(slot));
+}
+
+change_journal::~change_journal ( )
+{
+    memory_freed(memory_chunks, capacity * sizeof(slot));
+}
+
+std::uint64_t change_journal::oldest_unread ( ) const
+{
+    std::uint64_t oldest = unused;
+    for (int r = 0; r < max_readers; ++r)
+        oldest = std::min(oldest, cursors_[r].load(std::memory_order_acquire));
+    return oldest;
+}
+
+std::uint64_t change_journal::newest_unread ( ) const
+{
+    std::uint64_t newest = 0;
+    for (int r = 0; r < max_readers; ++r)
+    {
+        std::uint64_t cursor = cursors_[r].load(std::memory_order_acquire);
+        if (cursor != unused)
+            newest = std::max(newest, cursor);
+    }
+    return newest;
+}
+
+void change_journal::record (const world_change & c)
+{
+    // Nobody would ever read it
+    if (stats_.readers == 0)
+        return;
+
+    // Pairs with the fence in journal_reader::read: either that reader
+    // sees the edit in the world, or its cursor here
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Only while no reader has got to the record may the edit go into it;
+    // one that has would never hear of the edit
+    std::uint64_t oldest = oldest_unread();
+    auto pending = pending_.find(c.chunk());
+    if (pending != pending_.end() && pending->second >= newest_unread())
+    {
+        ++stats_.coalesced;
+        return;
+    }
+
+    std::uint64_t n = written_.load(std::memory_order_relaxed);
+    slot & s = slots_[n % capacity];
+    s.sequence.store(unused, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.change = c;
+    s.sequence.store(n, std::memory_order_release);
+    written_.store(n + 1, std::memory_order_release);
+    ++stats_.recorded;
+
+    if (c.kind == world_change::chunk_changed)
+        pending_[c.chunk()] = n;
+
+    // Records every reader is past don't hold anything back
+    if (pending_.size() > capacity)
+        for (auto it = pending_.begin(); it != pending_.end(); )
+            it = it->second < oldest ? pending_.erase(it) : std::next(it);
+}
+
+int change_journal::attach ( )
+{
+    for (int r = 0; r < max_readers; ++r)
+        if (cursors_[r].load(std::memory_order_relaxed) == unused)
+        {
+            cursors_[r].store(written_.load(std::memory_order_relaxed), std::memory_order_release);
+            ++stats_.readers;
+            return r;
+        }
+    return -1;
+}
+
+void change_journal::detach (int reader)
+{
+    cursors_[reader].store(unused, std::memory_order_release);
+    --stats_.readers;
+}
+
+journal_reader::journal_reader ( )
+    : id_(-1)
+{ }
+
+journal_reader::journal_reader (const std::shared_ptr<change_journal> & journal)
+    : journal_(journal)
+    , id_(journal->attach())
+{ }
+
+journal_reader::~journal_reader ( )
+{
+    if (journal_ && id_ >= 0)
+        journal_->detach(id_);
+}
+
+journal_reader::journal_reader (journal_reader && other)
+    : journal_(std::move(other.journal_))
+    , id_(other.id_)
+{
+    other.id_ = -1;
+}
+
+journal_reader & journal_reader::operator = (journal_reader && other)
+{
+    if (this != &other)
+    {
+        if (journal_ && id_ >= 0)
+            journal_->detach(id_);
+        journal_ = std::move(other.journal_);
+        id_ = other.id_;
+        other.id_ = -1;
+    }
+    return *this;
+}
+
+bool journal_reader::changed_chunks (std::vector<chunk_position> & chunks)
+{
+    chunks.clear();
+    bool complete = read([&chunks](const world_change & c)
+    {
+        chunks.push_back(c.chunk());
+    });
+
+    std::sort(chunks.begin(), chunks.end());
+    chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+    return complete;
+}
@@ -0,0 +1,164 @@
+#ifndef CHANGE_JOURNAL_H
+#define CHANGE_JOURNAL_H
+
+#include "world.h"
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// One edit of the world: a cube added or replaced, removed or painted, or
+// anything else about a whole chunk, which readers have to look at anew
+struct world_change
+{
+    enum kind_type : unsigned char
+    {
+        cube_added,
+        cube_removed,
+        cube_painted,
+        chunk_changed
+    };
+
+    kind_type kind;
+
+    // The cube, or the chunk for chunk_changed
+    int x, y, z;
+
+    chunk_position chunk ( ) const
+    {
+        return kind == chunk_changed ? chunk_position(x, y, z) : chunk_of(cube_position(x, y, z));
+    }
+};
+
+// The edits of a world in order, for the subsystems that keep something
+// derived from it to catch up on at their own pace, instead of comparing
+// every chunk with what they saw last time. A ring of the last capacity
+// changes with one writer, the thread editing the world, and readers that
+// may be on other threads; neither ever waits. A reader that falls more
+// than capacity changes behind is told so and has to look at everything.
+//
+// A change to a chunk that has a chunk_changed record none of the readers
+// has got to yet is dropped, since they will all look at the whole chunk
+// anyway, so an edit costs a look at every reader's position.
+class change_journal
+{
+public:
+    static const std::size_t capacity = 1 << 12;
+    static const int max_readers = 32;
+
+    struct statistics
+    {
+        std::size_t recorded;
+        std::size_t coalesced;
+        int readers;
+    };
+
+    change_journal ( );
+    ~change_journal ( );
+
+    change_journal (const change_journal &) = delete;
+    change_journal & operator = (const change_journal &) = delete;
+
+    void record (const world_change & c);
+
+    const statistics & stats ( ) const { return stats_; }
+
+private:
+    friend class journal_reader;
+
+    struct slot
+    {
+        std::atomic<std::uint64_t> sequence;
+        world_change change;
+    };
+
+    static const std::uint64_t unused = ~std::uint64_t(0);
+
+    std::unique_ptr<slot[]> slots_;
+    std::atomic<std::uint64_t> written_;
+
+    // Where each reader goes on from, unused for free places
+    std::atomic<std::uint64_t> cursors_[max_readers];
+
+    // Chunks with a chunk_changed record, and where it is
+    std::unordered_map<chunk_position, std::uint64_t, chunk_position_hash> pending_;
+
+    statistics stats_;
+
+    // Readers come and go on the writer thread; -1 if all places are taken
+    int attach ( );
+    void detach (int reader);
+    std::uint64_t oldest_unread ( ) const;
+    std::uint64_t newest_unread ( ) const;
+};
+
+// A reader of a journal from where it was when the reader was made. It
+// keeps the journal alive, so it may outlive the world.
+class journal_reader
+{
+public:
+    journal_reader ( );
+    explicit journal_reader (const std::shared_ptr<change_journal> & journal);
+    ~journal_reader ( );
+
+    journal_reader (journal_reader && other);
+    journal_reader & operator = (journal_reader && other);
+
+    bool reads (const change_journal * journal) const { return journal_.get() == journal; }
+
+    // Calls f with every change since the last read, oldest first, and
+    // returns true; or returns false if some were missed, after passing
+    // on those it still got, and goes on from the newest change
+    template <typename F>
+    bool read (F f);
+
+    // The chunks of those changes, each once, sorted
+    bool changed_chunks (std::vector<chunk_position> & chunks);
+
+private:
+    std::shared_ptr<change_journal> journal_;
+    int id_;
+};
+
+template <typename F>
+bool journal_reader::read (F f)
+{
+    if (!journal_ || id_ < 0)
+        return false;
+
+    change_journal & j = *journal_;
+    std::uint64_t end = j.written_.load(std::memory_order_acquire);
+    std::uint64_t at = j.cursors_[id_].load(std::memory_order_relaxed);
+
+    // Claimed before reading, so the writer doesn't fold later edits into
+    // a record this reader is passing
+    j.cursors_[id_].store(end, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool complete = end - at <= change_journal::capacity;
+    for (; complete && at < end; ++at)
+    {
+        // The writer may be reusing the slot for a newer change meanwhile
+        change_journal::slot const & s = j.slots_[at % change_journal::capacity];
+        if (s.sequence.load(std::memory_order_acquire) != at)
+        {
+            complete = false;
+            break;
+        }
+        world_change c = s.change;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.sequence.load(std::memory_order_relaxed) != at)
+        {
+            complete = false;
+            break;
+        }
+        f(c);
+    }
+
+    return complete;
+}
+
+#endif // CHANGE_JOURNAL_H
@@ -0,0 +1,479 @@
+#include "client.h"
+#include "serialize.h"
+
+#include <algorithm>
+
+const int client::frame_history;
+const int client::change_history;
+const int client::history_samples;
+const std::size_t client::max_edits_per_packet;
+
+const double connect_interval = 0.5;
+const double connection_timeout = 5.0;
+
+client::client (transport & t, const net_address & server_address, world * terrain)
+    : interpolation_delay(2.0)
+    , net(t)
+    , server_address(server_address)
+    , terrain(terrain)
+{
+    reset();
+}
+
+client::~client ( )
+{
+    if (connected())
+    {
+        out.data.clear();
+        write_header(out, message_disconnect);
+        net.send(server_address, out.data.data(), out.size());
+    }
+}
+
+void client::reset ( )
+{
+    id_ = 0;
+    chunks_expected_ = 0;
+    received_chunks.clear();
+    spawn_ = kubeman(0.0, 0.0, 0.0);
+
+    send_timer = 0.0;
+    connect_timer = connect_interval;
+    silence = 0.0;
+    input_sequence = 0;
+    jump = false;
+
+    latest_tick = 0;
+    frames.assign(frame_history, received_frame());
+    for (received_frame & f : frames)
+        f.tick = 0;
+    server_time = 0.0;
+
+    changes_next = 0;
+    recent_changes.clear();
+
+    assemblies.clear();
+    completed_transfers.clear();
+    chunk_acks.clear();
+
+    edit_base = 0;
+    edits.clear();
+
+    history.clear();
+    has_own_state = false;
+}
+
+void client::update (double dt, const player_input & input)
+{
+    net_address from;
+    while (net.receive(from, packet))
+    {
+        if (!(from == server_address))
+            continue;
+
+        byte_reader in(packet.data(), packet.size());
+        unsigned int type;
+        if (!read_header(in, type))
+            continue;
+
+        silence = 0.0;
+
+        if (type == message_welcome)
+            handle_welcome(in);
+        else if (connected() && type == message_chunk)
+            handle_chunk(in);
+        else if (connected() && type == message_snapshot)
+            handle_snapshot(in);
+        else if (connected() && type == message_changes)
+            handle_changes(in);
+    }
+
+    silence += dt;
+    server_time += dt * tick_rate;
+    jump |= input.jump;
+
+    if (connected() && silence > connection_timeout)
+    {
+        // The server is gone; start over
+        if (terrain)
+            terrain->clear();
+        reset();
+    }
+
+    if (!connected())
+    {
+        connect_timer += dt;
+        if (connect_timer >= connect_interval)
+        {
+            connect_timer = 0.0;
+            out.data.clear();
+            write_header(out, message_connect);
+            net.send(server_address, out.data.data(), out.size());
+        }
+        return;
+    }
+
+    send_timer += dt;
+    if (send_timer >= 1.0 / tick_rate)
+    {
+        send_timer = std::min(send_timer - 1.0 / tick_rate, 1.0 / tick_rate);
+        send_input(input);
+    }
+}
+
+void client::handle_welcome (byte_reader & in)
+{
+    std::uint32_t id = in.read_varint();
+    in.read_varint();
+    std::size_t chunks = in.read_varint();
+    player_state spawn;
+    spawn.x = in.read_svarint();
+    spawn.y = in.read_svarint();
+    spawn.z = in.read_svarint();
+
+    if (!in.ok() || connected())
+        return;
+
+    id_ = id;
+    chunks_expected_ = chunks;
+    spawn_ = dequantize(spawn);
+    send_timer = 1.0 / tick_rate;
+}
+
+void client::handle_chunk (byte_reader & in)
+{
+    std::uint32_t index = in.read_varint();
+    std::uint32_t encode_tick = in.read_u32();
+    chunk_position position;
+    position.x = in.read_svarint();
+    position.y = in.read_svarint();
+    position.z = in.read_svarint();
+    std::size_t total = in.read_varint();
+    std::size_t fragment = in.read_varint();
+    std::size_t fragments = in.read_varint();
+
+    std::size_t begin = fragment * chunk_fragment_size;
+    std::size_t size = std::min(chunk_fragment_size, total - std::min(total, begin));
+    const unsigned char * bytes = in.read_bytes(size);
+
+    if (!in.ok() || fragments == 0 || fragment >= fragments || fragments != (total + chunk_fragment_size - 1) / chunk_fragment_size)
+        return;
+
+    if (completed_transfers.count(index))
+    {
+        // Our ack was lost
+        chunk_acks.push_back(index);
+        return;
+    }
+
+    auto it = assemblies.find(index);
+    if (it == assemblies.end())
+    {
+        chunk_assembly & a = assemblies[index];
+        a.position = position;
+        a.encode_tick = encode_tick;
+        a.data.resize(total);
+        a.received.assign(fragments, false);
+        a.fragments_left = fragments;
+        it = assemblies.find(index);
+    }
+
+    chunk_assembly & a = it->second;
+    if (a.data.size() != total || a.received[fragment])
+        return;
+
+    std::copy(bytes, bytes + size, a.data.begin() + begin);
+    a.received[fragment] = true;
+    if (--a.fragments_left > 0)
+        return;
+
+    if (terrain)
+    {
+        chunk c;
+        byte_reader data(a.data.data(), a.data.size());
+        if (!read_chunk(data, c))
+        {
+            assemblies.erase(it);
+            return;
+        }
+
+        terrain->set_chunk(a.position, c);
+
+        // The chunk was encoded before these changes happened
+        for (block_change const & change : recent_changes)
+            if (change.tick > a.encode_tick && chunk_of(change.position) == a.position)
+                apply(*terrain, change);
+
+        for (block_change const & e : edits)
+            if (chunk_of(e.position) == a.position)
+                apply(*terrain, e);
+    }
+
+    completed_transfers.insert(index);
+    chunk_acks.push_back(index);
+    received_chunks.insert(a.position);
+    assemblies.erase(it);
+}
+
+void client::handle_snapshot (byte_reader & in)
+{
+    std::uint32_t tick = in.read_u32();
+    std::uint32_t baseline_tick = in.read_u32();
+    std::uint32_t id = in.read_varint();
+    in.read_u32();
+    std::uint32_t edits_applied = in.read_varint();
+    unsigned int flags = in.read_u8();
+    std::uint32_t changes_from = in.read_u32();
+
+    if (!in.ok() || id != id_ || tick <= latest_tick)
+        return;
+
+    const received_frame * base = nullptr;
+    if (baseline_tick != 0)
+    {
+        base = &frames[baseline_tick % frame_history];
+        if (base->tick != baseline_tick)
+            return;
+    }
+
+    std::vector<player_state> players;
+    std::size_t removed_count = in.read_varint();
+    std::vector<std::uint32_t> removed;
+    for (std::size_t i = 0; i < removed_count && in.ok(); ++i)
+        removed.push_back(in.read_varint());
+    std::sort(removed.begin(), removed.end());
+
+    if (base)
+        for (player_state const & s : base->players)
+            if (!std::binary_search(removed.begin(), removed.end(), s.id))
+                players.push_back(s);
+
+    std::size_t entry_count = in.read_varint();
+    std::size_t known = players.size();
+    for (std::size_t i = 0; i < entry_count && in.ok(); ++i)
+    {
+        player_state key;
+        key.id = in.read_varint();
+        auto it = std::lower_bound(players.begin(), players.begin() + known, key);
+        if (it != players.begin() + known && it->id == key.id)
+            read_player_delta(in, *it, *it);
+        else
+        {
+            player_state zero;
+            zero.id = key.id;
+            zero.x = zero.y = zero.z = zero.alpha = zero.beta = 0;
+            players.push_back(zero);
+            read_player_delta(in, zero, players.back());
+        }
+    }
+    std::sort(players.begin(), players.end());
+
+    std::vector<block_change> changes;
+    if (!read_changes(in, changes))
+        return;
+
+    latest_tick = tick;
+    received_frame & frame = frames[tick % frame_history];
+    frame.tick = tick;
+    frame.players.swap(players);
+
+    if ((flags & 1) && changes_next < changes_from)
+        changes_next = changes_from;
+    apply_changes(changes_from, changes);
+
+    while (!recent_changes.empty() && recent_changes.front().tick + change_history < tick)
+        recent_changes.pop_front();
+
+    while (!edits.empty() && edit_base < edits_applied)
+    {
+        edits.pop_front();
+        ++edit_base;
+    }
+
+    if (tick > server_time)
+        server_time = tick;
+    else
+        server_time += (tick - server_time) * 0.1;
+
+    has_own_state = false;
+    for (player_state const & s : frame.players)
+    {
+        if (s.id == id_)
+        {
+            has_own_state = true;
+            own_state_ = dequantize(s);
+            continue;
+        }
+
+        std::deque<sample> & h = history[s.id];
+        sample smp;
+        smp.tick = tick;
+        smp.position = dequantize(s);
+        h.push_back(smp);
+        if (h.size() > static_cast<std::size_t>(history_samples))
+            h.pop_front();
+    }
+
+    for (auto it = history.begin(); it != history.end(); )
+    {
+        if (it->second.back().tick != tick)
+            it = history.erase(it);
+        else
+            ++it;
+    }
+}
+
+void client::handle_changes (byte_reader & in)
+{
+    in.read_u32();
+    std::uint32_t changes_from = in.read_u32();
+
+    std::vector<block_change> changes;
+    if (read_changes(in, changes))
+        apply_changes(changes_from, changes);
+}
+
+bool client::read_changes (byte_reader & in, std::vector<block_change> & changes)
+{
+    std::size_t count = in.read_varint();
+    changes.resize(std::min<std::size_t>(count, in.remaining()));
+    for (block_change & c : changes)
+        read_block_change(in, c);
+
+    return in.ok() && changes.size() == count;
+}
+
+void client::apply_changes (std::uint32_t from, const std::vector<block_change> & changes)
+{
+    // Changes have to be applied without gaps
+    if (from > changes_next)
+        return;
+
+    for (std::size_t i = changes_next - from; i < changes.size(); ++i)
+    {
+        if (terrain)
+            apply(*terrain, changes[i]);
+        recent_changes.push_back(changes[i]);
+        ++changes_next;
+    }
+}
+
+void client::send_input (const player_input & input)
+{
+    out.data.clear();
+    write_header(out, message_input);
+    out.write_u32(++input_sequence);
+    out.write_u32(latest_tick);
+    out.write_u32(changes_next);
+
+    player_input i = input;
+    i.jump = jump;
+    jump = false;
+    write_input(out, i);
+
+    out.write_varint(chunk_acks.size());
+    for (std::uint32_t index : chunk_acks)
+        out.write_varint(index);
+    chunk_acks.clear();
+
+    std::size_t edit_count = std::min(edits.size(), max_edits_per_packet);
+    out.write_varint(edit_base);
+    out.write_varint(edit_count);
+    for (std::size_t e = 0; e < edit_count; ++e)
+        write_block_change(out, edits[e]);
+
+    net.send(server_address, out.data.data(), out.size());
+}
+
+void client::edit (const block_change & e)
+{
+    if (terrain)
+        apply(*terrain, e);
+    edits.push_back(e);
+}
+
+void client::add_cube (cube_position p, double hue, double brightness, int material)
+{
+    block_change e;
+    e.tick = 0;
+    e.position = p;
+    e.kind = change_add;
+    e.plane = 0;
+    e.material = material;
+    e.hue = hue;
+    e.brightness = brightness;
+    edit(e);
+}
+
+void client::remove_cube (cube_position p)
+{
+    block_change e;
+    e.tick = 0;
+    e.position = p;
+    e.kind = change_remove;
+    e.plane = 0;
+    e.material = material_cube;
+    e.hue = e.brightness = 0.0;
+    edit(e);
+}
+
+void client::paint (cube_position p, int plane, double hue, double brightness)
+{
+    block_change e;
+    e.tick = 0;
+    e.position = p;
+    e.kind = change_paint;
+    e.plane = plane;
+    e.material = material_cube;
+    e.hue = hue;
+    e.brightness = brightness;
+    edit(e);
+}
+
+bool client::own_state (kubeman & result) const
+{
+    if (has_own_state)
+        result = own_state_;
+    return has_own_state;
+}
+
+void client::remote_players (std::vector<kubeman> & result) const
+{
+    result.clear();
+
+    double t = server_time - interpolation_delay;
+    for (auto const & h : history)
+    {
+        std::deque<sample> const & samples = h.second;
+
+        if (t <= samples.front().tick)
+        {
+            result.push_back(samples.front().position);
+            continue;
+        }
+
+        std::size_t i = 1;
+        while (i < samples.size() && samples[i].tick < t)
+            ++i;
+
+        if (i == samples.size())
+        {
+            result.push_back(samples.back().position);
+            continue;
+        }
+
+        sample const & a = samples[i - 1];
+        sample const & b = samples[i];
+        double k = (t - a.tick) / (b.tick - a.tick);
+
+        // Turn the short way round
+        double turn = b.position.alpha - a.position.alpha;
+        if (turn > 3.1415926535) turn -= 2.0 * 3.1415926535;
+        if (turn < -3.1415926535) turn += 2.0 * 3.1415926535;
+
+        result.push_back(kubeman(a.position.x + (b.position.x - a.position.x) * k,
+                                 a.position.y + (b.position.y - a.position.y) * k,
+                                 a.position.z + (b.position.z - a.position.z) * k,
+                                 a.position.alpha + turn * k, h.first));
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include "world.h"
+#include "kubeman.h"
+#include "protocol.h"
+#include "transport.h"
+
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+
+// Client side of the protocol in protocol.h: keeps a replica of the
+// server's world and of the other players.
+class client
+{
+public:
+    // terrain may be null for clients that don't need the world (bots)
+    client (transport & t, const net_address & server_address, world * terrain);
+    ~client ( );
+
+    client (const client &) = delete;
+    client & operator = (const client &) = delete;
+
+    // Remote players are drawn this many ticks behind the newest snapshot,
+    // so there usually are two snapshots to interpolate between
+    double interpolation_delay;
+
+    // Processes incoming packets and sends input tick_rate times a second
+    void update (double dt, const player_input & input);
+
+    // Edits are applied locally right away and sent until acknowledged
+    void add_cube (cube_position p, double hue, double brightness, int material = material_cube);
+    void remove_cube (cube_position p);
+    void paint (cube_position p, int plane, double hue, double brightness);
+
+    bool connected ( ) const { return id_ != 0; }
+    std::uint32_t id ( ) const { return id_; }
+
+    std::size_t chunks_expected ( ) const { return chunks_expected_; }
+    std::size_t chunks_received ( ) const { return received_chunks.size(); }
+    bool loading ( ) const { return !connected() || received_chunks.size() < chunks_expected_; }
+
+    const kubeman & spawn ( ) const { return spawn_; }
+
+    // Where the server thinks our own player is
+    bool own_state (kubeman & result) const;
+
+    void remote_players (std::vector<kubeman> & result) const;
+
+private:
+    static const int frame_history = 32;
+    static const int change_history = 256;
+    static const int history_samples = 8;
+    static const std::size_t max_edits_per_packet = 32;
+
+    struct received_frame
+    {
+        std::uint32_t tick;
+        std::vector<player_state> players;
+    };
+
+    struct chunk_assembly
+    {
+        chunk_position position;
+        std::uint32_t encode_tick;
+        std::vector<unsigned char> data;
+        std::vector<bool> received;
+        std::size_t fragments_left;
+    };
+
+    struct sample
+    {
+        std::uint32_t tick;
+        kubeman position;
+    };
+
+    transport & net;
+    net_address server_address;
+    world * terrain;
+
+    std::uint32_t id_;
+    std::size_t chunks_expected_;
+    std::set<chunk_position> received_chunks;
+    kubeman spawn_;
+
+    double send_timer;
+    double connect_timer;
+    double silence;
+    std::uint32_t input_sequence;
+    bool jump;
+
+    std::uint32_t latest_tick;
+    std::vector<received_frame> frames;
+    double server_time;
+
+    // The number of the next block change to apply
+    std::uint32_t changes_next;
+    std::deque<block_change> recent_changes;
+
+    std::map<std::uint32_t, chunk_assembly> assemblies;
+    std::set<std::uint32_t> completed_transfers;
+    std::vector<std::uint32_t> chunk_acks;
+
+    std::uint32_t edit_base;
+    std::deque<block_change> edits;
+
+    std::map<std::uint32_t, std::deque<sample>> history;
+    bool has_own_state;
+    kubeman own_state_;
+
+    byte_writer out;
+    std::vector<unsigned char> packet;
+
+    void reset ( );
+    void handle_welcome (byte_reader & in);
+    void handle_chunk (byte_reader & in);
+    void handle_snapshot (byte_reader & in);
+    void handle_changes (byte_reader & in);
+    bool read_changes (byte_reader & in, std::vector<block_change> & changes);
+    void apply_changes (std::uint32_t from, const std::vector<block_change> & changes);
+    void send_input (const player_input & input);
+    void edit (const block_change & e);
+};
+
+#endif // CLIENT_H
@@ -0,0 +1,9 @@
+# Include this from projects that link against the core library
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+LIBS += -L$$OUT_PWD/../core -lcore
+QMAKE_CXXFLAGS += -pthread
+QMAKE_LFLAGS += -pthread
+PRE_TARGETDEPS += $$OUT_PWD/../core/libcore.a
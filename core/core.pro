@@ -0,0 +1,70 @@
+TEMPLATE = lib
+TARGET = core
+CONFIG += staticlib
+CONFIG -= qt
+DEPENDPATH += .
+INCLUDEPATH += .
+
+QMAKE_CXXFLAGS += -std=c++0x -O3 -pthread
+
+# Input
+HEADERS += cube.h player.h kubeman.h \
+    frame_arena.h \
+    memory_stats.h \
+    frame_scheduler.h \
+    world.h \
+    change_journal.h \
+    region.h \
+    raycast.h \
+    generator.h \
+    heightmap_import.h \
+    physics.h \
+    debris.h \
+    bodies.h \
+    range_allocator.h \
+    navigation.h \
+    crowd.h \
+    worker_pool.h \
+    spsc_queue.h \
+    simulation.h \
+    minimap.h \
+    mesh.h \
+    face_mesher.h \
+    textures.h \
+    byte_stream.h \
+    serialize.h \
+    world_file.h \
+    schematic.h \
+    transport.h \
+    protocol.h \
+    server.h \
+    client.h
+SOURCES += cube.cpp player.cpp \
+    frame_arena.cpp \
+    memory_stats.cpp \
+    frame_scheduler.cpp \
+    world.cpp \
+    change_journal.cpp \
+    region.cpp \
+    raycast.cpp \
+    generator.cpp \
+    heightmap_import.cpp \
+    physics.cpp \
+    debris.cpp \
+    bodies.cpp \
+    range_allocator.cpp \
+    navigation.cpp \
+    crowd.cpp \
+    worker_pool.cpp \
+    simulation.cpp \
+    minimap.cpp \
+    mesh.cpp \
+    textures.cpp \
+    byte_stream.cpp \
+    serialize.cpp \
+    world_file.cpp \
+    schematic.cpp \
+    transport.cpp \
+    protocol.cpp \
+    server.cpp \
+    client.cpp
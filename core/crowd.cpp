@@ -0,0 +1,224 @@
+#include "crowd.h"
+#include "player.h"
+
+#include <chrono>
+#include <cmath>
+
+const double crowd::speed = 3.0;
+
+typedef std::chrono::high_resolution_clock clock_type;
+
+// Where a kubeman standing in the cell is, the same way as a player
+static void place (kubeman & body, cube_position c)
+{
+    body.x = c.x;
+    body.y = c.y - 0.5 + player::size_y_bottom;
+    body.z = c.z;
+}
+
+crowd::crowd (unsigned int seed)
+    : random_(seed)
+    , first_walker_(0)
+{
+    stats_.walkers = 0;
+    stats_.waiting = 0;
+    stats_.planned = 0;
+    stats_.failed = 0;
+    stats_.rebuilt_columns = 0;
+    stats_.plan_ms = 0.0;
+}
+
+void crowd::spawn (const world & w, double x, double z, int count, int radius)
+{
+    graph_.update(w);
+
+    std::uniform_int_distribution<int> offset(-radius, radius);
+    for (int attempt = 0; attempt < count * 4 && count > 0; ++attempt)
+    {
+        int cx = static_cast<int>(std::floor(x + 0.5)) + offset(random_);
+        int cz = static_cast<int>(std::floor(z + 0.5)) + offset(random_);
+        int top;
+        if (!w.top(cx, cz, top))
+            continue;
+
+        cube_position c(cx, top + 1, cz);
+        if (!graph_.walkable(c))
+            continue;
+
+        walker k;
+        k.body = kubeman(0.0, 0.0, 0.0, 0.0, 1000 + walkers_.size());
+        place(k.body, c);
+        k.cell = c;
+        k.leg = 0;
+        k.step = 0;
+        k.waiting = false;
+        walkers_.push_back(k);
+        request(walkers_.size() - 1);
+        --count;
+    }
+}
+
+void crowd::clear ( )
+{
+    walkers_.clear();
+    requests_.clear();
+}
+
+void crowd::request (std::size_t i)
+{
+    walker & k = walkers_[i];
+    if (k.waiting)
+        return;
+
+    k.waiting = true;
+    k.route.clear();
+    k.steps.clear();
+    requests_.push_back(i);
+}
+
+bool crowd::plan (const world & w, walker & k)
+{
+    // Whatever the walker stood on may be gone
+    int top;
+    if (!graph_.walkable(k.cell) && w.top(k.cell.x, k.cell.z, top))
+    {
+        k.cell = cube_position(k.cell.x, top + 1, k.cell.z);
+        place(k.body, k.cell);
+    }
+
+    std::uniform_int_distribution<int> offset(-wander_radius, wander_radius);
+    for (int attempt = 0; attempt < 4; ++attempt)
+    {
+        int x = k.cell.x + offset(random_), z = k.cell.z + offset(random_);
+        if (!w.top(x, z, top))
+            continue;
+
+        cube_position goal(x, top + 1, z);
+        if (goal == k.cell || !graph_.walkable(goal))
+            continue;
+
+        if (graph_.find_route(k.cell, goal, k.route))
+        {
+            k.leg = 0;
+            k.steps.clear();
+            k.step = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+void crowd::walk (std::size_t i, double dt, bool can_refine)
+{
+    walker & k = walkers_[i];
+
+    double left = speed * dt;
+    while (left > 0.0 && !k.waiting)
+    {
+        if (k.step == k.steps.size())
+        {
+            // Wait at the border of the column for a later tick
+            if (!can_refine)
+                break;
+
+            k.steps.clear();
+            k.step = 0;
+            if (k.leg + 1 >= k.route.size() || !graph_.refine(k.route[k.leg], k.route[k.leg + 1], k.steps))
+            {
+                request(i);
+                break;
+            }
+            ++k.leg;
+            continue;
+        }
+
+        // The world may have changed since the route was planned
+        cube_position next = k.steps[k.step];
+        if (!graph_.walkable(next))
+        {
+            request(i);
+            break;
+        }
+
+        kubeman target = k.body;
+        place(target, next);
+        double dx = target.x - k.body.x, dy = target.y - k.body.y, dz = target.z - k.body.z;
+        double d = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (dx != 0.0 || dz != 0.0)
+            k.body.alpha = std::atan2(dx, -dz);
+
+        if (d <= left)
+        {
+            k.body.x = target.x;
+            k.body.y = target.y;
+            k.body.z = target.z;
+            k.cell = next;
+            ++k.step;
+            left -= d;
+        }
+        else
+        {
+            k.body.x += dx * left / d;
+            k.body.y += dy * left / d;
+            k.body.z += dz * left / d;
+            left = 0.0;
+        }
+    }
+}
+
+void crowd::tick (const world & w, double dt, double budget_ms)
+{
+    auto start = clock_type::now();
+    auto elapsed = [start]{ return std::chrono::duration<double, std::milli>(clock_type::now() - start).count(); };
+
+    stats_.planned = 0;
+    stats_.failed = 0;
+    stats_.rebuilt_columns = 0;
+    stats_.plan_ms = 0.0;
+
+    // Nobody needs the graph kept up to date
+    if (walkers_.empty())
+        return;
+
+    stats_.rebuilt_columns = graph_.update(w);
+
+    // Round robin, so every walker gets its turn eventually
+    for (std::size_t pending = requests_.size(); pending > 0 && elapsed() < budget_ms; --pending)
+    {
+        std::size_t i = requests_.front();
+        requests_.pop_front();
+
+        walker & k = walkers_[i];
+        if (plan(w, k))
+        {
+            k.waiting = false;
+            ++stats_.planned;
+        }
+        else
+        {
+            requests_.push_back(i);
+            ++stats_.failed;
+        }
+    }
+
+    // Refining routes comes out of the same budget; start with another
+    // walker every tick so the same ones don't always wait
+    first_walker_ = (first_walker_ + 1) % walkers_.size();
+    for (std::size_t n = 0; n < walkers_.size(); ++n)
+        walk((first_walker_ + n) % walkers_.size(), dt, elapsed() < budget_ms);
+    stats_.plan_ms = elapsed();
+}
+
+void crowd::walkers (std::vector<kubeman> & result) const
+{
+    for (walker const & k : walkers_)
+        result.push_back(k.body);
+}
+
+crowd::statistics crowd::stats ( ) const
+{
+    statistics result = stats_;
+    result.walkers = walkers_.size();
+    result.waiting = requests_.size();
+    return result;
+}
@@ -0,0 +1,81 @@
+#ifndef CROWD_H
+#define CROWD_H
+
+#include "kubeman.h"
+#include "navigation.h"
+
+#include <vector>
+#include <deque>
+#include <random>
+
+// Kubemen that wander between random places on foot. Routes are planned
+// on the navigation graph, and refined into steps one column at a time as
+// they are walked, for at most a given time every tick; walkers that
+// don't get their turn stand still until a later one.
+class crowd
+{
+public:
+    struct statistics
+    {
+        std::size_t walkers;
+        std::size_t waiting;
+
+        // In the last tick
+        std::size_t planned;
+        std::size_t failed;
+        std::size_t rebuilt_columns;
+
+        // Updating the graph, planning and refining, and walking
+        double plan_ms;
+    };
+
+    // Cells per second
+    static const double speed;
+
+    explicit crowd (unsigned int seed = 0);
+
+    // Up to count walkers on top of the columns within radius of x, z
+    void spawn (const world & w, double x, double z, int count, int radius);
+    void clear ( );
+
+    void tick (const world & w, double dt, double budget_ms);
+
+    // Appends a kubeman for each walker
+    void walkers (std::vector<kubeman> & result) const;
+
+    std::size_t size ( ) const { return walkers_.size(); }
+    statistics stats ( ) const;
+    const nav_graph & graph ( ) const { return graph_; }
+
+private:
+    struct walker
+    {
+        kubeman body;
+
+        // The cell the walker last stood in
+        cube_position cell;
+
+        std::vector<cube_position> route;
+        std::size_t leg;
+        std::vector<cube_position> steps;
+        std::size_t step;
+
+        bool waiting;
+    };
+
+    nav_graph graph_;
+    std::vector<walker> walkers_;
+    std::deque<std::size_t> requests_;
+    std::default_random_engine random_;
+    statistics stats_;
+    std::size_t first_walker_;
+
+    // How far from where they stand walkers look for a goal
+    static const int wander_radius = 40;
+
+    bool plan (const world & w, walker & k);
+    void walk (std::size_t i, double dt, bool can_refine);
+    void request (std::size_t i);
+};
+
+#endif // CROWD_H
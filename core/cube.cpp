@@ -0,0 +1,108 @@
+#include "cube.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr double plane::tex_coords[8];
+
+bool operator == (const plane & p1, const plane & p2)
+{
+    return p1.cx == p2.cx && p1.cy == p2.cy && p1.cz == p2.cz
+        && p1.dx == p2.dx && p1.dy == p2.dy && p1.dz == p2.dz;
+}
+
+cube_position plane::adjacent_cube ( ) const
+{
+    return cube_position(cx + dx, cy + dy, cz + dz);
+}
+
+cube make_mesh (cube_position pos)
+{
+    cube result;
+    reinterpret_cast<cube_position &>(result) = pos;
+
+    const int origin[3] = {pos.x, pos.y, pos.z};
+    for (int p = 0; p < 6; ++p)
+    {
+        plane & pl = result.planes[p];
+        pl.cx = pos.x;
+        pl.cy = pos.y;
+        pl.cz = pos.z;
+
+        pl.dx = face_normals[p][0];
+        pl.dy = face_normals[p][1];
+        pl.dz = face_normals[p][2];
+
+        for (int i = 0; i < 4; ++i)
+            for (int a = 0; a < 3; ++a)
+                pl.coords[3 * i + a] = origin[a] + face_corners[p][i][a];
+    }
+
+    return result;
+}
+
+cube colored_cube (cube_position pos, double hue, double brightness)
+{
+    cube result = make_mesh(pos);
+    for (int p = 0; p < 6; ++p)
+    {
+        result.planes[p].hue = hue;
+        result.planes[p].brightness = brightness;
+    }
+    return result;
+}
+
+color get_color (double brightness, double hue)
+{
+    while (hue < 0.0) hue += 6.0;
+    while (hue >= 6.0) hue -= 6.0;
+
+    color res;
+    if (hue >= 0.0 && hue < 1.0)
+        res = color(1.0, hue, 0.0);
+    else if (hue >= 1.0 && hue < 2.0)
+        res = color(2.0 - hue, 1.0, 0.0);
+    else if (hue >= 2.0 && hue < 3.0)
+        res = color(0.0, 1.0, hue - 2.0);
+    else if (hue >= 3.0 && hue < 4.0)
+        res = color(0.0, 4.0 - hue, 1.0);
+    else if (hue >= 4.0 && hue < 5.0)
+        res = color(hue - 4.0, 0.0, 1.0);
+    else if (hue >= 5.0 && hue < 6.0)
+        res = color(1.0, 0.0, 6.0 - hue);
+
+    if (brightness < 1.0)
+    {
+        res.data[0] *= brightness;
+        res.data[1] *= brightness;
+        res.data[2] *= brightness;
+    }
+    else
+    {
+        brightness -= 1.0;
+        res.data[0] += (1.0 - res.data[0]) * brightness;
+        res.data[1] += (1.0 - res.data[1]) * brightness;
+        res.data[2] += (1.0 - res.data[2]) * brightness;
+    }
+    res.data[3] = 1.0;
+    return res;
+}
+
+void palette_color (const color & c, double & brightness, double & hue)
+{
+    double r = c.data[0], g = c.data[1], b = c.data[2];
+    double high = std::max(std::max(r, g), b), low = std::min(std::min(r, g), b);
+    double range = high - low;
+
+    if (range <= 0.0)
+        hue = 0.0;
+    else if (high == r)
+        hue = std::fmod((g - b) / range + 6.0, 6.0);
+    else if (high == g)
+        hue = (b - r) / range + 2.0;
+    else
+        hue = (r - g) / range + 4.0;
+
+    // A pure hue is darkened below brightness 1 and whitened above it
+    brightness = (low <= 1.0 - high) ? high : 1.0 + low;
+}
@@ -0,0 +1,78 @@
+#ifndef CUBE_H
+#define CUBE_H
+
+struct color
+{
+    double data[4];
+
+    color (double r, double g, double b, double a = 1.0)
+        : data({r, g, b, a})
+    { }
+
+    color ( ) { }
+};
+
+struct cube_position
+{
+    int x, y, z;
+
+    cube_position ( ) = default;
+    cube_position (int x, int y, int z)
+        : x(x), y(y), z(z)
+    { }
+};
+
+inline bool operator < (cube_position const & cp1, cube_position const & cp2)
+{
+    return (cp1.x < cp2.x) || (cp1.x == cp2.x && cp1.y < cp2.y) || (cp1.x == cp2.x && cp1.y == cp2.y && cp1.z < cp2.z);
+}
+
+inline bool operator == (cube_position const & cp1, cube_position const & cp2)
+{
+    return cp1.x == cp2.x && cp1.y == cp2.y && cp1.z == cp2.z;
+}
+
+// The planes of a cube are +x, -x, +y, -y, +z, -z. These are their
+// outward normals, and the corners of each face of a cube at the origin
+// in the order they are drawn.
+constexpr int face_normals[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+constexpr double face_corners[6][4][3] = {
+    {{0.5, -0.5, -0.5}, {0.5, 0.5, -0.5}, {0.5, 0.5, 0.5}, {0.5, -0.5, 0.5}},
+    {{-0.5, -0.5, 0.5}, {-0.5, 0.5, 0.5}, {-0.5, 0.5, -0.5}, {-0.5, -0.5, -0.5}},
+    {{-0.5, 0.5, 0.5}, {0.5, 0.5, 0.5}, {0.5, 0.5, -0.5}, {-0.5, 0.5, -0.5}},
+    {{-0.5, -0.5, -0.5}, {0.5, -0.5, -0.5}, {0.5, -0.5, 0.5}, {-0.5, -0.5, 0.5}},
+    {{-0.5, -0.5, 0.5}, {0.5, -0.5, 0.5}, {0.5, 0.5, 0.5}, {-0.5, 0.5, 0.5}},
+    {{-0.5, 0.5, -0.5}, {0.5, 0.5, -0.5}, {0.5, -0.5, -0.5}, {-0.5, -0.5, -0.5}}
+};
+
+struct plane
+{
+    static constexpr double tex_coords[8] = {0.0, 0.0, 1.0, 0.0, 1.0, 1.0, 0.0, 1.0};
+
+    double hue, brightness;
+
+    double coords[12];
+
+    int cx, cy, cz, dx, dy, dz;
+    cube_position adjacent_cube ( ) const;
+};
+
+bool operator == (const plane & p1, const plane & p2);
+
+struct cube
+    : cube_position
+{
+    plane planes[6];
+};
+
+cube make_mesh (cube_position);
+cube colored_cube (cube_position, double hue, double brightness);
+
+color get_color (double brightness, double hue);
+
+// The inverse of get_color for the colours it can make; others get the
+// nearest hue, and greys, which the palette has none of, a red one
+void palette_color (const color & c, double & brightness, double & hue);
+
+#endif // CUBE_H
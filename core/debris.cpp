@@ -0,0 +1,301 @@
+#include "debris.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const std::size_t debris::max_particles;
+
+// Cells per second squared; heavier than the player, so debris doesn't float
+static const float fall_acceleration = 15.0f;
+static const float air_drag = 0.5f;
+
+// Of the speed into a face that bounces back, and the speed below which a
+// particle landing on something stays there
+static const float restitution = 0.3f;
+static const float rest_speed = 2.0f;
+
+static const int face_offsets[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+std::uint32_t pack_color (const color & c)
+{
+    std::uint32_t result = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        double v = std::min(std::max(c.data[i], 0.0), 1.0);
+        result |= static_cast<std::uint32_t>(v * 255.0 + 0.5) << (8 * i);
+    }
+    return result;
+}
+
+static int cell_of (float x)
+{
+    // Cubes are centered on integer positions
+    return static_cast<int>(std::floor(x + 0.5f));
+}
+
+// Neighbouring particles mostly look at the same chunk
+class debris::cell_lookup
+{
+public:
+    explicit cell_lookup (const world & w)
+        : w(w)
+        , voxels(nullptr)
+        , has_last(false)
+    { }
+
+    // Water doesn't stop debris
+    bool blocks (int x, int y, int z)
+    {
+        cube_position p(x, y, z);
+        chunk_position cp = chunk_of(p);
+        if (!has_last || !(cp == last))
+        {
+            auto it = w.chunks().find(cp);
+            voxels = it == w.chunks().end() || it->second.count == 0 ? nullptr : w.cells(cp, it->second);
+            last = cp;
+            has_last = true;
+        }
+
+        if (!voxels)
+            return false;
+        voxel const & v = voxels[voxel_index(p)];
+        return v.solid && v.material != material_water;
+    }
+
+private:
+    const world & w;
+    chunk_position last;
+    const voxel * voxels;
+    bool has_last;
+};
+
+debris::debris (unsigned int seed)
+    : random_(seed)
+{
+    stats_.particles = stats_.crossings = stats_.collisions = stats_.expired = 0;
+}
+
+void debris::add (float x, float y, float z, float vx, float vy, float vz, std::uint32_t color, float life)
+{
+    if (x_.size() >= max_particles)
+        return;
+
+    x_.push_back(x);
+    y_.push_back(y);
+    z_.push_back(z);
+    vx_.push_back(vx);
+    vy_.push_back(vy);
+    vz_.push_back(vz);
+    life_.push_back(life);
+    gravity_.push_back(1.0f);
+    colors_.push_back(color);
+    stats_.particles = x_.size();
+}
+
+void debris::spawn (const std::vector<std::pair<cube_position, voxel>> & removed, double x, double y, double z, double speed)
+{
+    std::uniform_real_distribution<float> jitter(-1.0f, 1.0f), share(0.5f, 1.0f), lifetime(1.5f, 3.0f);
+
+    for (auto const & r : removed)
+    {
+        cube_position p = r.first;
+        double dx = p.x - x, dy = p.y - y, dz = p.z - z;
+        double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        double scale = distance > 1e-6 ? speed / distance : 0.0;
+
+        for (int f = 0; f < 6; ++f)
+        {
+            float s = scale * share(random_);
+            color c = get_color(r.second.brightness[f], r.second.hue[f]);
+            c.data[3] = material_alpha(r.second.material);
+
+            // From the middle of the face, a little outwards and upwards
+            add(p.x + 0.4f * face_offsets[f][0], p.y + 0.4f * face_offsets[f][1], p.z + 0.4f * face_offsets[f][2],
+                dx * s + 1.5f * face_offsets[f][0] + jitter(random_),
+                dy * s + 1.5f * face_offsets[f][1] + jitter(random_) + 2.0f,
+                dz * s + 1.5f * face_offsets[f][2] + jitter(random_),
+                pack_color(c), lifetime(random_));
+        }
+    }
+}
+
+#if defined(__SSE2__)
+static inline __m128 floor4 (__m128 v)
+{
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), _mm_set1_ps(1.0f)));
+}
+#endif
+
+void debris::tick (const world & w, double dt)
+{
+    stats_.crossings = stats_.collisions = stats_.expired = 0;
+
+    const std::size_t n = x_.size();
+    const float t = dt;
+    const float damping = std::max(0.0, 1.0 - air_drag * dt);
+    const float fall = fall_acceleration * dt;
+
+    // Velocities and lifetimes
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    {
+        __m128 damping4 = _mm_set1_ps(damping), fall4 = _mm_set1_ps(fall), t4 = _mm_set1_ps(t);
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 g = _mm_loadu_ps(&gravity_[i]);
+            _mm_storeu_ps(&vx_[i], _mm_mul_ps(_mm_loadu_ps(&vx_[i]), damping4));
+            _mm_storeu_ps(&vy_[i], _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&vy_[i]), damping4), _mm_mul_ps(g, fall4)));
+            _mm_storeu_ps(&vz_[i], _mm_mul_ps(_mm_loadu_ps(&vz_[i]), damping4));
+            _mm_storeu_ps(&life_[i], _mm_sub_ps(_mm_loadu_ps(&life_[i]), t4));
+        }
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        vx_[i] *= damping;
+        vy_[i] = vy_[i] * damping - gravity_[i] * fall;
+        vz_[i] *= damping;
+        life_[i] -= t;
+    }
+
+    // Positions; only particles that enter another cell are checked against
+    // the world
+    cell_lookup cells(w);
+    i = 0;
+#if defined(__SSE2__)
+    {
+        __m128 t4 = _mm_set1_ps(t), half = _mm_set1_ps(0.5f);
+        float old[3][4];
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 ox = _mm_loadu_ps(&x_[i]), oy = _mm_loadu_ps(&y_[i]), oz = _mm_loadu_ps(&z_[i]);
+            __m128 nx = _mm_add_ps(ox, _mm_mul_ps(_mm_loadu_ps(&vx_[i]), t4));
+            __m128 ny = _mm_add_ps(oy, _mm_mul_ps(_mm_loadu_ps(&vy_[i]), t4));
+            __m128 nz = _mm_add_ps(oz, _mm_mul_ps(_mm_loadu_ps(&vz_[i]), t4));
+            _mm_storeu_ps(&x_[i], nx);
+            _mm_storeu_ps(&y_[i], ny);
+            _mm_storeu_ps(&z_[i], nz);
+
+            __m128 crossed = _mm_or_ps(
+                _mm_or_ps(_mm_cmpneq_ps(floor4(_mm_add_ps(ox, half)), floor4(_mm_add_ps(nx, half))),
+                          _mm_cmpneq_ps(floor4(_mm_add_ps(oy, half)), floor4(_mm_add_ps(ny, half)))),
+                _mm_cmpneq_ps(floor4(_mm_add_ps(oz, half)), floor4(_mm_add_ps(nz, half))));
+            int mask = _mm_movemask_ps(crossed);
+            if (mask == 0)
+                continue;
+
+            _mm_storeu_ps(old[0], ox);
+            _mm_storeu_ps(old[1], oy);
+            _mm_storeu_ps(old[2], oz);
+            for (int k = 0; k < 4; ++k)
+                if (mask & (1 << k))
+                    collide(cells, i + k, old[0][k], old[1][k], old[2][k]);
+        }
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        float ox = x_[i], oy = y_[i], oz = z_[i];
+        x_[i] += vx_[i] * t;
+        y_[i] += vy_[i] * t;
+        z_[i] += vz_[i] * t;
+        if (cell_of(ox) != cell_of(x_[i]) || cell_of(oy) != cell_of(y_[i]) || cell_of(oz) != cell_of(z_[i]))
+            collide(cells, i, ox, oy, oz);
+    }
+
+    for (i = 0; i < x_.size(); )
+    {
+        if (life_[i] > 0.0f)
+        {
+            ++i;
+            continue;
+        }
+        remove(i);
+        ++stats_.expired;
+    }
+    stats_.particles = x_.size();
+}
+
+void debris::collide (cell_lookup & cells, std::size_t i, float old_x, float old_y, float old_z)
+{
+    ++stats_.crossings;
+
+    float target[3] = {x_[i], y_[i], z_[i]};
+    if (!cells.blocks(cell_of(target[0]), cell_of(target[1]), cell_of(target[2])))
+        return;
+
+    ++stats_.collisions;
+
+    // Move along one axis at a time, and bounce off the faces in the way
+    float p[3] = {old_x, old_y, old_z};
+    float * v[3] = {&vx_[i], &vy_[i], &vz_[i]};
+    for (int a = 0; a < 3; ++a)
+    {
+        p[a] = target[a];
+        if (!cells.blocks(cell_of(p[0]), cell_of(p[1]), cell_of(p[2])))
+            continue;
+
+        p[a] = a == 0 ? old_x : (a == 1 ? old_y : old_z);
+        bool landed = a == 1 && *v[1] < 0.0f;
+        if (landed && *v[1] > -rest_speed)
+        {
+            vx_[i] = vy_[i] = vz_[i] = 0.0f;
+            gravity_[i] = 0.0f;
+            continue;
+        }
+
+        *v[a] *= -restitution;
+        if (landed)
+        {
+            vx_[i] *= 0.6f;
+            vz_[i] *= 0.6f;
+        }
+    }
+
+    x_[i] = p[0];
+    y_[i] = p[1];
+    z_[i] = p[2];
+}
+
+void debris::remove (std::size_t i)
+{
+    std::size_t last = x_.size() - 1;
+    x_[i] = x_[last];
+    y_[i] = y_[last];
+    z_[i] = z_[last];
+    vx_[i] = vx_[last];
+    vy_[i] = vy_[last];
+    vz_[i] = vz_[last];
+    life_[i] = life_[last];
+    gravity_[i] = gravity_[last];
+    colors_[i] = colors_[last];
+
+    x_.pop_back();
+    y_.pop_back();
+    z_.pop_back();
+    vx_.pop_back();
+    vy_.pop_back();
+    vz_.pop_back();
+    life_.pop_back();
+    gravity_.pop_back();
+    colors_.pop_back();
+}
+
+void debris::clear ( )
+{
+    x_.clear();
+    y_.clear();
+    z_.clear();
+    vx_.clear();
+    vy_.clear();
+    vz_.clear();
+    life_.clear();
+    gravity_.clear();
+    colors_.clear();
+    stats_.particles = 0;
+}
@@ -0,0 +1,80 @@
+#ifndef DEBRIS_H
+#define DEBRIS_H
+
+#include "world.h"
+#include "memory_stats.h"
+
+#include <vector>
+#include <random>
+#include <utility>
+#include <cstdint>
+
+// Bits of destroyed cubes that fly, bounce off the world and fade away.
+// Every component of the particles is a separate array, so a tick is a
+// few passes over contiguous floats, four particles at a time with SSE.
+// Only particles that move into another cell look at the world.
+class debris
+{
+public:
+    typedef std::vector<float, tracked_allocator<float, memory_debris>> float_vector;
+    typedef std::vector<std::uint32_t, tracked_allocator<std::uint32_t, memory_debris>> color_vector;
+
+    struct statistics
+    {
+        std::size_t particles;
+
+        // In the last tick
+        std::size_t crossings;
+        std::size_t collisions;
+        std::size_t expired;
+    };
+
+    // More are dropped
+    static const std::size_t max_particles = 1 << 18;
+
+    explicit debris (unsigned int seed = 0);
+
+    // A particle for every face of the removed cubes, thrown away from the
+    // centre of the explosion at up to speed cells per second
+    void spawn (const std::vector<std::pair<cube_position, voxel>> & removed, double x, double y, double z, double speed);
+
+    // Color is RGBA, one byte each with red first in memory
+    void add (float x, float y, float z, float vx, float vy, float vz, std::uint32_t color, float life);
+
+    void tick (const world & w, double dt);
+    void clear ( );
+
+    std::size_t size ( ) const { return x_.size(); }
+
+    const float * x ( ) const { return x_.data(); }
+    const float * y ( ) const { return y_.data(); }
+    const float * z ( ) const { return z_.data(); }
+
+    // Seconds left
+    const float * life ( ) const { return life_.data(); }
+    const std::uint32_t * colors ( ) const { return colors_.data(); }
+
+    const statistics & stats ( ) const { return stats_; }
+
+private:
+    float_vector x_, y_, z_;
+    float_vector vx_, vy_, vz_;
+    float_vector life_;
+
+    // 1 while flying, 0 once a particle came to rest on something
+    float_vector gravity_;
+    color_vector colors_;
+
+    std::default_random_engine random_;
+    statistics stats_;
+
+    class cell_lookup;
+
+    void collide (cell_lookup & cells, std::size_t i, float old_x, float old_y, float old_z);
+    void remove (std::size_t i);
+};
+
+// Packs a colour for debris::add
+std::uint32_t pack_color (const color & c);
+
+#endif // DEBRIS_H
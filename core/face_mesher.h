@@ -0,0 +1,189 @@
+#ifndef FACE_MESHER_H
+#define FACE_MESHER_H
+
+#include "world.h"
+
+#include <algorithm>
+#include <cstddef>
+
+// Meshing one face direction at a time, with the direction a template
+// parameter: the corners, normal and the neighbour to look at are then
+// constants, so every face is a few straight-line stores the compiler
+// can vectorise. What the vertices look like is up to a format, which
+// has a face<Plane>(x, y, z, color, layer) member taking the cube.
+
+// Separate arrays of doubles, as build_mesh and glVertexPointer and
+// friends use them
+template <typename Vector>
+class double_arrays
+{
+public:
+    double_arrays (Vector & vertices, Vector & tex_coords, Vector & colors, Vector & normals)
+        : vertices(vertices)
+        , tex_coords(tex_coords)
+        , colors(colors)
+        , normals(normals)
+    { }
+
+    template <int Plane>
+    void face (int x, int y, int z, const color & c, int layer)
+    {
+        const double origin[3] = {double(x), double(y), double(z)};
+        double v[12], t[12], n[12], col[16];
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int a = 0; a < 3; ++a)
+            {
+                v[3 * i + a] = origin[a] + face_corners[Plane][i][a];
+                n[3 * i + a] = face_normals[Plane][a];
+            }
+
+            // The third coordinate picks the layer of the texture array
+            t[3 * i + 0] = plane::tex_coords[2 * i + 0];
+            t[3 * i + 1] = plane::tex_coords[2 * i + 1];
+            t[3 * i + 2] = layer;
+
+            for (int k = 0; k < 4; ++k)
+                col[4 * i + k] = c.data[k];
+        }
+
+        vertices.insert(vertices.end(), v, v + 12);
+        tex_coords.insert(tex_coords.end(), t, t + 12);
+        colors.insert(colors.end(), col, col + 16);
+        normals.insert(normals.end(), n, n + 12);
+    }
+
+private:
+    Vector & vertices;
+    Vector & tex_coords;
+    Vector & colors;
+    Vector & normals;
+};
+
+// One interleaved vertex of 40 bytes, against 104 for the same in doubles
+struct packed_vertex
+{
+    float position[3];
+    float tex_coord[3];
+    float normal[3];
+    unsigned char color[4];
+};
+
+inline unsigned char color_byte (double c)
+{
+    return static_cast<unsigned char>(std::min(std::max(c, 0.0), 1.0) * 255.0 + 0.5);
+}
+
+// Interleaved packed_vertex, as the chunk meshes keep them for the
+// vertex buffer
+template <typename Vector>
+class packed_vertices
+{
+public:
+    explicit packed_vertices (Vector & vertices)
+        : vertices(vertices)
+    { }
+
+    template <int Plane>
+    void face (int x, int y, int z, const color & c, int layer)
+    {
+        const float origin[3] = {float(x), float(y), float(z)};
+        const unsigned char bytes[4] = {color_byte(c.data[0]), color_byte(c.data[1]), color_byte(c.data[2]), color_byte(c.data[3])};
+
+        packed_vertex quad[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            packed_vertex & pv = quad[i];
+            for (int a = 0; a < 3; ++a)
+            {
+                pv.position[a] = origin[a] + float(face_corners[Plane][i][a]);
+                pv.normal[a] = face_normals[Plane][a];
+            }
+            pv.tex_coord[0] = plane::tex_coords[2 * i + 0];
+            pv.tex_coord[1] = plane::tex_coords[2 * i + 1];
+            pv.tex_coord[2] = layer;
+            std::copy(bytes, bytes + 4, pv.color);
+        }
+
+        vertices.insert(vertices.end(), quad, quad + 4);
+    }
+
+private:
+    Vector & vertices;
+};
+
+inline color face_color (const voxel & v, int plane)
+{
+    color c = get_color(v.brightness[plane], v.hue[plane]);
+    c.data[3] = material_alpha(v.material);
+    return c;
+}
+
+// Faces are hidden by opaque cubes, and inside a body of one translucent
+// material. Only the coordinate along the normal can leave the chunk.
+template <int Plane>
+inline bool face_covered (const world & w, const voxel * voxels, cube_position base, int x, int y, int z, int material)
+{
+    constexpr int dx = face_normals[Plane][0], dy = face_normals[Plane][1], dz = face_normals[Plane][2];
+    int along = dx != 0 ? x + dx : (dy != 0 ? y + dy : z + dz);
+
+    voxel const * n;
+    if (along >= 0 && along < chunk_size)
+        n = &voxels[voxel_index(x + dx, y + dy, z + dz)];
+    else
+        n = w.find(cube_position(base.x + x + dx, base.y + y + dy, base.z + z + dz));
+
+    if (!n || !n->solid)
+        return false;
+    return n->material == material || material_alpha(n->material) >= 1.0;
+}
+
+enum face_filter
+{
+    opaque_faces,
+    translucent_faces,
+    all_faces
+};
+
+// Emits face Plane of every cube of the chunk that passes the filter and
+// is not covered, and returns how many
+template <int Plane, typename Format>
+std::size_t mesh_plane (const world & w, chunk_position cp, const voxel * voxels, face_filter filter, Format & out)
+{
+    cube_position base(cp.x * chunk_size, cp.y * chunk_size, cp.z * chunk_size);
+
+    std::size_t faces = 0;
+    for (int x = 0; x < chunk_size; ++x)
+        for (int y = 0; y < chunk_size; ++y)
+            for (int z = 0; z < chunk_size; ++z)
+            {
+                voxel const & v = voxels[voxel_index(x, y, z)];
+                if (!v.solid)
+                    continue;
+                if (filter != all_faces && (material_alpha(v.material) < 1.0) != (filter == translucent_faces))
+                    continue;
+                if (face_covered<Plane>(w, voxels, base, x, y, z, v.material))
+                    continue;
+
+                out.template face<Plane>(base.x + x, base.y + y, base.z + z, face_color(v, Plane), v.material);
+                ++faces;
+            }
+    return faces;
+}
+
+// Picks the instance for a plane known only at run time
+template <typename Format>
+std::size_t mesh_plane (int plane, const world & w, chunk_position cp, const voxel * voxels, face_filter filter, Format & out)
+{
+    switch (plane)
+    {
+    case 0: return mesh_plane<0>(w, cp, voxels, filter, out);
+    case 1: return mesh_plane<1>(w, cp, voxels, filter, out);
+    case 2: return mesh_plane<2>(w, cp, voxels, filter, out);
+    case 3: return mesh_plane<3>(w, cp, voxels, filter, out);
+    case 4: return mesh_plane<4>(w, cp, voxels, filter, out);
+    default: return mesh_plane<5>(w, cp, voxels, filter, out);
+    }
+}
+
+#endif // FACE_MESHER_H
@@ -0,0 +1,107 @@
+#include "frame_arena.h"
+#include "memory_stats.h"
+
+#include <cstdint>
+#include <algorithm>
+
+frame_arena::frame_arena (std::size_t initial_capacity)
+    : offset(0)
+    , frame_peak(0)
+{
+    stats_.bytes = 0;
+    stats_.heap_allocations = 0;
+    stats_.last_frame_bytes = 0;
+    stats_.last_frame_heap_allocations = 0;
+    stats_.peak_bytes = 0;
+    stats_.capacity = 0;
+
+    blocks.reserve(16);
+    add_block(initial_capacity);
+}
+
+frame_arena::~frame_arena ( )
+{
+    for (block const & b : blocks)
+    {
+        memory_freed(memory_arenas, b.size);
+        delete [] b.data;
+    }
+}
+
+void frame_arena::add_block (std::size_t size)
+{
+    block b;
+    b.data = new char [size];
+    b.size = size;
+    blocks.push_back(b);
+    memory_allocated(memory_arenas, size);
+
+    offset = 0;
+    stats_.capacity += size;
+    ++stats_.heap_allocations;
+}
+
+void * frame_arena::allocate (std::size_t size, std::size_t alignment)
+{
+    block & b = blocks.back();
+    std::uintptr_t base = reinterpret_cast<std::uintptr_t>(b.data);
+    std::uintptr_t start = (base + offset + alignment - 1) & ~(alignment - 1);
+
+    if (start + size > base + b.size)
+    {
+        // Grow geometrically, so that a frame needs O(log) extra blocks at most
+        add_block(std::max(size + alignment, stats_.capacity));
+        return allocate(size, alignment);
+    }
+
+    offset = start + size - base;
+    stats_.bytes += size;
+    frame_peak = std::max(frame_peak, stats_.bytes);
+    stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.bytes);
+    return reinterpret_cast<void *>(start);
+}
+
+void frame_arena::deallocate (void * p, std::size_t size)
+{
+    // Only the most recent allocation can be given back; this makes
+    // a growing vector at the top of the arena reuse its own memory
+    block & b = blocks.back();
+    if (static_cast<char *>(p) + size == b.data + offset)
+    {
+        offset -= size;
+        stats_.bytes -= size;
+    }
+}
+
+void frame_arena::reset ( )
+{
+    stats_.last_frame_bytes = frame_peak;
+    stats_.last_frame_heap_allocations = stats_.heap_allocations;
+    stats_.bytes = 0;
+    frame_peak = 0;
+    stats_.heap_allocations = 0;
+
+    if (blocks.size() > 1)
+    {
+        std::size_t capacity = stats_.capacity;
+        for (block const & b : blocks)
+        {
+            memory_freed(memory_arenas, b.size);
+            delete [] b.data;
+        }
+        blocks.clear();
+        stats_.capacity = 0;
+        add_block(capacity);
+        // The merged block is accounted to the frame that needed it
+        stats_.last_frame_heap_allocations += stats_.heap_allocations;
+        stats_.heap_allocations = 0;
+    }
+
+    offset = 0;
+}
+
+frame_arena & thread_frame_arena ( )
+{
+    thread_local frame_arena arena;
+    return arena;
+}
@@ -0,0 +1,102 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+// Linear allocator for data that only lives for one frame (or one tick).
+// Allocation is a pointer bump, everything is released at once by reset().
+// If a frame did not fit into the current block, reset() replaces the block
+// chain with one block large enough for the whole frame, so steady-state
+// frames don't touch the heap at all.
+class frame_arena
+{
+public:
+    struct statistics
+    {
+        // In use now; last_frame_bytes is the most in use at once
+        std::size_t bytes;
+        std::size_t heap_allocations;
+        std::size_t last_frame_bytes;
+        std::size_t last_frame_heap_allocations;
+        std::size_t peak_bytes;
+        std::size_t capacity;
+    };
+
+    explicit frame_arena (std::size_t initial_capacity = 1 << 16);
+    ~frame_arena ( );
+
+    frame_arena (const frame_arena &) = delete;
+    frame_arena & operator = (const frame_arena &) = delete;
+
+    void * allocate (std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+    void deallocate (void * p, std::size_t size);
+
+    void reset ( );
+
+    const statistics & stats ( ) const { return stats_; }
+
+private:
+    struct block
+    {
+        char * data;
+        std::size_t size;
+    };
+
+    std::vector<block> blocks;
+    std::size_t offset;
+    std::size_t frame_peak;
+    statistics stats_;
+
+    void add_block (std::size_t size);
+};
+
+// One arena per thread, for scratch of calls that may run on any thread,
+// like cast_rays. It is never reset; memory given back in reverse order is
+// reused, so scratch freed before returning costs nothing after the first
+// call, and anything else stays taken.
+frame_arena & thread_frame_arena ( );
+
+template <typename T>
+struct arena_allocator
+{
+    typedef T value_type;
+
+    frame_arena * arena;
+
+    arena_allocator (frame_arena & arena)
+        : arena(&arena)
+    { }
+
+    template <typename U>
+    arena_allocator (const arena_allocator<U> & other)
+        : arena(other.arena)
+    { }
+
+    T * allocate (std::size_t n)
+    {
+        return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate (T * p, std::size_t n)
+    {
+        arena->deallocate(p, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator == (const arena_allocator<T> & a1, const arena_allocator<U> & a2)
+{
+    return a1.arena == a2.arena;
+}
+
+template <typename T, typename U>
+bool operator != (const arena_allocator<T> & a1, const arena_allocator<U> & a2)
+{
+    return a1.arena != a2.arena;
+}
+
+template <typename T>
+using arena_vector = std::vector<T, arena_allocator<T>>;
+
+#endif // FRAME_ARENA_H
@@ -0,0 +1,92 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+frame_scheduler::frame_scheduler (double frame_rate, double idle_rate)
+    : rate(frame_rate)
+    , idle_rate(idle_rate)
+    , render(true)
+    , started(false)
+    , has_frame(false)
+    , frames(0)
+    , skipped(0)
+    , sum(0.0)
+    , sum_squares(0.0)
+    , worst(0.0)
+{ }
+
+void frame_scheduler::set_frame_rate (double rate)
+{
+    this->rate = std::max(rate, 0.0);
+}
+
+void frame_scheduler::set_rendering (bool enabled)
+{
+    // The pause would count as one long frame
+    if (enabled && !render)
+        has_frame = false;
+    render = enabled;
+}
+
+double frame_scheduler::period ( ) const
+{
+    double r = render ? rate : idle_rate;
+    return r > 0.0 ? 1.0 / r : 0.0;
+}
+
+double frame_scheduler::begin_step ( )
+{
+    clock_type::time_point now = clock_type::now();
+    if (!started)
+    {
+        started = true;
+        last_step = next_step = now;
+    }
+
+    double dt = std::chrono::duration<double>(now - last_step).count();
+    last_step = now;
+
+    next_step += std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(period()));
+    if (next_step < now)
+        next_step = now;
+
+    if (!render)
+        ++skipped;
+    return dt;
+}
+
+void frame_scheduler::frame_presented ( )
+{
+    clock_type::time_point now = clock_type::now();
+    if (has_frame)
+    {
+        double ms = std::chrono::duration<double, std::milli>(now - last_frame).count();
+        ++frames;
+        sum += ms;
+        sum_squares += ms * ms;
+        worst = std::max(worst, ms);
+    }
+    has_frame = true;
+    last_frame = now;
+}
+
+int frame_scheduler::wait_ms ( ) const
+{
+    double ms = std::chrono::duration<double, std::milli>(next_step - clock_type::now()).count();
+    return std::max(0, static_cast<int>(std::floor(ms + 0.5)));
+}
+
+frame_scheduler::statistics frame_scheduler::take_stats ( )
+{
+    statistics result;
+    result.frames = frames;
+    result.skipped = skipped;
+    result.average_ms = frames > 0 ? sum / frames : 0.0;
+    result.jitter_ms = frames > 0 ? std::sqrt(std::max(sum_squares / frames - result.average_ms * result.average_ms, 0.0)) : 0.0;
+    result.worst_ms = worst;
+
+    frames = skipped = 0;
+    sum = sum_squares = worst = 0.0;
+    return result;
+}
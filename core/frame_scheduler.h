@@ -0,0 +1,64 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <chrono>
+#include <cstddef>
+
+// Paces the game loop: when the next step is due, the time it advances by
+// and whether it draws. Steps are scheduled on a fixed grid, so timer
+// rounding doesn't add up, and late steps don't cause a burst to catch up.
+class frame_scheduler
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    // Between presented frames, in milliseconds
+    struct statistics
+    {
+        std::size_t frames;
+        std::size_t skipped;
+        double average_ms;
+        double jitter_ms;
+        double worst_ms;
+    };
+
+    // A rate of 0 means as fast as buffer swaps allow, which is the
+    // display rate with vsync
+    explicit frame_scheduler (double frame_rate = 60.0, double idle_rate = 20.0);
+
+    void set_frame_rate (double rate);
+    double frame_rate ( ) const { return rate; }
+
+    // Steps still happen at the idle rate while nothing is drawn
+    void set_rendering (bool enabled);
+    bool rendering ( ) const { return render; }
+
+    // Starts a step; returns the seconds since the previous one
+    double begin_step ( );
+
+    // Called once a frame has been swapped to the screen
+    void frame_presented ( );
+
+    // How long to wait before the next step
+    int wait_ms ( ) const;
+
+    // For the frames since the previous call
+    statistics take_stats ( );
+
+private:
+    double rate, idle_rate;
+    bool render;
+
+    bool started;
+    clock_type::time_point last_step, next_step;
+
+    bool has_frame;
+    clock_type::time_point last_frame;
+
+    std::size_t frames, skipped;
+    double sum, sum_squares, worst;
+
+    double period ( ) const;
+};
+
+#endif // FRAME_SCHEDULER_H
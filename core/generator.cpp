@@ -0,0 +1,43 @@
+#include "generator.h"
+
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+
+void generate_world (world & w, int world_size, int base_height, double hue, double brightness)
+{
+    auto randomc = std::bind(std::uniform_int_distribution<int>(0, world_size - 1), std::default_random_engine());
+    auto randomh = std::bind(std::uniform_int_distribution<int>(-3, 3), std::default_random_engine());
+
+    std::vector<std::vector<int> > height(world_size, std::vector<int>(world_size, base_height + 5));
+
+    for (int iter = 0; iter < world_size * world_size / 10; ++iter)
+    {
+        int x = randomc();
+        int z = randomc();
+        int h = randomh();
+        if (h == 0) continue;
+
+        int ah = (h > 0) ? h : -h;
+        int th = (h > 0) ? 1 : -1;
+
+        for (int dx = -ah; dx <= ah; ++dx)
+            for (int dz = -ah; dz <= ah; ++dz)
+                if (x + dx >= 0 && x + dx < world_size && z + dz >= 0 && z + dz < world_size)
+                {
+                    height[x + dx][z + dz] += th * (ah - std::max(abs(dx), abs(dz)));
+                }
+    }
+
+    for (int x = 0; x < world_size; ++x)
+        for (int z = 0; z < world_size; ++z)
+        {
+            for (int y = base_height; y < height[x][z]; ++y)
+                w.add_cube(cube_position(x, y, z), hue, brightness);
+
+            w.add_cube(cube_position(x, height[x][z], z), hue, brightness);
+
+            w.paint(cube_position(x, height[x][z], z), 2, 1.5, 0.7);
+        }
+}
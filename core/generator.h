@@ -0,0 +1,10 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "world.h"
+
+// Fills a world_size x world_size area with bumpy terrain starting at
+// base_height; the top faces are painted as grass
+void generate_world (world & w, int world_size, int base_height, double hue, double brightness);
+
+#endif // GENERATOR_H
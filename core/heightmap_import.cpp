@@ -0,0 +1,424 @@
+#include "heightmap_import.h"
+#include "spsc_queue.h"
+
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+typedef std::chrono::high_resolution_clock clock_type;
+
+static double milliseconds_since (clock_type::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+pnm_reader::pnm_reader ( )
+    : width_(0)
+    , height_(0)
+    , channels_(0)
+    , max_value_(0)
+    , row_(0)
+{ }
+
+// Header fields are separated by whitespace and comments
+static bool read_field (std::istream & in, int & value)
+{
+    int c = in.get();
+    while (c != EOF && (std::isspace(c) || c == '#'))
+    {
+        if (c == '#')
+            while (c != EOF && c != '\n')
+                c = in.get();
+        c = in.get();
+    }
+    if (c == EOF || !std::isdigit(c))
+        return false;
+
+    long long result = 0;
+    while (c != EOF && std::isdigit(c))
+    {
+        result = result * 10 + (c - '0');
+        if (result > 1 << 30)
+            return false;
+        c = in.get();
+    }
+    value = static_cast<int>(result);
+
+    // A single whitespace character ends the field
+    return c != EOF && std::isspace(c);
+}
+
+bool pnm_reader::open (const std::string & path)
+{
+    file_.close();
+    file_.clear();
+    file_.open(path.c_str(), std::ios::binary);
+    row_ = 0;
+
+    char magic[2];
+    if (!file_ || !file_.read(magic, 2) || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6'))
+        return false;
+    channels_ = magic[1] == '5' ? 1 : 3;
+
+    return read_field(file_, width_) && read_field(file_, height_) && read_field(file_, max_value_)
+        && width_ > 0 && height_ > 0 && max_value_ > 0 && max_value_ < 65536;
+}
+
+bool pnm_reader::read_rows (int rows, std::vector<std::uint16_t> & samples)
+{
+    if (rows > rows_left())
+        return false;
+
+    std::size_t count = static_cast<std::size_t>(rows) * width_ * channels_;
+    int sample_bytes = max_value_ > 255 ? 2 : 1;
+    raw_.resize(count * sample_bytes);
+    if (!file_.read(reinterpret_cast<char *>(raw_.data()), raw_.size()))
+        return false;
+
+    // 16-bit samples are big-endian
+    samples.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+        samples[i] = sample_bytes == 2 ? (raw_[2 * i] << 8 | raw_[2 * i + 1]) : raw_[i];
+
+    row_ += rows;
+    return true;
+}
+
+heightmap_import_options::heightmap_import_options ( )
+    : origin_x(0)
+    , origin_z(0)
+    , base_height(-1)
+    , height_range(32)
+    , hue(0.5)
+    , brightness(0.25)
+    , top_hue(1.5)
+    , top_brightness(0.7)
+{ }
+
+// Colours are snapped to eighths of a hue and sixteenths of brightness,
+// as many as a player can tell apart, which keeps the chunk palettes small
+static const int hue_steps = 48;
+static const int brightness_steps = 33;
+static const std::uint16_t no_shade = 0xffff;
+
+// chunk_size rows of the image, the rows of one chunk along z
+struct band
+{
+    int z, rows;
+    bool ok;
+
+    std::vector<int, tracked_allocator<int, memory_heightmap>> heights;
+    std::vector<std::uint16_t, tracked_allocator<std::uint16_t, memory_heightmap>> shades;
+
+    std::size_t bytes ( ) const
+    {
+        return heights.capacity() * sizeof(int) + shades.capacity() * sizeof(std::uint16_t);
+    }
+};
+
+static bool read_band (pnm_reader & heights, pnm_reader * colors, const heightmap_import_options & options, band & b,
+    std::vector<std::uint16_t> & samples)
+{
+    if (!heights.read_rows(b.rows, samples))
+        return false;
+
+    double scale = static_cast<double>(options.height_range) / heights.max_value();
+    b.heights.resize(samples.size());
+    for (std::size_t i = 0; i < samples.size(); ++i)
+        b.heights[i] = options.base_height + static_cast<int>(std::floor(samples[i] * scale + 0.5));
+
+    b.shades.assign(samples.size(), no_shade);
+    if (!colors)
+        return true;
+
+    if (!colors->read_rows(b.rows, samples))
+        return false;
+
+    double unit = 1.0 / colors->max_value();
+    for (std::size_t i = 0; i < b.shades.size(); ++i)
+    {
+        double brightness, hue;
+        palette_color(color(samples[3 * i] * unit, samples[3 * i + 1] * unit, samples[3 * i + 2] * unit), brightness, hue);
+        int h = static_cast<int>(std::floor(hue * hue_steps / 6.0 + 0.5)) % hue_steps;
+        int l = std::min(static_cast<int>(std::floor(brightness * (brightness_steps - 1) / 2.0 + 0.5)), brightness_steps - 1);
+        b.shades[i] = h * brightness_steps + l;
+    }
+    return true;
+}
+
+static voxel colored_voxel (double hue, double brightness)
+{
+    voxel v = voxel();
+    v.solid = true;
+    v.material = material_cube;
+    std::fill(v.hue, v.hue + 6, hue);
+    std::fill(v.brightness, v.brightness + 6, brightness);
+    return v;
+}
+
+// Cells are built as indices into a palette of what the chunk uses, so
+// they are packed and hashed without ever being expanded. Kinds of cells
+// are numbered: empty, ground, the default top, then the shades.
+enum
+{
+    empty_cell,
+    ground_cell,
+    top_cell,
+    first_shade_cell
+};
+
+struct chunk_scratch
+{
+    std::vector<unsigned short> indices;
+    std::vector<voxel> palette;
+
+    // Where each kind of cell is in the palette, or -1
+    std::vector<int> entries;
+    std::vector<int> used;
+
+    chunk_scratch ( )
+        : indices(chunk_volume)
+        , entries(first_shade_cell + hue_steps * brightness_steps, -1)
+    { }
+};
+
+// Everything the workers share while building the chunks of a band
+struct column_builder
+{
+    const heightmap_import_options * options;
+    int width;
+    voxel kinds[first_shade_cell];
+
+    // A chunk with no cells of its own, copied instead of constructing
+    // one, which would expand its voxels
+    chunk blank;
+
+    // The chunk below the surface everywhere, packed once
+    chunk solid;
+
+    void prepare (const heightmap_import_options & o, int image_width)
+    {
+        options = &o;
+        width = image_width;
+        kinds[empty_cell] = voxel();
+        kinds[ground_cell] = colored_voxel(o.hue, o.brightness);
+        kinds[top_cell] = kinds[ground_cell];
+        kinds[top_cell].hue[2] = o.top_hue;
+        kinds[top_cell].brightness[2] = o.top_brightness;
+
+        blank.voxels = voxel_array();
+        solid = blank;
+
+        chunk_scratch s;
+        s.palette.push_back(kinds[ground_cell]);
+        std::fill(s.indices.begin(), s.indices.end(), 0);
+        for (int i = 0; i < chunk_volume; ++i)
+            solid.cell_filled(i);
+        solid.count = chunk_volume;
+        seal(solid, s);
+    }
+
+    voxel kind_voxel (int kind) const
+    {
+        if (kind < first_shade_cell)
+            return kinds[kind];
+
+        int shade = kind - first_shade_cell;
+        return colored_voxel(shade / brightness_steps * 6.0 / hue_steps, shade % brightness_steps * 2.0 / (brightness_steps - 1));
+    }
+
+    unsigned short entry (int kind, chunk_scratch & s) const
+    {
+        int & e = s.entries[kind];
+        if (e < 0)
+        {
+            e = s.palette.size();
+            s.palette.push_back(kind_voxel(kind));
+            s.used.push_back(kind);
+        }
+        return e;
+    }
+
+    static void seal (chunk & c, chunk_scratch & s)
+    {
+        c.hash = hash_voxels(s.palette.data(), s.indices.data());
+        c.hashed_revision = c.revision + 1;
+
+        std::shared_ptr<packed_voxels> packed = std::make_shared<packed_voxels>();
+        packed->palette.assign(s.palette.begin(), s.palette.end());
+        pack_indices(s.indices.data(), *packed);
+        c.packed = packed;
+        reset(s);
+    }
+
+    static void reset (chunk_scratch & s)
+    {
+        for (int kind : s.used)
+            s.entries[kind] = -1;
+        s.used.clear();
+        s.palette.clear();
+    }
+
+    // Builds the chunks of chunk column cx within the band, bottom up
+    void build (const band & b, int cx, chunk_scratch & s, std::vector<std::pair<chunk_position, chunk>> & result) const
+    {
+        const heightmap_import_options & o = *options;
+        int cz = chunk_coord(b.z);
+        int x0 = std::max(o.origin_x, cx * chunk_size), x1 = std::min(o.origin_x + width, (cx + 1) * chunk_size);
+
+        int low = o.base_height, high = o.base_height;
+        bool first = true;
+        for (int z = 0; z < b.rows; ++z)
+            for (int x = x0; x < x1; ++x)
+            {
+                int h = b.heights[z * width + x - o.origin_x];
+                low = first ? h : std::min(low, h);
+                high = first ? h : std::max(high, h);
+                first = false;
+            }
+        bool covered = x1 - x0 == chunk_size && b.rows == chunk_size;
+
+        for (int cy = chunk_coord(o.base_height); cy <= chunk_coord(high); ++cy)
+        {
+            int bottom = cy * chunk_size, ceiling = bottom + chunk_size - 1;
+            if (covered && o.base_height <= bottom && low > ceiling)
+            {
+                result.push_back(std::make_pair(chunk_position(cx, cy, cz), solid));
+                continue;
+            }
+
+            chunk c = blank;
+            std::fill(s.indices.begin(), s.indices.end(), entry(empty_cell, s));
+            for (int z = 0; z < b.rows; ++z)
+                for (int x = x0; x < x1; ++x)
+                {
+                    std::size_t pixel = z * width + x - o.origin_x;
+                    int h = b.heights[pixel];
+                    int lx = x - cx * chunk_size, lz = b.z + z - cz * chunk_size;
+                    for (int y = std::max(o.base_height, bottom); y <= std::min(h, ceiling); ++y)
+                    {
+                        int kind = y < h ? int(ground_cell) : (b.shades[pixel] == no_shade ? int(top_cell) : first_shade_cell + b.shades[pixel]);
+                        int index = voxel_index(lx, y - bottom, lz);
+                        s.indices[index] = entry(kind, s);
+                        c.cell_filled(index);
+                        ++c.count;
+                    }
+                }
+
+            if (c.count == 0)
+            {
+                reset(s);
+                continue;
+            }
+            seal(c, s);
+            result.push_back(std::make_pair(chunk_position(cx, cy, cz), c));
+        }
+    }
+};
+
+bool import_heightmap (world & w, worker_pool & pool, const std::string & path, const heightmap_import_options & options,
+    heightmap_import_statistics & stats)
+{
+    auto start = clock_type::now();
+    stats = heightmap_import_statistics();
+
+    pnm_reader heights, colors;
+    if (!heights.open(path) || heights.channels() != 1)
+        return false;
+    bool colored = !options.colors.empty();
+    if (colored && (!colors.open(options.colors) || colors.channels() != 3
+        || colors.width() != heights.width() || colors.height() != heights.height()))
+        return false;
+
+    stats.width = heights.width();
+    stats.height = heights.height();
+
+    column_builder builder;
+    builder.prepare(options, heights.width());
+
+    int first_cz = chunk_coord(options.origin_z), last_cz = chunk_coord(options.origin_z + heights.height() - 1);
+    int first_cx = chunk_coord(options.origin_x), last_cx = chunk_coord(options.origin_x + heights.width() - 1);
+
+    // The reader stays up to band_buffers bands ahead; the buffers go
+    // back and forth between it and this thread through the queues
+    const int band_buffers = 3;
+    band bands[band_buffers];
+    std::vector<std::uint16_t> samples;
+    spsc_queue<int, band_buffers + 1> filled, empty;
+    for (int i = 0; i < band_buffers; ++i)
+        empty.push(i);
+
+    double read_ms = 0.0;
+    std::thread reader([&]()
+    {
+        for (int cz = first_cz; cz <= last_cz; ++cz)
+        {
+            int slot;
+            while (!empty.pop(slot))
+                std::this_thread::yield();
+
+            band & b = bands[slot];
+            b.z = std::max(options.origin_z, cz * chunk_size);
+            b.rows = std::min(options.origin_z + heights.height(), (cz + 1) * chunk_size) - b.z;
+
+            auto t = clock_type::now();
+            b.ok = read_band(heights, colored ? &colors : nullptr, options, b, samples);
+            read_ms += milliseconds_since(t);
+
+            filled.push(slot);
+            if (!b.ok)
+                return;
+        }
+    });
+
+    std::vector<std::vector<std::pair<chunk_position, chunk>>> columns(last_cx - first_cx + 1);
+    std::vector<chunk_scratch> scratch(pool.size());
+
+    bool ok = true;
+    for (int cz = first_cz; cz <= last_cz; ++cz)
+    {
+        int slot;
+        while (!filled.pop(slot))
+            std::this_thread::yield();
+
+        band const & b = bands[slot];
+        if (!b.ok)
+        {
+            ok = false;
+            break;
+        }
+
+        auto t = clock_type::now();
+        pool.run(columns.size(), [&](std::size_t item, unsigned int worker)
+        {
+            columns[item].clear();
+            builder.build(b, first_cx + item, scratch[worker], columns[item]);
+        });
+        stats.build_ms += milliseconds_since(t);
+
+        t = clock_type::now();
+        for (auto & column : columns)
+            for (auto const & c : column)
+            {
+                w.set_chunk(c.first, c.second);
+                ++stats.chunks;
+                stats.cubes += c.second.count;
+                if (c.second.packed == builder.solid.packed)
+                    ++stats.solid_chunks;
+            }
+        stats.insert_ms += milliseconds_since(t);
+
+        ++stats.bands;
+        empty.push(slot);
+    }
+    reader.join();
+
+    for (band const & b : bands)
+        stats.peak_band_bytes += b.bytes();
+    stats.read_ms = read_ms;
+    stats.total_ms = milliseconds_since(start);
+    return ok;
+}
@@ -0,0 +1,83 @@
+#ifndef HEIGHTMAP_IMPORT_H
+#define HEIGHTMAP_IMPORT_H
+
+#include "world.h"
+#include "worker_pool.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Binary PGM (P5) and PPM (P6) images with 8 or 16 bits per sample, read
+// a few rows at a time so they never have to fit in memory
+class pnm_reader
+{
+public:
+    pnm_reader ( );
+
+    bool open (const std::string & path);
+
+    int width ( ) const { return width_; }
+    int height ( ) const { return height_; }
+    int channels ( ) const { return channels_; }
+    int max_value ( ) const { return max_value_; }
+    int rows_left ( ) const { return height_ - row_; }
+
+    // The next rows rows, channels samples per pixel; false if the file
+    // ends early
+    bool read_rows (int rows, std::vector<std::uint16_t> & samples);
+
+private:
+    std::ifstream file_;
+    int width_, height_, channels_, max_value_;
+    int row_;
+    std::vector<unsigned char> raw_;
+};
+
+struct heightmap_import_options
+{
+    // Where the first pixel goes; rows run along z
+    int origin_x, origin_z;
+
+    // Every column is solid from base_height up to base_height plus
+    // height_range times the sample over the largest sample
+    int base_height;
+    int height_range;
+
+    // Of the ground, and of the top faces when there are no colours
+    double hue, brightness;
+    double top_hue, top_brightness;
+
+    // A PPM of the same size colouring the top cube of every column
+    std::string colors;
+
+    heightmap_import_options ( );
+};
+
+struct heightmap_import_statistics
+{
+    int width, height;
+    std::size_t bands;
+    std::size_t chunks;
+    // Chunks below the surface, which all share one packed copy
+    std::size_t solid_chunks;
+    std::size_t cubes;
+    std::size_t peak_band_bytes;
+    double read_ms;
+    double build_ms;
+    double insert_ms;
+    double total_ms;
+};
+
+// Streams a grayscale heightmap into the world a band of chunk_size rows
+// at a time: a reader thread reads ahead by a few bands while the worker
+// pool builds a column of chunks each, packed right away, so memory is
+// bounded by the band width rather than the image. Returns false if the
+// files can't be read or don't match, before the world is touched, or if
+// they end early, with the bands before that imported.
+bool import_heightmap (world & w, worker_pool & pool, const std::string & path, const heightmap_import_options & options,
+    heightmap_import_statistics & stats);
+
+#endif // HEIGHTMAP_IMPORT_H
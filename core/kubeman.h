@@ -0,0 +1,13 @@
+#pragma once
+
+struct kubeman
+{
+    double x, y, z;
+    double alpha;
+    unsigned int id;
+
+    kubeman ( ) { }
+    kubeman (double x, double y, double z, double alpha = 0.0, unsigned int id = 0)
+        : x(x), y(y), z(z), alpha(alpha), id(id)
+    { }
+};
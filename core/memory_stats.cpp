@@ -0,0 +1,75 @@
+#include "memory_stats.h"
+
+#include <atomic>
+#include <iomanip>
+
+namespace
+{
+    struct counter
+    {
+        std::atomic<std::size_t> bytes;
+        std::atomic<std::size_t> peak_bytes;
+        std::atomic<std::size_t> allocations;
+    };
+
+    // Zero-initialised before any constructor runs, so static objects can
+    // allocate from tracked containers
+    counter counters[memory_subsystem_count];
+
+    const char * names[memory_subsystem_count] = {
+        "chunks", "voxels", "packed", "heightmap", "meshes", "gpu", "navigation", "debris", "bodies", "arenas"
+    };
+}
+
+const char * memory_subsystem_name (int subsystem)
+{
+    return names[subsystem];
+}
+
+void memory_allocated (int subsystem, std::size_t bytes)
+{
+    counter & c = counters[subsystem];
+    std::size_t now = c.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+
+    std::size_t peak = c.peak_bytes.load(std::memory_order_relaxed);
+    while (now > peak && !c.peak_bytes.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+        ;
+}
+
+void memory_freed (int subsystem, std::size_t bytes)
+{
+    counter & c = counters[subsystem];
+    c.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    c.allocations.fetch_sub(1, std::memory_order_relaxed);
+}
+
+memory_usage memory_stats (int subsystem)
+{
+    counter const & c = counters[subsystem];
+    memory_usage result;
+    result.bytes = c.bytes.load(std::memory_order_relaxed);
+    result.peak_bytes = c.peak_bytes.load(std::memory_order_relaxed);
+    result.allocations = c.allocations.load(std::memory_order_relaxed);
+    return result;
+}
+
+std::size_t memory_total ( )
+{
+    std::size_t total = 0;
+    for (int s = 0; s < memory_subsystem_count; ++s)
+        total += memory_stats(s).bytes;
+    return total;
+}
+
+void dump_memory_stats (std::ostream & out)
+{
+    for (int s = 0; s < memory_subsystem_count; ++s)
+    {
+        memory_usage u = memory_stats(s);
+        out << "memory: " << std::left << std::setw(12) << memory_subsystem_name(s) << std::right
+            << std::setw(10) << u.bytes / 1024 << " KiB, " << std::setw(10) << u.peak_bytes / 1024 << " KiB peak, "
+            << u.allocations << " allocations\n";
+    }
+    out << "memory: total " << memory_total() / 1024 << " KiB" << std::endl;
+}
@@ -0,0 +1,84 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <ostream>
+#include <cstddef>
+
+// Bytes held by each part of the program, counted as they are allocated
+// and freed, so they can be read at any time from any thread
+enum memory_subsystem
+{
+    memory_chunks,       // map nodes and chunk headers
+    memory_voxels,       // expanded chunks, including the cache of cold ones
+    memory_packed,       // packed cold chunks
+    memory_heightmap,
+    memory_meshes,       // chunk meshes on the CPU
+    memory_gpu,          // textures and buffers handed to OpenGL
+    memory_navigation,
+    memory_debris,       // particles of destroyed cubes
+    memory_bodies,       // boxes moved by the batched physics
+    memory_arenas,       // frame and worker scratch arenas
+    memory_subsystem_count
+};
+
+struct memory_usage
+{
+    std::size_t bytes;
+    std::size_t peak_bytes;
+    std::size_t allocations;
+};
+
+const char * memory_subsystem_name (int subsystem);
+
+void memory_allocated (int subsystem, std::size_t bytes);
+void memory_freed (int subsystem, std::size_t bytes);
+
+memory_usage memory_stats (int subsystem);
+std::size_t memory_total ( );
+
+// One line per subsystem and the total, for logs
+void dump_memory_stats (std::ostream & out);
+
+// Counts what a standard container allocates towards a subsystem
+template <typename T, int subsystem>
+struct tracked_allocator
+{
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef tracked_allocator<U, subsystem> other;
+    };
+
+    tracked_allocator ( ) { }
+
+    template <typename U>
+    tracked_allocator (const tracked_allocator<U, subsystem> &) { }
+
+    T * allocate (std::size_t n)
+    {
+        memory_allocated(subsystem, n * sizeof(T));
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate (T * p, std::size_t n)
+    {
+        memory_freed(subsystem, n * sizeof(T));
+        ::operator delete(p);
+    }
+};
+
+template <typename T, typename U, int subsystem>
+inline bool operator == (const tracked_allocator<T, subsystem> &, const tracked_allocator<U, subsystem> &)
+{
+    return true;
+}
+
+template <typename T, typename U, int subsystem>
+inline bool operator != (const tracked_allocator<T, subsystem> &, const tracked_allocator<U, subsystem> &)
+{
+    return false;
+}
+
+#endif // MEMORY_STATS_H
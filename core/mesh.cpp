@@ -0,0 +1,417 @@
+#include "mesh.h"
+#include "face_mesher.h"
+
+#include <algorithm>
+
+mesh::mesh (frame_arena & arena)
+    : vertices(arena_allocator<double>(arena))
+    , tex_coords(arena_allocator<double>(arena))
+    , colors(arena_allocator<double>(arena))
+    , normals(arena_allocator<double>(arena))
+    , faces(0)
+{ }
+
+// Passes on the faces that face the eye point
+template <typename Format>
+class eye_culled
+{
+public:
+    eye_culled (Format & out, double eye_x, double eye_y, double eye_z)
+        : faces(0)
+        , out(out)
+        , eye{eye_x, eye_y, eye_z}
+    { }
+
+    std::size_t faces;
+
+    template <int Plane>
+    void face (int x, int y, int z, const color & c, int layer)
+    {
+        double r = (eye[0] - x) * face_normals[Plane][0] + (eye[1] - y) * face_normals[Plane][1] + (eye[2] - z) * face_normals[Plane][2] - 0.5;
+        if (r < 0)
+            return;
+
+        ++faces;
+        out.template face<Plane>(x, y, z, c, layer);
+    }
+
+private:
+    Format & out;
+    double eye[3];
+};
+
+void build_mesh (const world & w, double eye_x, double eye_y, double eye_z, mesh & result)
+{
+    result.vertices.reserve(w.size() * 6 * 12);
+    result.tex_coords.reserve(w.size() * 6 * 12);
+    result.colors.reserve(w.size() * 6 * 16);
+    result.normals.reserve(w.size() * 6 * 12);
+
+    double_arrays<arena_vector<double>> arrays(result.vertices, result.tex_coords, result.colors, result.normals);
+    eye_culled<double_arrays<arena_vector<double>>> out(arrays, eye_x, eye_y, eye_z);
+    for (auto const & cp : w.chunks())
+    {
+        chunk const & c = cp.second;
+        if (c.count == 0) continue;
+
+        const voxel * voxels = w.cells(cp.first, c);
+        for (int p = 0; p < 6; ++p)
+            if (faces_eye(cp.first, p, eye_x, eye_y, eye_z))
+                mesh_plane(p, w, cp.first, voxels, all_faces, out);
+    }
+    result.faces += out.faces;
+}
+
+bool faces_eye (chunk_position cp, int plane, double eye_x, double eye_y, double eye_z)
+{
+    // A face at cube coordinate c with direction +1 faces the eye if the
+    // eye is beyond c + 0.5; one cube of slack covers both stereo eyes
+    double eye[3] = {eye_x, eye_y, eye_z};
+    int base[3] = {cp.x * chunk_size, cp.y * chunk_size, cp.z * chunk_size};
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        int d = face_normals[plane][axis];
+        if (d > 0)
+            return eye[axis] > base[axis] - 0.5;
+        if (d < 0)
+            return eye[axis] < base[axis] + chunk_size - 0.5;
+    }
+    return true;
+}
+
+static void build_chunk_mesh (const world & w, chunk_position cp, const chunk & c, chunk_mesh & result)
+{
+    result.vertices.clear();
+    result.centers.clear();
+    result.order.clear();
+    result.indices.clear();
+    result.sorted = false;
+
+    const voxel * voxels = w.cells(cp, c);
+    packed_vertices<chunk_mesh::vertex_vector> out(result.vertices);
+
+    // Opaque faces by plane, then the translucent ones
+    std::size_t faces = 0;
+    for (int p = 0; p < 6; ++p)
+    {
+        result.first[p] = faces;
+        faces += mesh_plane(p, w, cp, voxels, opaque_faces, out);
+    }
+    result.first[6] = faces;
+    for (int p = 0; p < 6; ++p)
+        faces += mesh_plane(p, w, cp, voxels, translucent_faces, out);
+    result.translucent = faces - result.first[6];
+
+    // Opposite corners of a face meet in its middle
+    for (std::size_t f = result.first[6]; f < faces; ++f)
+    {
+        const packed_vertex * corners = &result.vertices[4 * f];
+        for (int a = 0; a < 3; ++a)
+            result.centers.push_back((double(corners[0].position[a]) + corners[2].position[a]) * 0.5);
+        result.order.push_back(result.order.size());
+    }
+}
+
+// All a chunk mesh depends on: the chunk, and the materials of the cells
+// of each neighbour that touch it
+static std::uint64_t mesh_key (const world & w, chunk_position cp, const chunk & c)
+{
+    std::uint64_t key = c.content_hash();
+    for (int p = 0; p < 6; ++p)
+    {
+        chunk_position np(cp.x + face_normals[p][0], cp.y + face_normals[p][1], cp.z + face_normals[p][2]);
+        auto it = w.chunks().find(np);
+        if (it == w.chunks().end() || it->second.count == 0)
+        {
+            key = hash_mix(key, p);
+            continue;
+        }
+
+        // The layer of the neighbour on the side facing the chunk
+        int axis = p / 2, layer = face_normals[p][axis] > 0 ? 0 : chunk_size - 1;
+        const voxel * voxels = w.cells(np, it->second);
+        std::uint64_t side = p + 1;
+        for (int a = 0; a < chunk_size; ++a)
+            for (int b = 0; b < chunk_size; ++b)
+            {
+                int l[3];
+                l[axis] = layer;
+                l[(axis + 1) % 3] = a;
+                l[(axis + 2) % 3] = b;
+                voxel const & v = voxels[voxel_index(l[0], l[1], l[2])];
+                side = hash_mix(side, v.solid ? 1 + v.material : 0);
+            }
+        key = hash_mix(key, side);
+    }
+    return key;
+}
+
+// A copy of the mesh of an identical chunk, moved by the given number of
+// chunks
+static void move_mesh (const chunk_mesh & source, int dx, int dy, int dz, chunk_mesh & result)
+{
+    result = source;
+
+    double offset[3] = {dx * double(chunk_size), dy * double(chunk_size), dz * double(chunk_size)};
+    for (packed_vertex & v : result.vertices)
+        for (int a = 0; a < 3; ++a)
+            v.position[a] += float(offset[a]);
+    for (std::size_t i = 0; i < result.centers.size(); ++i)
+        result.centers[i] += offset[i % 3];
+
+    // The old order is still a good start for sorting
+    result.sorted = false;
+}
+
+static unsigned int revision_of (const world & w, chunk_position p)
+{
+    auto it = w.chunks().find(p);
+    return it == w.chunks().end() ? 0 : it->second.revision + 1;
+}
+
+std::size_t mesh_cache::sort_translucent (double eye_x, double eye_y, double eye_z, frame_arena & arena)
+{
+    // Moving less than this rarely changes which face is in front
+    const double resort_distance = 0.25;
+
+    std::size_t sorted = 0;
+    arena_vector<double> keys{arena_allocator<double>(arena)};
+    for (auto & m : meshes_)
+    {
+        chunk_mesh & cm = m.second;
+        if (cm.translucent == 0)
+            continue;
+
+        double dx = eye_x - cm.sorted_eye[0], dy = eye_y - cm.sorted_eye[1], dz = eye_z - cm.sorted_eye[2];
+        if (cm.sorted && dx * dx + dy * dy + dz * dz < resort_distance * resort_distance)
+            continue;
+
+        keys.resize(cm.translucent);
+        for (std::size_t f = 0; f < cm.translucent; ++f)
+        {
+            double fx = cm.centers[3 * f + 0] - eye_x, fy = cm.centers[3 * f + 1] - eye_y, fz = cm.centers[3 * f + 2] - eye_z;
+            keys[f] = fx * fx + fy * fy + fz * fz;
+        }
+
+        // Insertion sort, farthest first: the previous order is nearly right
+        chunk_mesh::index_vector & order = cm.order;
+        if (!cm.sorted)
+            std::sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b){ return keys[a] > keys[b]; });
+        for (std::size_t i = 1; i < order.size(); ++i)
+        {
+            unsigned int f = order[i];
+            std::size_t j = i;
+            for (; j > 0 && keys[order[j - 1]] < keys[f]; --j)
+                order[j] = order[j - 1];
+            order[j] = f;
+        }
+
+        cm.indices.resize(cm.translucent * 4);
+        for (std::size_t i = 0; i < order.size(); ++i)
+            for (unsigned int k = 0; k < 4; ++k)
+                cm.indices[4 * i + k] = (cm.first[6] + order[i]) * 4 + k;
+
+        cm.sorted_eye[0] = eye_x;
+        cm.sorted_eye[1] = eye_y;
+        cm.sorted_eye[2] = eye_z;
+        cm.sorted = true;
+        ++sorted;
+    }
+    return sorted;
+}
+
+mesh_cache::mesh_cache ( )
+    : faces_(0)
+    , reused_(0)
+    , versions_(0)
+{ }
+
+static std::size_t faces_of (const chunk_mesh & cm)
+{
+    return cm.first[6] + cm.translucent;
+}
+
+bool mesh_cache::refresh (const world & w, chunk_position cp, const chunk & c, chunk_mesh & cm, bool fresh)
+{
+    unsigned int revisions[7];
+    revisions[6] = c.revision + 1;
+    for (int p = 0; p < 6; ++p)
+        revisions[p] = revision_of(w, chunk_position(cp.x + face_normals[p][0], cp.y + face_normals[p][1], cp.z + face_normals[p][2]));
+
+    if (!fresh && std::equal(revisions, revisions + 7, cm.revisions))
+        return false;
+
+    std::uint64_t key = mesh_key(w, cp, c);
+    auto known = by_key_.find(key);
+    auto source = known == by_key_.end() ? meshes_.end() : meshes_.find(known->second);
+    if (source != meshes_.end() && !(source->first == cp) && source->second.key == key)
+    {
+        move_mesh(source->second, cp.x - source->first.x, cp.y - source->first.y, cp.z - source->first.z, cm);
+        ++reused_;
+    }
+    else
+    {
+        build_chunk_mesh(w, cp, c, cm);
+        cm.key = key;
+        by_key_[key] = cp;
+    }
+    std::copy(revisions, revisions + 7, cm.revisions);
+    cm.version = ++versions_;
+    return true;
+}
+
+std::size_t mesh_cache::update (const world & w)
+{
+    reused_ = 0;
+
+    std::size_t rebuilt;
+    if (!changes_.reads(w.journal().get()))
+    {
+        changes_ = journal_reader(w.journal());
+        rebuilt = update_all(w);
+    }
+    else if (changes_.changed_chunks(changed_))
+        rebuilt = update_changed(w);
+    else
+        rebuilt = update_all(w);
+
+    // Forget keys of meshes that are gone or were rebuilt differently
+    if (by_key_.size() > 2 * meshes_.size() + 64)
+        for (auto it = by_key_.begin(); it != by_key_.end(); )
+        {
+            auto source = meshes_.find(it->second);
+            if (source == meshes_.end() || source->second.key != it->first)
+                it = by_key_.erase(it);
+            else
+                ++it;
+        }
+
+    return rebuilt;
+}
+
+std::size_t mesh_cache::update_all (const world & w)
+{
+    std::size_t rebuilt = 0;
+    faces_ = 0;
+
+    // Both maps are ordered the same way
+    auto m = meshes_.begin();
+    for (auto const & cp : w.chunks())
+    {
+        while (m != meshes_.end() && m->first < cp.first)
+            m = meshes_.erase(m);
+
+        bool exists = m != meshes_.end() && m->first == cp.first;
+        if (cp.second.count == 0)
+        {
+            if (exists)
+                m = meshes_.erase(m);
+            continue;
+        }
+
+        if (!exists)
+            m = meshes_.insert(m, std::make_pair(cp.first, chunk_mesh()));
+
+        rebuilt += refresh(w, cp.first, cp.second, m->second, !exists);
+        faces_ += faces_of(m->second);
+        ++m;
+    }
+    meshes_.erase(m, meshes_.end());
+    return rebuilt;
+}
+
+std::size_t mesh_cache::update_changed (const world & w)
+{
+    // A mesh depends on its chunk and the layers of the neighbours that
+    // touch it
+    dirty_.clear();
+    for (chunk_position const & cp : changed_)
+    {
+        dirty_.push_back(cp);
+        for (int p = 0; p < 6; ++p)
+            dirty_.push_back(chunk_position(cp.x + face_normals[p][0], cp.y + face_normals[p][1], cp.z + face_normals[p][2]));
+    }
+    std::sort(dirty_.begin(), dirty_.end());
+    dirty_.erase(std::unique(dirty_.begin(), dirty_.end()), dirty_.end());
+
+    std::size_t rebuilt = 0;
+    for (chunk_position const & cp : dirty_)
+    {
+        auto c = w.chunks().find(cp);
+        auto m = meshes_.find(cp);
+        if (c == w.chunks().end() || c->second.count == 0)
+        {
+            if (m != meshes_.end())
+            {
+                faces_ -= faces_of(m->second);
+                meshes_.erase(m);
+            }
+            continue;
+        }
+
+        bool fresh = m == meshes_.end();
+        if (fresh)
+            m = meshes_.insert(std::make_pair(cp, chunk_mesh())).first;
+
+        std::size_t before = fresh ? 0 : faces_of(m->second);
+        if (refresh(w, cp, c->second, m->second, fresh))
+        {
+            faces_ = faces_ - before + faces_of(m->second);
+            ++rebuilt;
+        }
+    }
+    return rebuilt;
+}
+
+void build_draw_commands (const mesh_cache & meshes, const std::size_t * firsts, double eye_x, double eye_y, double eye_z,
+    frame_arena & arena, std::vector<draw_command> & commands)
+{
+    // All groups of a chunk are as far away, so whole chunks are sorted
+    struct ranked
+    {
+        double distance;
+        std::size_t index;
+        const mesh_cache::mesh_map::value_type * mesh;
+    };
+    arena_vector<ranked> ranked_meshes{arena_allocator<ranked>(arena)};
+
+    std::size_t i = 0;
+    for (auto const & m : meshes.meshes())
+    {
+        ranked r;
+        double dx = (m.first.x + 0.5) * chunk_size - eye_x, dy = (m.first.y + 0.5) * chunk_size - eye_y, dz = (m.first.z + 0.5) * chunk_size - eye_z;
+        r.distance = dx * dx + dy * dy + dz * dz;
+        r.index = i++;
+        r.mesh = &m;
+        if (m.second.first[6] > 0)
+            ranked_meshes.push_back(r);
+    }
+
+    // Front to back, so hidden fragments fail the depth test early; equal
+    // distances keep the order of the meshes
+    std::sort(ranked_meshes.begin(), ranked_meshes.end(), [](const ranked & a, const ranked & b)
+    {
+        return a.distance < b.distance || (a.distance == b.distance && a.index < b.index);
+    });
+
+    commands.clear();
+    for (ranked const & r : ranked_meshes)
+    {
+        chunk_position cp = r.mesh->first;
+        chunk_mesh const & cm = r.mesh->second;
+        for (int p = 0; p < 6; ++p)
+        {
+            std::size_t count = (cm.first[p + 1] - cm.first[p]) * 4;
+            if (count == 0 || !faces_eye(cp, p, eye_x, eye_y, eye_z))
+                continue;
+
+            draw_command c;
+            c.count = count;
+            c.instances = 1;
+            c.first = firsts[r.index] + cm.first[p] * 4;
+            c.base_instance = 0;
+            commands.push_back(c);
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "world.h"
+#include "frame_arena.h"
+#include "change_journal.h"
+#include "face_mesher.h"
+
+#include <unordered_map>
+#include <cstdint>
+
+// Vertex arrays for the visible faces of the world, laid out for
+// glDrawArrays(GL_QUADS): 4 vertices per face. Texture coordinates are
+// u, v and the material, which is the layer of the texture array.
+struct mesh
+{
+    arena_vector<double> vertices;
+    arena_vector<double> tex_coords;
+    arena_vector<double> colors;
+    arena_vector<double> normals;
+    std::size_t faces;
+
+    explicit mesh (frame_arena & arena);
+};
+
+// Emits every face that is not covered by a neighbouring cube and
+// faces the eye point
+void build_mesh (const world & w, double eye_x, double eye_y, double eye_z, mesh & result);
+
+// The uncovered faces of one chunk. Opaque faces come first, grouped by
+// plane index so that whole groups facing away from the eye can be
+// skipped: group p spans faces first[p] to first[p + 1]. The translucent
+// faces follow from first[6] on and are drawn through indices, which
+// mesh_cache::sort_translucent keeps in back to front order. Vertices
+// are packed as the vertex buffer takes them; the centres of translucent
+// faces, which the sort compares, stay doubles.
+struct chunk_mesh
+{
+    typedef std::vector<packed_vertex, tracked_allocator<packed_vertex, memory_meshes>> vertex_vector;
+    typedef std::vector<double, tracked_allocator<double, memory_meshes>> center_vector;
+    typedef std::vector<unsigned int, tracked_allocator<unsigned int, memory_meshes>> index_vector;
+
+    vertex_vector vertices;
+    std::size_t first[7];
+
+    std::size_t translucent;
+    center_vector centers;
+    index_vector order;
+    index_vector indices;
+    double sorted_eye[3];
+    bool sorted;
+
+    // Of the chunk and its six neighbours when the mesh was built, 0 for
+    // a missing chunk
+    unsigned int revisions[7];
+
+    // The content hash of the chunk mixed with what it sees of its
+    // neighbours; chunks with equal keys have the same mesh, moved
+    std::uint64_t key;
+
+    // Changes whenever the faces do, so copies elsewhere, like on the GPU,
+    // can tell they are stale; the translucent order doesn't count
+    std::uint64_t version;
+};
+
+// Whether some face of group plane of the chunk at cp may face the eye
+bool faces_eye (chunk_position cp, int plane, double eye_x, double eye_y, double eye_z);
+
+// Keeps a chunk_mesh for every non-empty chunk, rebuilding only those
+// that changed (or whose neighbours did) since the last update. Which
+// chunks those may be comes from the journal of the world; only the
+// first update, and one after missing some of the journal, look at every
+// chunk. A chunk whose key matches another mesh gets a moved copy of
+// that one instead.
+class mesh_cache
+{
+public:
+    typedef std::map<chunk_position, chunk_mesh, std::less<chunk_position>,
+        tracked_allocator<std::pair<const chunk_position, chunk_mesh>, memory_meshes>> mesh_map;
+
+    mesh_cache ( );
+
+    // Returns the number of rebuilt chunks, including the copied ones
+    std::size_t update (const world & w);
+
+    // Orders the translucent faces of every chunk back to front. The last
+    // order is the starting point, so after small camera moves this is
+    // close to linear; chunks the eye barely moved for are skipped.
+    // Returns the number of chunks sorted. The sort keys are taken from
+    // arena.
+    std::size_t sort_translucent (double eye_x, double eye_y, double eye_z, frame_arena & arena);
+
+    const mesh_map & meshes ( ) const { return meshes_; }
+    std::size_t faces ( ) const { return faces_; }
+
+    // Chunks the last update copied from an identical one
+    std::size_t reused ( ) const { return reused_; }
+
+private:
+    mesh_map meshes_;
+    std::size_t faces_;
+    std::size_t reused_;
+    std::uint64_t versions_;
+
+    // Some chunk last built with each key; checked against its mesh
+    // before use, since that may have changed since
+    std::unordered_map<std::uint64_t, chunk_position> by_key_;
+
+    journal_reader changes_;
+    std::vector<chunk_position> changed_;
+    std::vector<chunk_position> dirty_;
+
+    std::size_t update_all (const world & w);
+    std::size_t update_changed (const world & w);
+
+    // Rebuilds the mesh if it is fresh or its revisions are out of date
+    bool refresh (const world & w, chunk_position cp, const chunk & c, chunk_mesh & cm, bool fresh);
+};
+
+// One draw of a face group out of a buffer with the meshes of all chunks,
+// laid out like the GL indirect command
+struct draw_command
+{
+    std::uint32_t count;
+    std::uint32_t instances;
+    std::uint32_t first;
+    std::uint32_t base_instance;
+};
+
+// The draws of the face groups of meshes that may face the eye, nearest
+// chunk first; the mesh of the i-th chunk starts at vertex firsts[i] of
+// the buffer. The sort takes its scratch from arena.
+void build_draw_commands (const mesh_cache & meshes, const std::size_t * firsts, double eye_x, double eye_y, double eye_z,
+    frame_arena & arena, std::vector<draw_command> & commands);
+
+#endif // MESH_H
@@ -0,0 +1,44 @@
+#include "minimap.h"
+
+#include <algorithm>
+
+void render_minimap (const world & w, int center_x, int center_z, int size, std::vector<unsigned char> & rgb)
+{
+    rgb.assign(size * size * 3, 0);
+
+    int x0 = center_x - size / 2;
+    int z0 = center_z - size / 2;
+
+    for (int row = 0; row < size; ++row)
+    {
+        int z = z0 + row;
+        int previous = 0;
+        bool has_previous = w.top(x0 - 1, z, previous);
+
+        for (int column = 0; column < size; ++column)
+        {
+            int x = x0 + column;
+            int y;
+            if (!w.top(x, z, y))
+            {
+                has_previous = false;
+                continue;
+            }
+
+            // Planes are +x, -x, +y, ...; the map shows the +y face
+            voxel const * v = w.find(cube_position(x, y, z));
+            color c = get_color(v->brightness[2], v->hue[2]);
+
+            double shade = 1.0;
+            if (has_previous)
+                shade = std::min(std::max(1.0 + 0.15 * (y - previous), 0.5), 1.5);
+
+            unsigned char * pixel = &rgb[(row * size + column) * 3];
+            for (int i = 0; i < 3; ++i)
+                pixel[i] = static_cast<unsigned char>(std::min(c.data[i] * shade, 1.0) * 255.0);
+
+            previous = y;
+            has_previous = true;
+        }
+    }
+}
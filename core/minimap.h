@@ -0,0 +1,13 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include "world.h"
+
+#include <vector>
+
+// Top-down view of size x size columns centered at x, z, read from the
+// world heightmap: rgb rows go from -z to +z, columns from -x to +x.
+// Columns higher than their -x neighbour are lit, empty ones are black.
+void render_minimap (const world & w, int center_x, int center_z, int size, std::vector<unsigned char> & rgb);
+
+#endif // MINIMAP_H
@@ -0,0 +1,573 @@
+#include "navigation.h"
+
+#include <algorithm>
+#include <queue>
+#include <unordered_set>
+#include <cstdlib>
+
+static const int sides[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+// Level, one up, then down, as a walker would try them
+static const int climbs[4] = {0, 1, -1, -2};
+
+// A layer above the highest chunk to stand in, and two for headroom
+static const int headroom = 3;
+
+static column_position column_at (cube_position p)
+{
+    return column_position(chunk_coord(p.x), chunk_coord(p.z));
+}
+
+template <typename Cells>
+static bool walkable_in (const Cells & cells, cube_position p)
+{
+    return cells(p) == 0 && cells(cube_position(p.x, p.y + 1, p.z)) == 0 && cells(cube_position(p.x, p.y - 1, p.z)) == 1;
+}
+
+// Whether a walker standing in p can step into q; p has to be walkable
+template <typename Cells>
+static bool can_step (const Cells & cells, cube_position p, cube_position q)
+{
+    if (std::abs(q.x - p.x) + std::abs(q.z - p.z) != 1 || q.y - p.y > 1 || q.y - p.y < -2)
+        return false;
+    if (!walkable_in(cells, q))
+        return false;
+
+    // Room to jump up, or to fall past the edge
+    if (q.y > p.y)
+        return cells(cube_position(p.x, p.y + 2, p.z)) == 0;
+    if (q.y < p.y)
+        return cells(cube_position(q.x, p.y, q.z)) == 0 && cells(cube_position(q.x, p.y + 1, q.z)) == 0;
+    return true;
+}
+
+nav_graph::nav_graph ( )
+    : bottom_(0)
+    , height_(0)
+{
+    stats_.columns = 0;
+    stats_.nodes = 0;
+    stats_.edges = 0;
+    stats_.rebuilt_columns = 0;
+    stats_.expanded = 0;
+}
+
+int nav_graph::offset (column_position cp, cube_position p) const
+{
+    int lx = p.x - cp.x * chunk_size, lz = p.z - cp.z * chunk_size, ly = p.y - bottom_;
+    if (lx < 0 || lx >= chunk_size || lz < 0 || lz >= chunk_size || ly < 0 || ly >= height_)
+        return -1;
+    return (lx * chunk_size + lz) * height_ + ly;
+}
+
+const nav_graph::column * nav_graph::column_of (cube_position p) const
+{
+    auto it = columns_.find(column_at(p));
+    return it == columns_.end() ? nullptr : &it->second;
+}
+
+unsigned char nav_graph::cell (cube_position p) const
+{
+    column_position cp = column_at(p);
+    auto it = columns_.find(cp);
+    if (it == columns_.end())
+        return 0;
+
+    int o = offset(cp, p);
+    return o < 0 ? 0 : it->second.cells[o];
+}
+
+bool nav_graph::walkable (cube_position p) const
+{
+    return walkable_in([this](cube_position q){ return cell(q); }, p);
+}
+
+bool nav_graph::fill (const world & w, column_position cp, column & c) const
+{
+    c.cells.assign(chunk_size * chunk_size * height_, 0);
+
+    bool found = false;
+    for (int cy = bottom_ / chunk_size; cy * chunk_size < bottom_ + height_ - headroom; ++cy)
+    {
+        chunk_position p(cp.x, cy, cp.z);
+        auto it = w.chunks().find(p);
+        if (it == w.chunks().end())
+            continue;
+        found = true;
+        if (it->second.count == 0)
+            continue;
+
+        const voxel * voxels = w.cells(p, it->second);
+        for (int x = 0; x < chunk_size; ++x)
+            for (int z = 0; z < chunk_size; ++z)
+            {
+                unsigned char * column_cells = &c.cells[(x * chunk_size + z) * height_ + cy * chunk_size - bottom_];
+                for (int y = 0; y < chunk_size; ++y)
+                {
+                    voxel const & v = voxels[voxel_index(x, y, z)];
+                    column_cells[y] = !v.solid ? 0 : (v.material == material_water ? 2 : 1);
+                }
+            }
+    }
+    return found;
+}
+
+namespace
+{
+    // A pair of cells on either side of the border between two columns
+    struct crossing
+    {
+        cube_position a, b;
+        bool forward, backward;
+        int along;
+    };
+}
+
+void nav_graph::link (column_position cp, column & c) const
+{
+    auto cells = [this](cube_position q){ return cell(q); };
+
+    c.nodes.clear();
+    c.index.clear();
+
+    auto add_node = [&c](cube_position p) -> node &
+    {
+        auto it = c.index.find(p);
+        if (it != c.index.end())
+            return c.nodes[it->second];
+
+        c.index[p] = c.nodes.size();
+        c.nodes.push_back(node());
+        c.nodes.back().cell = p;
+        return c.nodes.back();
+    };
+
+    // Every border is looked at from both of its columns, the same way, so
+    // they agree on the entrances
+    for (int axis = 0; axis < 2; ++axis)
+        for (int side = 0; side < 2; ++side)
+        {
+            // The border between a and the column after it along axis
+            column_position a = side == 0 ? cp : column_position(cp.x - (axis == 0), cp.z - (axis == 1));
+
+            std::vector<crossing> found;
+            for (int t = 0; t < chunk_size; ++t)
+                for (int y = bottom_ + 1; y < bottom_ + height_ - 2; ++y)
+                {
+                    cube_position pa = axis == 0 ? cube_position(a.x * chunk_size + chunk_size - 1, y, a.z * chunk_size + t)
+                                                 : cube_position(a.x * chunk_size + t, y, a.z * chunk_size + chunk_size - 1);
+                    if (!walkable_in(cells, pa))
+                        continue;
+
+                    for (int dy : climbs)
+                    {
+                        cube_position pb(pa.x + (axis == 0), y + dy, pa.z + (axis == 1));
+                        crossing k;
+                        k.a = pa;
+                        k.b = pb;
+                        k.forward = can_step(cells, pa, pb);
+                        k.backward = walkable_in(cells, pb) && can_step(cells, pb, pa);
+                        k.along = t;
+                        if (k.forward || k.backward)
+                            found.push_back(k);
+                    }
+                }
+
+            // Neighbouring crossings of the same kind form one entrance,
+            // which is entered through the middle one
+            std::vector<std::vector<crossing>> entrances;
+            for (crossing const & k : found)
+            {
+                bool joined = false;
+                for (std::vector<crossing> & e : entrances)
+                {
+                    crossing const & last = e.back();
+                    if (last.along == k.along - 1 && std::abs(last.a.y - k.a.y) <= 1 && last.b.y - last.a.y == k.b.y - k.a.y
+                        && last.forward == k.forward && last.backward == k.backward)
+                    {
+                        e.push_back(k);
+                        joined = true;
+                        break;
+                    }
+                }
+                if (!joined)
+                    entrances.push_back(std::vector<crossing>(1, k));
+            }
+
+            for (std::vector<crossing> const & e : entrances)
+            {
+                crossing const & k = e[e.size() / 2];
+                if (side == 0)
+                {
+                    node & n = add_node(k.a);
+                    if (k.forward)
+                        n.links.push_back(k.b);
+                }
+                else
+                {
+                    node & n = add_node(k.b);
+                    if (k.backward)
+                        n.links.push_back(k.a);
+                }
+            }
+        }
+}
+
+void nav_graph::connect (column_position cp, column & c) const
+{
+    for (node & n : c.nodes)
+    {
+        n.edges.clear();
+        search(c, cp, n.cell, false, nullptr);
+        for (std::size_t j = 0; j < c.nodes.size(); ++j)
+        {
+            int d = distance_to(cp, c.nodes[j].cell);
+            if (d > 0)
+                n.edges.push_back(std::make_pair(static_cast<int>(j), d));
+        }
+    }
+}
+
+void nav_graph::search (const column & c, column_position cp, cube_position from, bool backwards, const cube_position * target) const
+{
+    auto cells = [this, &c, cp](cube_position q) -> unsigned char
+    {
+        int o = offset(cp, q);
+        return o < 0 ? 0 : c.cells[o];
+    };
+
+    distance_.assign(c.cells.size(), -1);
+    queue_.clear();
+
+    int start = offset(cp, from);
+    if (start < 0)
+        return;
+    distance_[start] = 0;
+    queue_.push_back(start);
+
+    for (std::size_t head = 0; head < queue_.size(); ++head)
+    {
+        int o = queue_[head];
+        int ly = o % height_, lz = o / height_ % chunk_size, lx = o / height_ / chunk_size;
+        cube_position p(cp.x * chunk_size + lx, bottom_ + ly, cp.z * chunk_size + lz);
+        if (target && p == *target)
+            return;
+
+        for (auto const & s : sides)
+            for (int dy : climbs)
+            {
+                cube_position q(p.x + s[0], p.y + dy, p.z + s[1]);
+                int qo = offset(cp, q);
+                if (qo < 0 || distance_[qo] >= 0)
+                    continue;
+
+                bool ok = backwards ? walkable_in(cells, q) && can_step(cells, q, p) : can_step(cells, p, q);
+                if (!ok)
+                    continue;
+
+                distance_[qo] = distance_[o] + 1;
+                queue_.push_back(qo);
+            }
+    }
+}
+
+int nav_graph::distance_to (column_position cp, cube_position p) const
+{
+    int o = offset(cp, p);
+    return o < 0 ? -1 : distance_[o];
+}
+
+std::size_t nav_graph::update (const world & w)
+{
+    dirty_.clear();
+    if (!changes_.reads(w.journal().get()))
+    {
+        changes_ = journal_reader(w.journal());
+        update_all(w);
+    }
+    else if (changes_.changed_chunks(changed_))
+        update_changed(w);
+    else
+        update_all(w);
+
+    stats_.rebuilt_columns = 0;
+    if (dirty_.empty())
+        return 0;
+
+    if (levels_.empty())
+    {
+        columns_.clear();
+        return 0;
+    }
+
+    int lowest = levels_.begin()->first, highest = levels_.rbegin()->first;
+
+    // All columns span the same heights, so they start over when those change
+    int bottom = lowest * chunk_size, height = (highest - lowest + 1) * chunk_size + headroom;
+    if (bottom != bottom_ || height != height_)
+    {
+        bottom_ = bottom;
+        height_ = height;
+        columns_.clear();
+        for (auto const & c : revisions_)
+            dirty_.insert(column_position(c.first.x, c.first.z));
+    }
+
+    for (column_position cp : dirty_)
+    {
+        if (!fill(w, cp, columns_[cp]))
+            columns_.erase(cp);
+    }
+
+    // Entrances are on the borders, so the neighbours change with them
+    std::unordered_set<column_position, column_position_hash> affected;
+    for (column_position cp : dirty_)
+    {
+        column_position around[5] = {cp, column_position(cp.x + 1, cp.z), column_position(cp.x - 1, cp.z),
+                                     column_position(cp.x, cp.z + 1), column_position(cp.x, cp.z - 1)};
+        for (column_position n : around)
+            if (columns_.count(n))
+                affected.insert(n);
+    }
+
+    for (column_position cp : affected)
+    {
+        column & c = columns_[cp];
+        link(cp, c);
+        connect(cp, c);
+    }
+
+    stats_.rebuilt_columns = affected.size();
+    return affected.size();
+}
+
+void nav_graph::update_all (const world & w)
+{
+    // Both maps are ordered the same way
+    auto r = revisions_.begin();
+    for (auto const & c : w.chunks())
+    {
+        while (r != revisions_.end() && r->first < c.first)
+            r = forget(r);
+
+        if (r != revisions_.end() && r->first == c.first)
+        {
+            if (r->second != c.second.revision)
+            {
+                r->second = c.second.revision;
+                dirty_.insert(column_position(c.first.x, c.first.z));
+            }
+            ++r;
+        }
+        else
+        {
+            r = remember(r, c.first, c.second.revision);
+            ++r;
+        }
+    }
+    while (r != revisions_.end())
+        r = forget(r);
+}
+
+void nav_graph::update_changed (const world & w)
+{
+    for (chunk_position const & cp : changed_)
+    {
+        auto c = w.chunks().find(cp);
+        auto r = revisions_.find(cp);
+        if (c == w.chunks().end())
+        {
+            if (r != revisions_.end())
+                forget(r);
+        }
+        else if (r == revisions_.end())
+            remember(r, cp, c->second.revision);
+        else if (r->second != c->second.revision)
+        {
+            r->second = c->second.revision;
+            dirty_.insert(column_position(cp.x, cp.z));
+        }
+    }
+}
+
+nav_graph::revision_map::iterator nav_graph::remember (revision_map::iterator hint, chunk_position cp, unsigned int revision)
+{
+    dirty_.insert(column_position(cp.x, cp.z));
+    ++levels_[cp.y];
+    return revisions_.insert(hint, std::make_pair(cp, revision));
+}
+
+nav_graph::revision_map::iterator nav_graph::forget (revision_map::iterator r)
+{
+    dirty_.insert(column_position(r->first.x, r->first.z));
+    auto level = levels_.find(r->first.y);
+    if (--level->second == 0)
+        levels_.erase(level);
+    return revisions_.erase(r);
+}
+
+bool nav_graph::find_route (cube_position from, cube_position to, std::vector<cube_position> & route)
+{
+    route.clear();
+    stats_.expanded = 0;
+
+    column_position sp = column_at(from), gp = column_at(to);
+    column const * start = column_of(from);
+    column const * goal = column_of(to);
+    if (!start || !goal || !walkable(from) || !walkable(to))
+        return false;
+
+    if (start == goal)
+    {
+        search(*start, sp, from, false, &to);
+        if (distance_to(sp, to) >= 0)
+        {
+            route.push_back(from);
+            route.push_back(to);
+            return true;
+        }
+    }
+
+    // How far the nodes of the first column are from `from`, and those of
+    // the last one from `to`
+    std::vector<int> start_cost(start->nodes.size()), goal_cost(goal->nodes.size());
+    search(*start, sp, from, false, nullptr);
+    for (std::size_t i = 0; i < start->nodes.size(); ++i)
+        start_cost[i] = distance_to(sp, start->nodes[i].cell);
+    search(*goal, gp, to, true, nullptr);
+    for (std::size_t i = 0; i < goal->nodes.size(); ++i)
+        goal_cost[i] = distance_to(gp, goal->nodes[i].cell);
+
+    struct entry
+    {
+        int f, g;
+        cube_position cell;
+
+        bool operator < (const entry & e) const { return f > e.f; }
+    };
+
+    std::priority_queue<entry> open;
+    std::unordered_map<cube_position, std::pair<int, cube_position>, cube_position_hash> best;
+
+    // Every step is one cell along x or z
+    auto push = [&open, &best, to](cube_position p, int g, cube_position parent)
+    {
+        auto it = best.find(p);
+        if (it != best.end() && it->second.first <= g)
+            return;
+        best[p] = std::make_pair(g, parent);
+
+        entry e;
+        e.g = g;
+        e.f = g + std::abs(p.x - to.x) + std::abs(p.z - to.z);
+        e.cell = p;
+        open.push(e);
+    };
+
+    for (std::size_t i = 0; i < start->nodes.size(); ++i)
+        if (start_cost[i] >= 0)
+            push(start->nodes[i].cell, start_cost[i], from);
+
+    while (!open.empty())
+    {
+        entry e = open.top();
+        open.pop();
+        if (best[e.cell].first < e.g)
+            continue;
+
+        if (e.cell == to)
+        {
+            for (cube_position p = to; ; p = best[p].second)
+            {
+                route.push_back(p);
+                if (p == from)
+                    break;
+            }
+            std::reverse(route.begin(), route.end());
+            return true;
+        }
+
+        ++stats_.expanded;
+        column const * c = column_of(e.cell);
+        auto it = c->index.find(e.cell);
+        if (it == c->index.end())
+            continue;
+
+        node const & n = c->nodes[it->second];
+        for (auto const & edge : n.edges)
+            push(c->nodes[edge.first].cell, e.g + edge.second, e.cell);
+        for (cube_position l : n.links)
+            push(l, e.g + 1, e.cell);
+        if (c == goal && goal_cost[it->second] >= 0)
+            push(to, e.g + goal_cost[it->second], e.cell);
+    }
+    return false;
+}
+
+bool nav_graph::refine (cube_position from, cube_position to, std::vector<cube_position> & steps) const
+{
+    column_position cp = column_at(from);
+    if (!(column_at(to) == cp))
+    {
+        if (!can_step([this](cube_position q){ return cell(q); }, from, to))
+            return false;
+        steps.push_back(to);
+        return true;
+    }
+
+    column const * c = column_of(from);
+    if (!c)
+        return false;
+
+    search(*c, cp, from, false, &to);
+    int d = distance_to(cp, to);
+    if (d < 0)
+        return false;
+
+    auto cells = [this, c, cp](cube_position q) -> unsigned char
+    {
+        int o = offset(cp, q);
+        return o < 0 ? 0 : c->cells[o];
+    };
+
+    // Back from the end, always to a cell one step closer to the start
+    std::size_t first = steps.size();
+    steps.resize(first + d);
+    cube_position q = to;
+    for (int k = d; k > 0; --k)
+    {
+        steps[first + k - 1] = q;
+        bool found = false;
+        for (auto const & s : sides)
+        {
+            for (int dy : climbs)
+            {
+                cube_position p(q.x - s[0], q.y - dy, q.z - s[1]);
+                if (distance_to(cp, p) == k - 1 && can_step(cells, p, q))
+                {
+                    q = p;
+                    found = true;
+                    break;
+                }
+            }
+            if (found)
+                break;
+        }
+    }
+    return true;
+}
+
+nav_graph::statistics nav_graph::stats ( ) const
+{
+    statistics result = stats_;
+    result.columns = columns_.size();
+    result.nodes = 0;
+    result.edges = 0;
+    for (auto const & c : columns_)
+    {
+        result.nodes += c.second.nodes.size();
+        for (node const & n : c.second.nodes)
+            result.edges += n.edges.size() + n.links.size();
+    }
+    return result;
+}
@@ -0,0 +1,138 @@
+#ifndef NAVIGATION_H
+#define NAVIGATION_H
+
+#include "world.h"
+#include "change_journal.h"
+
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <cstddef>
+
+struct cube_position_hash
+{
+    std::size_t operator () (cube_position const & p) const
+    {
+        return static_cast<std::size_t>(p.x) * 73856093u ^ static_cast<std::size_t>(p.y) * 19349663u ^ static_cast<std::size_t>(p.z) * 83492791u;
+    }
+};
+
+// Where walkers can go. A cell is walkable if it and the one above are
+// empty and the one below is solid and not water; from there a walker
+// steps to a horizontal neighbour on the same level, one up or up to two
+// down.
+//
+// Paths are found hierarchically, with a chunk column per cluster. Runs
+// of cells where walkers cross from one column to the next are entrances
+// with a node on either side; the nodes of a column are connected by how
+// far apart they are within it, and the two sides of an entrance by a
+// single step. Only that abstract graph is searched for a route, and the
+// route is refined into steps one column at a time.
+class nav_graph
+{
+public:
+    struct statistics
+    {
+        std::size_t columns;
+        std::size_t nodes;
+        std::size_t edges;
+
+        // By the last update and find_route
+        std::size_t rebuilt_columns;
+        std::size_t expanded;
+    };
+
+    nav_graph ( );
+
+    // Rebuilds the columns with chunks that changed since the last call,
+    // and the entrances of their neighbours; returns how many there were.
+    // The changes come from the world's journal, and only when some were
+    // missed are all chunks compared with what was seen last time.
+    std::size_t update (const world & w);
+
+    bool walkable (cube_position p) const;
+
+    // Walkable cells from `from` to `to`, both included, where consecutive
+    // ones are in the same column or a single step apart
+    bool find_route (cube_position from, cube_position to, std::vector<cube_position> & route);
+
+    // Appends the steps from one cell of a route to the next
+    bool refine (cube_position from, cube_position to, std::vector<cube_position> & steps) const;
+
+    statistics stats ( ) const;
+
+private:
+    struct node
+    {
+        cube_position cell;
+
+        // To other nodes of the column, with the number of steps
+        std::vector<std::pair<int, int>, tracked_allocator<std::pair<int, int>, memory_navigation>> edges;
+
+        // Single steps into a node of the next column
+        std::vector<cube_position, tracked_allocator<cube_position, memory_navigation>> links;
+    };
+
+    struct column
+    {
+        // Along y fastest, then z, then x: 0 for empty, 1 for a cube that
+        // can be stood on, 2 for any other
+        std::vector<unsigned char, tracked_allocator<unsigned char, memory_navigation>> cells;
+
+        std::vector<node, tracked_allocator<node, memory_navigation>> nodes;
+        std::unordered_map<cube_position, int, cube_position_hash> index;
+    };
+
+    typedef std::unordered_map<column_position, column, column_position_hash, std::equal_to<column_position>,
+        tracked_allocator<std::pair<const column_position, column>, memory_navigation>> column_map;
+
+    typedef std::map<chunk_position, unsigned int> revision_map;
+
+    column_map columns_;
+    revision_map revisions_;
+
+    // The number of chunks at each chunk y
+    std::map<int, std::size_t> levels_;
+
+    journal_reader changes_;
+    std::vector<chunk_position> changed_;
+    std::unordered_set<column_position, column_position_hash> dirty_;
+
+    // Cells of every column span the same heights, from the lowest chunk
+    // to a little above the highest
+    int bottom_, height_;
+
+    statistics stats_;
+
+    // Scratch space for searches within a column
+    mutable std::vector<int> distance_;
+    mutable std::vector<int> queue_;
+
+    // Mark the columns of chunks that were added, removed or changed
+    void update_all (const world & w);
+    void update_changed (const world & w);
+    revision_map::iterator remember (revision_map::iterator hint, chunk_position cp, unsigned int revision);
+    revision_map::iterator forget (revision_map::iterator r);
+
+    // Index into the cells of the column, or -1 outside of them
+    int offset (column_position cp, cube_position p) const;
+
+    // False if there are no chunks in the column
+    bool fill (const world & w, column_position cp, column & c) const;
+    void link (column_position cp, column & c) const;
+    void connect (column_position cp, column & c) const;
+
+    // Steps from `from` to every cell of its column that can be reached,
+    // or, backwards, from every cell that can reach it; stops at target
+    // if it is given
+    void search (const column & c, column_position cp, cube_position from, bool backwards, const cube_position * target) const;
+
+    // Of p in the last search, or -1 if it wasn't reached
+    int distance_to (column_position cp, cube_position p) const;
+
+    unsigned char cell (cube_position p) const;
+    const column * column_of (cube_position p) const;
+};
+
+#endif // NAVIGATION_H
@@ -0,0 +1,40 @@
+#include "physics.h"
+#include "region.h"
+
+#include <cmath>
+
+bool collide (player & pl, const world & w)
+{
+    // player::has_collision ignores cubes further than 4 units away
+    const int reach = 4;
+
+    int px = static_cast<int>(std::floor(pl._x + 0.5));
+    int py = static_cast<int>(std::floor(pl._y + 0.5));
+    int pz = static_cast<int>(std::floor(pl._z + 0.5));
+
+    // Water doesn't stop anyone
+    bool on_surface = false;
+    region around = region::box(cube_position(px - reach, py - reach, pz - reach), cube_position(px + reach, py + reach, pz + reach));
+    for_each_in_region(w, around, cube_filter::without(material_water), [&](cube_position c, const voxel &)
+    {
+        on_surface |= pl.collide(c);
+    });
+
+    return on_surface;
+}
+
+void advance (player & pl, double dt, bool enable_gravity)
+{
+    if (enable_gravity)
+        pl.vy -= gravity * dt;
+    pl.move(player_speed * dt);
+    pl.smooth(player_speed * dt);
+}
+
+double standing_height (const world & w, double x, double z, double fallback)
+{
+    int top;
+    if (!w.top(static_cast<int>(std::floor(x + 0.5)), static_cast<int>(std::floor(z + 0.5)), top))
+        return fallback;
+    return top + 0.5 + player::size_y_bottom + 0.1;
+}
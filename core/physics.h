@@ -0,0 +1,21 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include "player.h"
+#include "world.h"
+
+const double gravity = 7;
+const double player_speed = 8;
+
+// Pushes the player out of every cube it intersects; returns whether
+// the player ended up standing on something
+bool collide (player & pl, const world & w);
+
+// Gravity, movement and smoothing for dt seconds, without collision
+void advance (player & pl, double dt, bool enable_gravity);
+
+// Eye height of a player standing on the topmost cube at x, z, or
+// fallback if the column is empty
+double standing_height (const world & w, double x, double z, double fallback);
+
+#endif // PHYSICS_H
@@ -1,6 +1,5 @@
 #include "player.h"
 
-#include <QtOpenGL>
 #include <cmath>
 
 const double player::size_x = 0.4;
@@ -70,7 +69,7 @@ double player::distance (const cube & c) const
     return -1;
 }
 
-bool player::collide (const cube & c)
+bool player::collide (const cube_position & c)
 {
     double tx = _x - c.x;
     double ty = _y - c.y;
@@ -116,20 +115,3 @@ bool player::collide (const cube & c)
 
     return on_surface;
 }
-
-void player::transform ( ) const
-{
-    rotate();
-    translate();
-}
-
-void player::translate ( ) const
-{
-    glTranslated(-_x, -_y, -_z);
-}
-
-void player::rotate ( ) const
-{
-    glRotated(beta * 180.0 / 3.1415926535, 1.0, 0.0, 0.0);
-    glRotated(alpha * 180.0 / 3.1415926535, 0.0, 1.0, 0.0);
-}
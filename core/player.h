@@ -24,14 +24,11 @@ struct player
 
     void fake_move (double step);
     void move (double step);
-    void translate ( ) const;
-    void rotate ( ) const;
-    void transform ( ) const;
     void smooth (double step);
 
     double distance (const cube & c) const;
     bool has_collision (const cube_position & c) const;
-    bool collide (const cube & c);
+    bool collide (const cube_position & c);
 
     void init ( )
     {
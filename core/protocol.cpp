@@ -0,0 +1,154 @@
+#include "protocol.h"
+
+#include <cmath>
+
+void write_header (byte_writer & out, message_type type)
+{
+    out.write_u32(protocol_id);
+    out.write_u8(type);
+}
+
+bool read_header (byte_reader & in, unsigned int & type)
+{
+    std::uint32_t id = in.read_u32();
+    type = in.read_u8();
+    return in.ok() && id == protocol_id;
+}
+
+static std::int32_t quantize_angle (double a)
+{
+    double turns = a / (2.0 * 3.1415926535);
+    turns -= std::floor(turns);
+    return static_cast<std::int32_t>(turns * angle_scale) % angle_scale;
+}
+
+player_state quantize (std::uint32_t id, const player & pl)
+{
+    player_state s;
+    s.id = id;
+    s.x = static_cast<std::int32_t>(std::floor(pl.x * position_scale + 0.5));
+    s.y = static_cast<std::int32_t>(std::floor(pl.y * position_scale + 0.5));
+    s.z = static_cast<std::int32_t>(std::floor(pl.z * position_scale + 0.5));
+    s.alpha = quantize_angle(pl.alpha);
+    s.beta = static_cast<std::int32_t>(std::floor(pl.beta / (2.0 * 3.1415926535) * angle_scale + 0.5));
+    return s;
+}
+
+kubeman dequantize (const player_state & s)
+{
+    return kubeman(s.x / double(position_scale), s.y / double(position_scale), s.z / double(position_scale),
+                   s.alpha * 2.0 * 3.1415926535 / angle_scale, s.id);
+}
+
+bool same_state (const player_state & s1, const player_state & s2)
+{
+    return s1.x == s2.x && s1.y == s2.y && s1.z == s2.z && s1.alpha == s2.alpha && s1.beta == s2.beta;
+}
+
+void write_player_delta (byte_writer & out, const player_state & base, const player_state & s)
+{
+    unsigned int mask = 0;
+    if (s.x != base.x) mask |= 1;
+    if (s.y != base.y) mask |= 2;
+    if (s.z != base.z) mask |= 4;
+    if (s.alpha != base.alpha) mask |= 8;
+    if (s.beta != base.beta) mask |= 16;
+
+    out.write_varint(s.id);
+    out.write_u8(mask);
+    if (mask & 1) out.write_svarint(static_cast<std::int64_t>(s.x) - base.x);
+    if (mask & 2) out.write_svarint(static_cast<std::int64_t>(s.y) - base.y);
+    if (mask & 4) out.write_svarint(static_cast<std::int64_t>(s.z) - base.z);
+    if (mask & 8) out.write_svarint(static_cast<std::int64_t>(s.alpha) - base.alpha);
+    if (mask & 16) out.write_svarint(static_cast<std::int64_t>(s.beta) - base.beta);
+}
+
+void read_player_delta (byte_reader & in, const player_state & base, player_state & s)
+{
+    s = base;
+    unsigned int mask = in.read_u8();
+    if (mask & 1) s.x = base.x + in.read_svarint();
+    if (mask & 2) s.y = base.y + in.read_svarint();
+    if (mask & 4) s.z = base.z + in.read_svarint();
+    if (mask & 8) s.alpha = base.alpha + in.read_svarint();
+    if (mask & 16) s.beta = base.beta + in.read_svarint();
+}
+
+void write_block_change (byte_writer & out, const block_change & c)
+{
+    out.write_u32(c.tick);
+    out.write_svarint(c.position.x);
+    out.write_svarint(c.position.y);
+    out.write_svarint(c.position.z);
+    out.write_u8(c.kind);
+    if (c.kind == change_remove)
+        return;
+
+    if (c.kind == change_paint)
+        out.write_u8(c.plane);
+    out.write_f64(c.hue);
+    out.write_f64(c.brightness);
+    if (c.kind == change_add)
+        out.write_u8(c.material);
+}
+
+void read_block_change (byte_reader & in, block_change & c)
+{
+    c.tick = in.read_u32();
+    c.position.x = in.read_svarint();
+    c.position.y = in.read_svarint();
+    c.position.z = in.read_svarint();
+    c.kind = in.read_u8();
+    c.plane = 0;
+    c.material = material_cube;
+    c.hue = c.brightness = 0.0;
+    if (c.kind == change_remove)
+        return;
+
+    if (c.kind == change_paint)
+        c.plane = in.read_u8() % 6;
+    c.hue = in.read_f64();
+    c.brightness = in.read_f64();
+    if (c.kind == change_add)
+        c.material = in.read_u8() % material_count;
+}
+
+void apply (world & w, const block_change & c)
+{
+    if (c.kind == change_add)
+        w.add_cube(c.position, c.hue, c.brightness, c.material);
+    else if (c.kind == change_remove)
+        w.remove_cube(c.position);
+    else if (c.kind == change_paint)
+        w.paint(c.position, c.plane, c.hue, c.brightness);
+}
+
+void write_input (byte_writer & out, const player_input & input)
+{
+    out.write_u8(input.move_forward + 1);
+    out.write_u8(input.move_sideward + 1);
+    out.write_u8(input.move_upward + 1);
+    out.write_f64(input.alpha);
+    out.write_f64(input.beta);
+    out.write_u8((input.jump ? 1 : 0) | (input.gravity ? 2 : 0));
+}
+
+static int read_direction (byte_reader & in)
+{
+    int d = static_cast<int>(in.read_u8()) - 1;
+    return (d < -1) ? -1 : (d > 1) ? 1 : d;
+}
+
+void read_input (byte_reader & in, player_input & input)
+{
+    input.move_forward = read_direction(in);
+    input.move_sideward = read_direction(in);
+    input.move_upward = read_direction(in);
+    input.alpha = in.read_f64();
+    input.beta = in.read_f64();
+    if (!std::isfinite(input.alpha)) input.alpha = 0.0;
+    if (!std::isfinite(input.beta)) input.beta = 0.0;
+    unsigned int flags = in.read_u8();
+    input.jump = (flags & 1) != 0;
+    input.gravity = (flags & 2) != 0;
+}
@@ -0,0 +1,102 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "world.h"
+#include "player.h"
+#include "kubeman.h"
+#include "byte_stream.h"
+
+#include <cstdint>
+
+// Every datagram starts with protocol_id and a message type.
+//
+// Client -> server: connect, then input every tick; input carries acks for
+// snapshots, block changes and chunk transfers, and the client's pending
+// edits until the server acknowledges them.
+//
+// Server -> client: welcome, chunk fragments until the client has the
+// whole world, and a snapshot every tick. Player states in a snapshot are
+// delta-encoded against the last snapshot the client acknowledged. Block
+// changes are numbered and resent until the client acknowledges them;
+// those that don't fit in the snapshot follow in change messages, so no
+// datagram is larger than max_packet_size.
+
+const std::uint32_t protocol_id = 0x4b554241;
+const std::uint16_t default_port = 4747;
+
+const int tick_rate = 20;
+const std::size_t max_packet_size = 1200;
+const std::size_t chunk_fragment_size = 1024;
+
+// Positions are sent in 1/256 of a cube, angles in 1/65536 of a turn
+const int position_scale = 256;
+const int angle_scale = 65536;
+
+enum message_type
+{
+    message_connect = 1,
+    message_input = 2,
+    message_disconnect = 3,
+
+    message_welcome = 16,
+    message_chunk = 17,
+    message_snapshot = 18,
+    message_changes = 19
+};
+
+void write_header (byte_writer & out, message_type type);
+bool read_header (byte_reader & in, unsigned int & type);
+
+struct player_state
+{
+    std::uint32_t id;
+    std::int32_t x, y, z;
+    std::int32_t alpha, beta;
+};
+
+inline bool operator < (player_state const & s1, player_state const & s2)
+{
+    return s1.id < s2.id;
+}
+
+player_state quantize (std::uint32_t id, const player & pl);
+kubeman dequantize (const player_state & s);
+
+// Only the fields that differ from the base are written
+void write_player_delta (byte_writer & out, const player_state & base, const player_state & s);
+void read_player_delta (byte_reader & in, const player_state & base, player_state & s);
+bool same_state (const player_state & s1, const player_state & s2);
+
+enum block_change_kind
+{
+    change_add = 0,
+    change_remove = 1,
+    change_paint = 2
+};
+
+struct block_change
+{
+    std::uint32_t tick;
+    cube_position position;
+    unsigned int kind;
+    unsigned int plane;
+    unsigned int material;
+    double hue, brightness;
+};
+
+void write_block_change (byte_writer & out, const block_change & c);
+void read_block_change (byte_reader & in, block_change & c);
+void apply (world & w, const block_change & c);
+
+struct player_input
+{
+    int move_forward, move_sideward, move_upward;
+    double alpha, beta;
+    bool jump;
+    bool gravity;
+};
+
+void write_input (byte_writer & out, const player_input & input);
+void read_input (byte_reader & in, player_input & input);
+
+#endif // PROTOCOL_H
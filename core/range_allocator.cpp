@@ -0,0 +1,77 @@
+#include "range_allocator.h"
+
+#include <limits>
+
+const std::size_t range_allocator::none = std::numeric_limits<std::size_t>::max();
+
+range_allocator::range_allocator (std::size_t capacity)
+    : capacity_(0)
+    , used_(0)
+{
+    grow(capacity);
+}
+
+std::size_t range_allocator::allocate (std::size_t size)
+{
+    if (size == 0)
+        return 0;
+
+    for (auto it = free_.begin(); it != free_.end(); ++it)
+    {
+        if (it->second < size)
+            continue;
+
+        std::size_t offset = it->first, left = it->second - size;
+        free_.erase(it);
+        if (left > 0)
+            free_[offset + size] = left;
+        used_ += size;
+        return offset;
+    }
+    return none;
+}
+
+void range_allocator::free (std::size_t offset, std::size_t size)
+{
+    if (size == 0)
+        return;
+
+    used_ -= size;
+    auto next = free_.lower_bound(offset);
+    if (next != free_.end() && next->first == offset + size)
+    {
+        size += next->second;
+        next = free_.erase(next);
+    }
+
+    if (next != free_.begin())
+    {
+        auto previous = next;
+        --previous;
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += size;
+            return;
+        }
+    }
+    free_.insert(next, std::make_pair(offset, size));
+}
+
+void range_allocator::grow (std::size_t capacity)
+{
+    if (capacity <= capacity_)
+        return;
+
+    std::size_t old = capacity_;
+    capacity_ = capacity;
+    used_ += capacity - old;
+    free(old, capacity - old);
+}
+
+void range_allocator::clear ( )
+{
+    free_.clear();
+    used_ = 0;
+    if (capacity_ > 0)
+        free_[0] = capacity_;
+}
@@ -0,0 +1,37 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <map>
+#include <cstddef>
+
+// Hands out ranges of something that is allocated once as a whole, like
+// the vertices of one big GPU buffer. First fit over the free ranges by
+// offset; a freed range merges with the free ranges next to it.
+class range_allocator
+{
+public:
+    static const std::size_t none;
+
+    explicit range_allocator (std::size_t capacity = 0);
+
+    // Offset of a free range of size, or none if there is no such range;
+    // grow and try again then
+    std::size_t allocate (std::size_t size);
+    void free (std::size_t offset, std::size_t size);
+
+    // Adds free space at the end
+    void grow (std::size_t capacity);
+    void clear ( );
+
+    std::size_t capacity ( ) const { return capacity_; }
+    std::size_t used ( ) const { return used_; }
+    std::size_t free_ranges ( ) const { return free_.size(); }
+
+private:
+    // Offset to size
+    std::map<std::size_t, std::size_t> free_;
+    std::size_t capacity_;
+    std::size_t used_;
+};
+
+#endif // RANGE_ALLOCATOR_H
@@ -0,0 +1,350 @@
+#include "raycast.h"
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+bool cast_ray (const world & w, double x, double y, double z, double dx, double dy, double dz, double max_distance, ray_hit & hit)
+{
+    // Cubes are centered on integer positions
+    double origin[3] = {x + 0.5, y + 0.5, z + 0.5};
+    double direction[3] = {dx, dy, dz};
+
+    int cell[3], step[3];
+    double next[3], delta[3];
+    for (int a = 0; a < 3; ++a)
+    {
+        cell[a] = static_cast<int>(std::floor(origin[a]));
+        if (direction[a] > 0.0)
+        {
+            step[a] = 1;
+            delta[a] = 1.0 / direction[a];
+            next[a] = (cell[a] + 1 - origin[a]) * delta[a];
+        }
+        else if (direction[a] < 0.0)
+        {
+            step[a] = -1;
+            delta[a] = -1.0 / direction[a];
+            next[a] = (origin[a] - cell[a]) * delta[a];
+        }
+        else
+        {
+            step[a] = 0;
+            delta[a] = next[a] = std::numeric_limits<double>::infinity();
+        }
+    }
+
+    for (;;)
+    {
+        int a = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+        if (next[a] > max_distance)
+            return false;
+
+        cell[a] += step[a];
+        hit.distance = next[a];
+        next[a] += delta[a];
+
+        cube_position p(cell[0], cell[1], cell[2]);
+        if (w.has_cube(p))
+        {
+            hit.cube = p;
+            // Moving towards +x enters through the -x face
+            hit.plane = 2 * a + (step[a] > 0 ? 1 : 0);
+            return true;
+        }
+    }
+}
+
+// The chunks with cubes, in a dense array over the box they span unless
+// that would be too sparse, so finding the chunk of a cell is an index.
+// The array only lives for one call, on whichever thread makes it, so it
+// comes from that thread's arena.
+class chunk_grid
+{
+public:
+    explicit chunk_grid (const world & w)
+        : empty(true)
+        , w(w)
+        , dense(arena_allocator<const chunk *>(thread_frame_arena()))
+    {
+        for (auto const & cp : w.chunks())
+        {
+            if (cp.second.count == 0)
+                continue;
+
+            int c[3] = {cp.first.x, cp.first.y, cp.first.z};
+            for (int a = 0; a < 3; ++a)
+            {
+                lo[a] = empty ? c[a] : std::min(lo[a], c[a]);
+                hi[a] = empty ? c[a] : std::max(hi[a], c[a]);
+            }
+            empty = false;
+        }
+        if (empty)
+            return;
+
+        std::size_t volume = 1;
+        for (int a = 0; a < 3; ++a)
+        {
+            size[a] = hi[a] - lo[a] + 1;
+            volume *= size[a];
+        }
+        if (volume > 8 * w.chunks().size() + 4096)
+            return;
+
+        dense.assign(volume, nullptr);
+        for (auto const & cp : w.chunks())
+            if (cp.second.count > 0)
+                dense[index(cp.first)] = &cp.second;
+    }
+
+    bool empty;
+
+    // Cells from the first of the lowest chunks to the last of the highest
+    int first_cell (int axis) const { return lo[axis] * chunk_size; }
+    int last_cell (int axis) const { return hi[axis] * chunk_size + chunk_size - 1; }
+
+    // Null if there is no chunk or it has no cubes; cp must be within the
+    // cells above
+    const chunk * at (chunk_position cp) const
+    {
+        if (!dense.empty())
+            return dense[index(cp)];
+
+        auto it = w.chunks().find(cp);
+        return it == w.chunks().end() || it->second.count == 0 ? nullptr : &it->second;
+    }
+
+private:
+    const world & w;
+    int lo[3], hi[3], size[3];
+    arena_vector<const chunk *> dense;
+
+    std::size_t index (chunk_position cp) const
+    {
+        return (std::size_t(cp.x - lo[0]) * size[1] + (cp.y - lo[1])) * size[2] + (cp.z - lo[2]);
+    }
+};
+
+// The stepping state of the rays in flight, one lane each, laid out so
+// that stepping all of them is a handful of vector operations; cells are
+// doubles for the same reason
+struct ray_packet
+{
+    double cell[3][ray_packet_size];
+    double step[3][ray_packet_size];
+    double next[3][ray_packet_size];
+    double delta[3][ray_packet_size];
+
+    // Where each lane entered its cell, and across which axis
+    double entered[ray_packet_size];
+    int axis[ray_packet_size];
+};
+
+// What each lane needs besides stepping
+struct ray_lane
+{
+    bool active;
+    std::size_t ray;
+    double max_distance;
+};
+
+// The same start as in cast_ray
+static void start_lane (ray_packet & p, ray_lane & lane, const ray & r, std::size_t index)
+{
+    double origin[3] = {r.x + 0.5, r.y + 0.5, r.z + 0.5};
+    double direction[3] = {r.dx, r.dy, r.dz};
+
+    for (int a = 0; a < 3; ++a)
+    {
+        double cell = std::floor(origin[a]);
+        p.cell[a][index] = cell;
+        if (direction[a] > 0.0)
+        {
+            p.step[a][index] = 1.0;
+            p.delta[a][index] = 1.0 / direction[a];
+            p.next[a][index] = (cell + 1 - origin[a]) * p.delta[a][index];
+        }
+        else if (direction[a] < 0.0)
+        {
+            p.step[a][index] = -1.0;
+            p.delta[a][index] = -1.0 / direction[a];
+            p.next[a][index] = (origin[a] - cell) * p.delta[a][index];
+        }
+        else
+        {
+            p.step[a][index] = 0.0;
+            p.delta[a][index] = p.next[a][index] = std::numeric_limits<double>::infinity();
+        }
+    }
+
+    lane.active = true;
+    lane.max_distance = r.max_distance;
+}
+
+// Moves every lane into its next cell, across the nearest border; ties go
+// to z, then to y, as in cast_ray
+static void advance (ray_packet & p)
+{
+#if defined(__AVX__)
+    for (int l = 0; l < ray_packet_size; l += 4)
+    {
+        __m256d nx = _mm256_loadu_pd(&p.next[0][l]), ny = _mm256_loadu_pd(&p.next[1][l]), nz = _mm256_loadu_pd(&p.next[2][l]);
+        __m256d x_before_y = _mm256_cmp_pd(nx, ny, _CMP_LT_OQ);
+        __m256d mask[3];
+        mask[0] = _mm256_and_pd(x_before_y, _mm256_cmp_pd(nx, nz, _CMP_LT_OQ));
+        mask[1] = _mm256_andnot_pd(x_before_y, _mm256_cmp_pd(ny, nz, _CMP_LT_OQ));
+        mask[2] = _mm256_andnot_pd(_mm256_or_pd(mask[0], mask[1]), _mm256_cmp_pd(nx, nx, _CMP_TRUE_UQ));
+
+        _mm256_storeu_pd(&p.entered[l], _mm256_blendv_pd(_mm256_blendv_pd(nz, ny, mask[1]), nx, mask[0]));
+        for (int a = 0; a < 3; ++a)
+        {
+            _mm256_storeu_pd(&p.cell[a][l], _mm256_add_pd(_mm256_loadu_pd(&p.cell[a][l]), _mm256_and_pd(mask[a], _mm256_loadu_pd(&p.step[a][l]))));
+            _mm256_storeu_pd(&p.next[a][l], _mm256_add_pd(_mm256_loadu_pd(&p.next[a][l]), _mm256_and_pd(mask[a], _mm256_loadu_pd(&p.delta[a][l]))));
+        }
+
+        int on_y = _mm256_movemask_pd(mask[1]), on_z = _mm256_movemask_pd(mask[2]);
+        for (int k = 0; k < 4; ++k)
+            p.axis[l + k] = ((on_y >> k) & 1) + 2 * ((on_z >> k) & 1);
+    }
+#else
+    for (int l = 0; l < ray_packet_size; ++l)
+    {
+        double nx = p.next[0][l], ny = p.next[1][l], nz = p.next[2][l];
+        int a = nx < ny ? (nx < nz ? 0 : 2) : (ny < nz ? 1 : 2);
+        p.axis[l] = a;
+        p.entered[l] = p.next[a][l];
+        p.cell[a][l] += p.step[a][l];
+        p.next[a][l] += p.delta[a][l];
+    }
+#endif
+}
+
+// Moves a lane in a chunk without cubes to the last cell it crosses there,
+// so that the next advance takes it out. Each axis still adds its delta
+// once per border, leaving the lane exactly as stepping would have.
+static void cross_chunk (ray_packet & p, int l)
+{
+    int left[3];
+    double exit[3];
+    for (int a = 0; a < 3; ++a)
+    {
+        left[a] = 0;
+        exit[a] = std::numeric_limits<double>::infinity();
+        if (p.step[a][l] == 0.0)
+            continue;
+
+        int cell = static_cast<int>(p.cell[a][l]), first = chunk_coord(cell) * chunk_size;
+        left[a] = p.step[a][l] > 0.0 ? first + chunk_size - 1 - cell : cell - first;
+        exit[a] = p.next[a][l];
+        for (int k = 0; k < left[a]; ++k)
+            exit[a] += p.delta[a][l];
+    }
+
+    // The border the lane leaves through; a border crossed at the same
+    // time on a later axis comes first, as in advance
+    int e = exit[0] < exit[1] ? (exit[0] < exit[2] ? 0 : 2) : (exit[1] < exit[2] ? 1 : 2);
+    for (int a = 0; a < 3; ++a)
+        for (int k = 0; k < left[a]; ++k)
+        {
+            double t = p.next[a][l];
+            if (a != e && !(t < exit[e] || (t == exit[e] && a > e)))
+                break;
+            p.cell[a][l] += p.step[a][l];
+            p.next[a][l] += p.delta[a][l];
+        }
+}
+
+std::size_t cast_rays (const world & w, const ray * rays, std::size_t count, ray_hit * hits)
+{
+    for (std::size_t i = 0; i < count; ++i)
+        hits[i].distance = -1.0;
+
+    chunk_grid grid(w);
+    if (grid.empty)
+        return 0;
+
+    ray_packet p;
+    ray_lane lanes[ray_packet_size];
+    std::size_t next_ray = 0, active = 0, found = 0;
+    for (int l = 0; l < ray_packet_size; ++l)
+    {
+        lanes[l].active = false;
+        if (next_ray < count)
+        {
+            lanes[l].ray = next_ray;
+            start_lane(p, lanes[l], rays[next_ray++], l);
+            ++active;
+        }
+    }
+
+    while (active > 0)
+    {
+        advance(p);
+
+        // Lanes in chunks without cubes
+        unsigned int crossing = 0;
+        for (int l = 0; l < ray_packet_size; ++l)
+        {
+            ray_lane & lane = lanes[l];
+            if (!lane.active)
+                continue;
+
+            bool done = p.entered[l] > lane.max_distance, outside = false;
+
+            // Outside the chunks, and over if moving away from them
+            int cell[3];
+            for (int a = 0; a < 3 && !done; ++a)
+            {
+                cell[a] = static_cast<int>(p.cell[a][l]);
+                bool below = cell[a] < grid.first_cell(a), above = cell[a] > grid.last_cell(a);
+                done = (below && p.step[a][l] <= 0.0) || (above && p.step[a][l] >= 0.0);
+                outside = outside || below || above;
+            }
+
+            if (!done)
+            {
+                if (outside)
+                    continue;
+
+                cube_position c(cell[0], cell[1], cell[2]);
+                const chunk * inside = grid.at(chunk_of(c));
+                if (!inside)
+                {
+                    crossing |= 1u << l;
+                    continue;
+                }
+                if (!inside->solid_at(voxel_index(c)))
+                    continue;
+
+                ray_hit & hit = hits[lane.ray];
+                hit.cube = c;
+                hit.plane = 2 * p.axis[l] + (p.step[p.axis[l]][l] > 0.0 ? 1 : 0);
+                hit.distance = p.entered[l];
+                ++found;
+            }
+
+            // The lane takes the next ray, if there is one
+            lane.active = false;
+            --active;
+            if (next_ray < count)
+            {
+                lane.ray = next_ray;
+                start_lane(p, lane, rays[next_ray++], l);
+                ++active;
+            }
+        }
+
+        // Apart from the loop above, which is slower with a call in it
+        for (int l = 0; crossing != 0; ++l, crossing >>= 1)
+            if (crossing & 1)
+                cross_chunk(p, l);
+    }
+    return found;
+}
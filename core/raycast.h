@@ -0,0 +1,39 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include "world.h"
+
+struct ray_hit
+{
+    cube_position cube;
+    // The face the ray entered through, indexed like voxel::hue
+    int plane;
+    double distance;
+};
+
+// Walks the cells along the ray one by one, from the cell of the origin,
+// and stops at the first cube within max_distance. The direction doesn't
+// have to be normalized; distance is in its units.
+bool cast_ray (const world & w, double x, double y, double z, double dx, double dy, double dz, double max_distance, ray_hit & hit);
+
+struct ray
+{
+    double x, y, z;
+    double dx, dy, dz;
+    double max_distance;
+};
+
+// Rays traced side by side by cast_rays
+const int ray_packet_size = 8;
+
+// Answers many queries at once, like line of sight for every walker or
+// sky light for a column of cells, with the same hits as cast_ray. The
+// rays are stepped ray_packet_size at a time, a finished ray making room
+// for the next one. Cells are tested against the solid bits of their
+// chunk, without touching the voxels; chunks without cubes are crossed
+// in one go, and rays that leave the chunks of the world for good stop
+// there. hits[i] answers rays[i], with a negative distance for a miss.
+// Returns the number of hits.
+std::size_t cast_rays (const world & w, const ray * rays, std::size_t count, ray_hit * hits);
+
+#endif // RAYCAST_H
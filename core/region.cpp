@@ -0,0 +1,110 @@
+#include "region.h"
+
+#include <cmath>
+
+region region::box (cube_position a, cube_position b)
+{
+    region r;
+    r.min = cube_position(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+    r.max = cube_position(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+    r.round = false;
+    r.cx = r.cy = r.cz = r.radius = 0.0;
+    return r;
+}
+
+region region::sphere (double x, double y, double z, double radius)
+{
+    region r;
+    r.min = cube_position(std::ceil(x - radius), std::ceil(y - radius), std::ceil(z - radius));
+    r.max = cube_position(std::floor(x + radius), std::floor(y + radius), std::floor(z + radius));
+    r.round = true;
+    r.cx = x;
+    r.cy = y;
+    r.cz = z;
+    r.radius = radius;
+    return r;
+}
+
+bool region::contains (cube_position p) const
+{
+    if (p.x < min.x || p.x > max.x || p.y < min.y || p.y > max.y || p.z < min.z || p.z > max.z)
+        return false;
+    if (!round)
+        return true;
+
+    double dx = p.x - cx, dy = p.y - cy, dz = p.z - cz;
+    return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+static double distance_to (double c, int lo, int hi)
+{
+    return c < lo ? lo - c : (c > hi ? c - hi : 0.0);
+}
+
+bool region::touches (cube_position lo, cube_position hi) const
+{
+    if (hi.x < min.x || lo.x > max.x || hi.y < min.y || lo.y > max.y || hi.z < min.z || lo.z > max.z)
+        return false;
+    if (!round)
+        return true;
+
+    double dx = distance_to(cx, lo.x, hi.x), dy = distance_to(cy, lo.y, hi.y), dz = distance_to(cz, lo.z, hi.z);
+    return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+cube_filter::cube_filter ( )
+    : materials((1u << material_count) - 1)
+    , by_color(false)
+    , plane(-1)
+    , hue(0.0)
+    , brightness(0.0)
+    , tolerance(0.0)
+{ }
+
+cube_filter cube_filter::without (int material)
+{
+    cube_filter f;
+    f.materials &= ~(1u << material);
+    return f;
+}
+
+cube_filter cube_filter::colored (int plane, double hue, double brightness, double tolerance)
+{
+    cube_filter f;
+    f.by_color = true;
+    f.plane = plane;
+    f.hue = hue;
+    f.brightness = brightness;
+    f.tolerance = tolerance;
+    return f;
+}
+
+bool cube_filter::matches (const voxel & v) const
+{
+    if (!((materials >> v.material) & 1))
+        return false;
+    if (!by_color)
+        return true;
+
+    int first = plane < 0 ? 0 : plane, last = plane < 0 ? 5 : plane;
+    for (int p = first; p <= last; ++p)
+        if (std::abs(v.hue[p] - hue) <= tolerance && std::abs(v.brightness[p] - brightness) <= tolerance)
+            return true;
+    return false;
+}
+
+std::size_t count_cubes (const world & w, const region & r, const cube_filter & filter)
+{
+    std::size_t count = 0;
+    for_each_in_region(w, r, filter, [&count](cube_position, const voxel &){ ++count; });
+    return count;
+}
+
+bool find_cube (const world & w, const region & r, const cube_filter & filter, cube_position & result)
+{
+    return !visit_region(w, r, filter, [&result](cube_position p, const voxel &)
+    {
+        result = p;
+        return false;
+    });
+}
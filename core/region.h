@@ -0,0 +1,140 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include "world.h"
+
+#include <algorithm>
+
+// The cells of a box, or the cells whose centres lie in a sphere
+struct region
+{
+    // Bounding box, both corners included
+    cube_position min, max;
+
+    bool round;
+    double cx, cy, cz, radius;
+
+    static region box (cube_position a, cube_position b);
+    static region sphere (double x, double y, double z, double radius);
+
+    bool contains (cube_position p) const;
+
+    // Whether any cell of the box from lo to hi can be inside
+    bool touches (cube_position lo, cube_position hi) const;
+};
+
+// Which cubes a query reports. The colour test looks at one face, or at
+// all of them if plane is -1, and passes if any face is close enough.
+struct cube_filter
+{
+    // A bit per material
+    unsigned int materials;
+
+    bool by_color;
+    int plane;
+    double hue, brightness, tolerance;
+
+    // Passes every cube
+    cube_filter ( );
+
+    static cube_filter without (int material);
+    static cube_filter colored (int plane, double hue, double brightness, double tolerance);
+
+    bool matches (const voxel & v) const;
+};
+
+std::size_t count_cubes (const world & w, const region & r, const cube_filter & filter = cube_filter());
+
+// The first cube in the order of visit_region
+bool find_cube (const world & w, const region & r, const cube_filter & filter, cube_position & result);
+
+// Calls f(cube_position, const voxel &) for the matching cubes until it
+// returns false, chunk by chunk and block by block. Chunks and blocks
+// outside the region or without cubes are skipped before their voxels
+// are looked at, so the cost follows the cubes found rather than the
+// volume. Returns whether the whole region was visited.
+template <typename F>
+bool visit_region (const world & w, const region & r, const cube_filter & filter, F f)
+{
+    chunk_position lo = chunk_of(r.min), hi = chunk_of(r.max);
+
+    auto visit_chunk = [&](chunk_position cp, const chunk & c) -> bool
+    {
+        if (c.occupied == 0)
+            return true;
+
+        int base_x = cp.x * chunk_size, base_y = cp.y * chunk_size, base_z = cp.z * chunk_size;
+        int x0 = std::max(r.min.x - base_x, 0), x1 = std::min(r.max.x - base_x, chunk_size - 1);
+        int y0 = std::max(r.min.y - base_y, 0), y1 = std::min(r.max.y - base_y, chunk_size - 1);
+        int z0 = std::max(r.min.z - base_z, 0), z1 = std::min(r.max.z - base_z, chunk_size - 1);
+
+        const voxel * voxels = nullptr;
+        for (int bx = x0 / block_size; bx <= x1 / block_size; ++bx)
+            for (int by = y0 / block_size; by <= y1 / block_size; ++by)
+                for (int bz = z0 / block_size; bz <= z1 / block_size; ++bz)
+                {
+                    if (!((c.occupied >> block_index(bx, by, bz)) & 1))
+                        continue;
+
+                    int lx0 = std::max(bx * block_size, x0), lx1 = std::min(bx * block_size + block_size - 1, x1);
+                    int ly0 = std::max(by * block_size, y0), ly1 = std::min(by * block_size + block_size - 1, y1);
+                    int lz0 = std::max(bz * block_size, z0), lz1 = std::min(bz * block_size + block_size - 1, z1);
+                    if (!r.touches(cube_position(base_x + lx0, base_y + ly0, base_z + lz0), cube_position(base_x + lx1, base_y + ly1, base_z + lz1)))
+                        continue;
+
+                    if (!voxels)
+                        voxels = w.cells(cp, c);
+
+                    for (int lx = lx0; lx <= lx1; ++lx)
+                        for (int ly = ly0; ly <= ly1; ++ly)
+                            for (int lz = lz0; lz <= lz1; ++lz)
+                            {
+                                voxel const & v = voxels[voxel_index(lx, ly, lz)];
+                                if (!v.solid || !filter.matches(v))
+                                    continue;
+
+                                cube_position p(base_x + lx, base_y + ly, base_z + lz);
+                                if (r.round && !r.contains(p))
+                                    continue;
+                                if (!f(p, v))
+                                    return false;
+                            }
+                }
+        return true;
+    };
+
+    world::chunk_map const & chunks = w.chunks();
+
+    // Walking the whole map is cheaper than looking up every position of
+    // a region much larger than the world
+    double columns = (static_cast<double>(hi.x) - lo.x + 1) * (static_cast<double>(hi.y) - lo.y + 1);
+    if (columns > chunks.size())
+    {
+        for (auto const & c : chunks)
+        {
+            chunk_position cp = c.first;
+            if (cp.x < lo.x || cp.x > hi.x || cp.y < lo.y || cp.y > hi.y || cp.z < lo.z || cp.z > hi.z)
+                continue;
+            if (!visit_chunk(cp, c.second))
+                return false;
+        }
+        return true;
+    }
+
+    // The map is ordered by x, then y, then z, so each row of chunks along z
+    // is one range
+    for (int x = lo.x; x <= hi.x; ++x)
+        for (int y = lo.y; y <= hi.y; ++y)
+            for (auto it = chunks.lower_bound(chunk_position(x, y, lo.z)); it != chunks.end() && it->first.x == x && it->first.y == y && it->first.z <= hi.z; ++it)
+                if (!visit_chunk(it->first, it->second))
+                    return false;
+    return true;
+}
+
+template <typename F>
+void for_each_in_region (const world & w, const region & r, const cube_filter & filter, F f)
+{
+    visit_region(w, r, filter, [&f](cube_position p, const voxel & v){ f(p, v); return true; });
+}
+
+#endif // REGION_H
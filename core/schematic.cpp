@@ -0,0 +1,184 @@
+#include "schematic.h"
+#include "region.h"
+#include "serialize.h"
+
+#include <fstream>
+#include <iterator>
+
+static const std::uint32_t schematic_magic = 0x5342554b; // "KUBS"
+static const std::uint32_t schematic_version = 1;
+
+// Larger schematics are refused when reading
+static const std::size_t max_schematic_volume = 1 << 26;
+
+static voxel empty_voxel ( )
+{
+    voxel v;
+    v.solid = false;
+    v.material = material_cube;
+    for (int p = 0; p < 6; ++p)
+        v.hue[p] = v.brightness[p] = 0.0;
+    return v;
+}
+
+schematic::schematic ( )
+    : size_x(0)
+    , size_y(0)
+    , size_z(0)
+    , palette(1, empty_voxel())
+{ }
+
+std::size_t schematic::bytes ( ) const
+{
+    return palette.capacity() * sizeof(voxel) + cells.capacity() * sizeof(std::uint32_t);
+}
+
+void copy_schematic (const world & w, cube_position a, cube_position b, schematic & result)
+{
+    region r = region::box(a, b);
+    result.size_x = r.max.x - r.min.x + 1;
+    result.size_y = r.max.y - r.min.y + 1;
+    result.size_z = r.max.z - r.min.z + 1;
+    result.palette.assign(1, empty_voxel());
+    result.cells.assign(static_cast<std::size_t>(result.size_x) * result.size_y * result.size_z, 0);
+
+    std::uint32_t last = 0;
+    for_each_in_region(w, r, cube_filter(), [&](cube_position p, const voxel & v)
+    {
+        if (last == 0 || !same_voxel(result.palette[last], v))
+        {
+            last = 1;
+            while (last < result.palette.size() && !same_voxel(result.palette[last], v))
+                ++last;
+            if (last == result.palette.size())
+                result.palette.push_back(v);
+        }
+
+        std::size_t index = (static_cast<std::size_t>(p.x - r.min.x) * result.size_y + (p.y - r.min.y)) * result.size_z + (p.z - r.min.z);
+        result.cells[index] = last;
+    });
+}
+
+schematic rotated (const schematic & s, int turns)
+{
+    turns &= 3;
+    if (turns == 0)
+        return s;
+
+    // One turn takes x to -z and z to x, so +x faces become -z faces,
+    // -z faces -x, -x faces +z and +z faces +x
+    schematic result;
+    result.size_x = s.size_z;
+    result.size_y = s.size_y;
+    result.size_z = s.size_x;
+    result.palette = s.palette;
+    for (voxel & v : result.palette)
+    {
+        static const int from[6] = {4, 5, 2, 3, 1, 0};
+        voxel old = v;
+        for (int p = 0; p < 6; ++p)
+        {
+            v.hue[p] = old.hue[from[p]];
+            v.brightness[p] = old.brightness[from[p]];
+        }
+    }
+
+    result.cells.resize(s.cells.size());
+    for (int x = 0; x < s.size_x; ++x)
+        for (int y = 0; y < s.size_y; ++y)
+            for (int z = 0; z < s.size_z; ++z)
+            {
+                int nx = z, nz = s.size_x - 1 - x;
+                result.cells[(static_cast<std::size_t>(nx) * result.size_y + y) * result.size_z + nz] =
+                    s.cells[(static_cast<std::size_t>(x) * s.size_y + y) * s.size_z + z];
+            }
+
+    return rotated(result, turns - 1);
+}
+
+void stamp (world & w, const schematic & s, cube_position origin)
+{
+    w.write_box(origin, s.size_x, s.size_y, s.size_z, s.palette.data(), s.cells.data());
+}
+
+void write_schematic (byte_writer & out, const schematic & s)
+{
+    out.write_u32(schematic_magic);
+    out.write_u32(schematic_version);
+    out.write_varint(s.size_x);
+    out.write_varint(s.size_y);
+    out.write_varint(s.size_z);
+
+    out.write_varint(s.palette.size());
+    for (voxel const & v : s.palette)
+        write_voxel(out, v);
+
+    for (std::size_t i = 0; i < s.cells.size(); )
+    {
+        std::size_t run = 1;
+        while (i + run < s.cells.size() && s.cells[i + run] == s.cells[i])
+            ++run;
+
+        out.write_varint(s.cells[i]);
+        out.write_varint(run);
+        i += run;
+    }
+}
+
+bool read_schematic (byte_reader & in, schematic & s)
+{
+    if (in.read_u32() != schematic_magic || in.read_u32() != schematic_version)
+        return false;
+
+    std::uint64_t size_x = in.read_varint(), size_y = in.read_varint(), size_z = in.read_varint();
+    if (!in.ok() || size_x == 0 || size_y == 0 || size_z == 0 || size_x * size_y * size_z > max_schematic_volume)
+        return false;
+
+    std::size_t volume = size_x * size_y * size_z;
+    std::size_t palette_size = in.read_varint();
+    if (!in.ok() || palette_size == 0 || palette_size > volume + 1 || palette_size > in.remaining())
+        return false;
+
+    s.size_x = size_x;
+    s.size_y = size_y;
+    s.size_z = size_z;
+    s.palette.resize(palette_size);
+    for (voxel & v : s.palette)
+        read_voxel(in, v);
+
+    s.cells.resize(volume);
+    for (std::size_t i = 0; i < volume; )
+    {
+        std::size_t index = in.read_varint();
+        std::size_t run = in.read_varint();
+        if (!in.ok() || index >= palette_size || run == 0 || run > volume - i)
+            return false;
+
+        std::fill(s.cells.begin() + i, s.cells.begin() + i + run, index);
+        i += run;
+    }
+
+    return in.ok();
+}
+
+bool save_schematic (const schematic & s, const std::string & path)
+{
+    byte_writer out;
+    write_schematic(out, s);
+
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(out.data.data()), out.size());
+    file.close();
+    return !file.fail();
+}
+
+bool load_schematic (const std::string & path, schematic & s)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    std::vector<unsigned char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    byte_reader in(contents.data(), contents.size());
+    return read_schematic(in, s);
+}
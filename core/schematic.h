@@ -0,0 +1,41 @@
+#ifndef SCHEMATIC_H
+#define SCHEMATIC_H
+
+#include "world.h"
+#include "byte_stream.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// A copied box of cells: the distinct voxels, with the empty one first,
+// and the palette index of every cell in the order of world::write_box
+struct schematic
+{
+    int size_x, size_y, size_z;
+    std::vector<voxel> palette;
+    std::vector<std::uint32_t> cells;
+
+    schematic ( );
+
+    std::size_t volume ( ) const { return cells.size(); }
+    std::size_t bytes ( ) const;
+};
+
+// Copies the box between two corners; faces keep their colours
+void copy_schematic (const world & w, cube_position a, cube_position b, schematic & result);
+
+// Quarter turns around the y axis, counterclockwise seen from above
+schematic rotated (const schematic & s, int turns);
+
+// Overwrites the box at origin, empty cells included
+void stamp (world & w, const schematic & s, cube_position origin);
+
+// The same palette and run-length coding as chunks
+void write_schematic (byte_writer & out, const schematic & s);
+bool read_schematic (byte_reader & in, schematic & s);
+
+bool save_schematic (const schematic & s, const std::string & path);
+bool load_schematic (const std::string & path, schematic & s);
+
+#endif // SCHEMATIC_H
@@ -0,0 +1,121 @@
+#include "serialize.h"
+
+bool same_voxel (const voxel & v1, const voxel & v2)
+{
+    if (v1.solid != v2.solid)
+        return false;
+    if (!v1.solid)
+        return true;
+    if (v1.material != v2.material)
+        return false;
+
+    for (int p = 0; p < 6; ++p)
+        if (v1.hue[p] != v2.hue[p] || v1.brightness[p] != v2.brightness[p])
+            return false;
+    return true;
+}
+
+void write_voxel (byte_writer & out, const voxel & v)
+{
+    // 0 for empty, 1 + material otherwise
+    out.write_u8(v.solid ? 1 + v.material : 0);
+    if (!v.solid)
+        return;
+
+    for (int p = 0; p < 6; ++p)
+    {
+        out.write_f64(v.hue[p]);
+        out.write_f64(v.brightness[p]);
+    }
+}
+
+void read_voxel (byte_reader & in, voxel & v)
+{
+    unsigned int kind = in.read_u8();
+    v.solid = kind != 0;
+    v.material = material_cube;
+    if (!v.solid)
+        return;
+
+    if (kind - 1 < material_count)
+        v.material = kind - 1;
+
+    for (int p = 0; p < 6; ++p)
+    {
+        v.hue[p] = in.read_f64();
+        v.brightness[p] = in.read_f64();
+    }
+}
+
+void write_chunk (byte_writer & out, const voxel * voxels)
+{
+    std::vector<voxel> palette;
+    std::vector<unsigned int> indices(chunk_volume);
+
+    unsigned int last = 0;
+    for (int i = 0; i < chunk_volume; ++i)
+    {
+        voxel const & v = voxels[i];
+
+        if (palette.empty() || !same_voxel(palette[last], v))
+        {
+            last = 0;
+            while (last < palette.size() && !same_voxel(palette[last], v))
+                ++last;
+            if (last == palette.size())
+                palette.push_back(v);
+        }
+
+        indices[i] = last;
+    }
+
+    out.write_varint(palette.size());
+    for (voxel const & v : palette)
+        write_voxel(out, v);
+
+    for (int i = 0; i < chunk_volume; )
+    {
+        int run = 1;
+        while (i + run < chunk_volume && indices[i + run] == indices[i])
+            ++run;
+
+        out.write_varint(indices[i]);
+        out.write_varint(run);
+        i += run;
+    }
+}
+
+bool read_chunk (byte_reader & in, chunk & c)
+{
+    std::size_t palette_size = in.read_varint();
+    if (!in.ok() || palette_size == 0 || palette_size > chunk_volume)
+        return false;
+
+    std::vector<voxel> palette(palette_size);
+    for (voxel & v : palette)
+        read_voxel(in, v);
+
+    if (c.voxels.size() != static_cast<std::size_t>(chunk_volume))
+        c.voxels = voxel_array(chunk_volume);
+    c.packed.reset();
+    c.hashed_revision = 0;
+    voxel * voxels = c.voxels.edit();
+
+    c.count = 0;
+    for (int i = 0; i < chunk_volume; )
+    {
+        std::size_t index = in.read_varint();
+        std::size_t run = in.read_varint();
+        if (!in.ok() || index >= palette_size || run == 0 || run > static_cast<std::size_t>(chunk_volume - i))
+            return false;
+
+        for (std::size_t r = 0; r < run; ++r, ++i)
+            voxels[i] = palette[index];
+
+        if (palette[index].solid)
+            c.count += run;
+    }
+
+    c.count_blocks();
+    return in.ok();
+}
@@ -0,0 +1,18 @@
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include "world.h"
+#include "byte_stream.h"
+
+// A chunk is written as a palette of its distinct voxels followed by
+// run-length encoded palette indices in voxel_index order
+
+void write_voxel (byte_writer & out, const voxel & v);
+void read_voxel (byte_reader & in, voxel & v);
+
+void write_chunk (byte_writer & out, const voxel * voxels);
+bool read_chunk (byte_reader & in, chunk & c);
+
+bool same_voxel (const voxel & v1, const voxel & v2);
+
+#endif // SERIALIZE_H
@@ -0,0 +1,649 @@
+#include "server.h"
+#include "physics.h"
+#include "serialize.h"
+
+#include <algorithm>
+#include <cmath>
+
+const int server::frame_history;
+const int server::change_history;
+const int server::timeout_ticks;
+const int server::resend_ticks;
+const std::size_t server::chunk_window;
+const std::size_t server::max_edits_per_tick;
+const std::size_t server::max_change_packets;
+
+const double jump_speed = 1.5;
+const double edit_reach = 10.0;
+
+server::server (transport & t, world & w)
+    : spawn_x(0.0), spawn_y(0.0), spawn_z(0.0)
+    , relevance_radius(128.0)
+    , chunk_bytes_per_tick(16384)
+    , net(t)
+    , w(w)
+    , cells(w, pool)
+    , tick_(0)
+    , next_id(1)
+    , changes_base(0)
+{
+    stats_.clients = 0;
+    stats_.bytes_sent = 0;
+    stats_.bytes_received = 0;
+    stats_.snapshot_bytes = 0;
+    stats_.chunk_bytes = 0;
+    stats_.cell_moves = 0;
+}
+
+void server::tick ( )
+{
+    ++tick_;
+
+    std::size_t sent = net.bytes_sent;
+    std::size_t received = net.bytes_received;
+    stats_.snapshot_bytes = 0;
+    stats_.chunk_bytes = 0;
+
+    receive();
+
+    for (auto it = clients.begin(); it != clients.end(); )
+    {
+        if (tick_ - it->second.last_heard > static_cast<std::uint32_t>(timeout_ticks))
+            it = drop_client(it);
+        else
+            ++it;
+    }
+
+    simulate();
+
+    cells.tick();
+    replicate_moves();
+
+    while (!changes.empty() && changes.front().tick + change_history <= tick_)
+    {
+        changes.pop_front();
+        ++changes_base;
+    }
+
+    for (auto & c : clients)
+    {
+        send_snapshot(c.second);
+        send_chunks(c.second);
+    }
+
+    stats_.clients = clients.size();
+    stats_.bytes_sent = net.bytes_sent - sent;
+    stats_.bytes_received = net.bytes_received - received;
+}
+
+void server::receive ( )
+{
+    net_address from;
+    while (net.receive(from, packet))
+    {
+        byte_reader in(packet.data(), packet.size());
+        unsigned int type;
+        if (!read_header(in, type))
+            continue;
+
+        if (type == message_connect)
+        {
+            handle_connect(from);
+            continue;
+        }
+
+        auto it = clients.find(from);
+        if (it == clients.end())
+            continue;
+
+        it->second.last_heard = tick_;
+
+        if (type == message_input)
+            handle_input(it->second, in);
+        else if (type == message_disconnect)
+            drop_client(it);
+    }
+}
+
+void server::handle_connect (const net_address & from)
+{
+    auto it = clients.find(from);
+    if (it != clients.end())
+    {
+        // The welcome was lost
+        it->second.last_heard = tick_;
+        send_welcome(it->second);
+        return;
+    }
+
+    client_slot & c = clients[from];
+    c.address = from;
+    c.id = next_id++;
+
+    c.pl.x = spawn_x;
+    c.pl.y = spawn_y;
+    c.pl.z = spawn_z;
+    c.pl.init();
+    c.body = players.add(c.pl);
+
+    c.input.move_forward = c.input.move_sideward = c.input.move_upward = 0;
+    c.input.alpha = c.input.beta = 0.0;
+    c.input.jump = false;
+    c.input.gravity = true;
+    c.jump = false;
+    c.on_surface = false;
+
+    c.last_heard = tick_;
+    c.input_sequence = 0;
+    c.acked_tick = 0;
+    c.changes_acked = changes_end();
+    c.changes_reset = true;
+    c.edits_applied = 0;
+
+    c.frames.resize(frame_history);
+    for (sent_frame & f : c.frames)
+        f.tick = 0;
+
+    c.next_transfer = 1;
+    queue_all_chunks(c);
+
+    send_welcome(c);
+}
+
+void server::queue_all_chunks (client_slot & c)
+{
+    std::vector<std::pair<double, chunk_position>> order;
+    order.reserve(w.chunks().size());
+
+    auto sqr = [](double x){ return x * x; };
+    for (auto const & ch : w.chunks())
+    {
+        double d = sqr((ch.first.x + 0.5) * chunk_size - c.pl.x)
+            + sqr((ch.first.y + 0.5) * chunk_size - c.pl.y)
+            + sqr((ch.first.z + 0.5) * chunk_size - c.pl.z);
+        order.push_back(std::make_pair(d, ch.first));
+    }
+
+    // Nearest first, so the client can start playing before the rest arrives
+    std::sort(order.begin(), order.end(), [](std::pair<double, chunk_position> const & a, std::pair<double, chunk_position> const & b){
+        return a.first < b.first;
+    });
+
+    c.transfers.clear();
+    c.chunk_queue.clear();
+    for (auto const & o : order)
+        c.chunk_queue.push_back(o.second);
+}
+
+void server::send_welcome (const client_slot & c)
+{
+    out.data.clear();
+    write_header(out, message_welcome);
+    out.write_varint(c.id);
+    out.write_varint(tick_rate);
+    out.write_varint(w.chunks().size());
+
+    player_state spawn = quantize(c.id, c.pl);
+    out.write_svarint(spawn.x);
+    out.write_svarint(spawn.y);
+    out.write_svarint(spawn.z);
+    send(c.address, out);
+}
+
+void server::handle_input (client_slot & c, byte_reader & in)
+{
+    std::uint32_t sequence = in.read_u32();
+    std::uint32_t acked_tick = in.read_u32();
+    std::uint32_t changes_acked = in.read_u32();
+
+    player_input input;
+    read_input(in, input);
+
+    std::size_t chunk_acks = in.read_varint();
+    for (std::size_t i = 0; i < chunk_acks && in.ok(); ++i)
+    {
+        std::uint32_t index = in.read_varint();
+        for (std::size_t t = 0; t < c.transfers.size(); ++t)
+            if (c.transfers[t].index == index)
+            {
+                c.transfers.erase(c.transfers.begin() + t);
+                break;
+            }
+    }
+
+    std::uint32_t edit_base = in.read_varint();
+    std::size_t edit_count = std::min<std::size_t>(in.read_varint(), max_edits_per_tick);
+    for (std::size_t i = 0; i < edit_count && in.ok(); ++i)
+    {
+        block_change edit;
+        read_block_change(in, edit);
+        if (in.ok() && edit_base + i == c.edits_applied)
+        {
+            // A rejected edit still counts as processed
+            apply_edit(c, edit);
+            ++c.edits_applied;
+        }
+    }
+
+    if (!in.ok())
+        return;
+
+    // Inputs may arrive out of order; only the newest one counts
+    if (sequence > c.input_sequence)
+    {
+        c.input_sequence = sequence;
+        c.input = input;
+        c.jump |= input.jump;
+    }
+
+    if (acked_tick > c.acked_tick && acked_tick <= tick_)
+        c.acked_tick = acked_tick;
+
+    if (changes_acked <= changes_end())
+    {
+        if (c.changes_reset)
+        {
+            if (changes_acked >= c.changes_acked)
+            {
+                c.changes_reset = false;
+                c.changes_acked = changes_acked;
+            }
+        }
+        else if (changes_acked > c.changes_acked)
+            c.changes_acked = changes_acked;
+    }
+}
+
+std::map<net_address, server::client_slot>::iterator server::drop_client (std::map<net_address, client_slot>::iterator it)
+{
+    // The last body takes the place of the dropped one
+    std::size_t last = players.size() - 1;
+    for (auto & other : clients)
+        if (other.second.body == last)
+            other.second.body = it->second.body;
+    players.remove(it->second.body);
+
+    return clients.erase(it);
+}
+
+bool server::apply_edit (client_slot & c, const block_change & edit)
+{
+    auto sqr = [](double x){ return x * x; };
+    bool valid = sqr(edit.position.x - c.pl.x) + sqr(edit.position.y - c.pl.y) + sqr(edit.position.z - c.pl.z) <= sqr(edit_reach);
+
+    if (edit.kind == change_add)
+    {
+        valid = valid && !w.has_cube(edit.position);
+        for (auto const & other : clients)
+            valid = valid && !other.second.pl.has_collision(edit.position);
+    }
+    else if (edit.kind == change_remove || edit.kind == change_paint)
+        valid = valid && w.has_cube(edit.position);
+    else
+        valid = false;
+
+    if (!valid)
+    {
+        // The client has already applied the edit locally
+        correct(edit.position);
+        return false;
+    }
+
+    block_change change = edit;
+    change.tick = tick_;
+    apply(w, change);
+    changes.push_back(change);
+    cells.activate_around(change.position);
+    return true;
+}
+
+void server::replicate_moves ( )
+{
+    stats_.cell_moves = cells.moves().size();
+
+    moved.clear();
+    for (simulation::move const & m : cells.moves())
+    {
+        moved.push_back(m.from);
+        moved.push_back(m.to);
+    }
+
+    // Sending the final state of each cell keeps the changes idempotent,
+    // which swaps would not be
+    std::sort(moved.begin(), moved.end());
+    moved.erase(std::unique(moved.begin(), moved.end(), [](cube_position const & a, cube_position const & b)
+    {
+        return !(a < b) && !(b < a);
+    }), moved.end());
+
+    for (cube_position const & p : moved)
+        correct(p);
+}
+
+void server::correct (cube_position p)
+{
+    block_change change;
+    change.tick = tick_;
+    change.position = p;
+    change.plane = 0;
+    change.material = material_cube;
+
+    voxel const * v = w.find(p);
+    if (!v)
+    {
+        change.kind = change_remove;
+        change.hue = change.brightness = 0.0;
+        changes.push_back(change);
+        return;
+    }
+
+    change.kind = change_add;
+    change.material = v->material;
+    change.hue = v->hue[0];
+    change.brightness = v->brightness[0];
+    changes.push_back(change);
+
+    change.kind = change_paint;
+    for (int plane = 1; plane < 6; ++plane)
+    {
+        if (v->hue[plane] == v->hue[0] && v->brightness[plane] == v->brightness[0])
+            continue;
+
+        change.plane = plane;
+        change.hue = v->hue[plane];
+        change.brightness = v->brightness[plane];
+        changes.push_back(change);
+    }
+}
+
+void server::simulate ( )
+{
+    const double dt = 1.0 / tick_rate;
+
+    states.clear();
+    for (auto & cs : clients)
+    {
+        client_slot & c = cs.second;
+
+        c.pl.move_forward = c.input.move_forward;
+        c.pl.move_sideward = c.input.move_sideward;
+        c.pl.alpha = c.input.alpha;
+        c.pl.beta = c.input.beta;
+
+        if (c.input.gravity)
+        {
+            c.pl.move_upward = 0;
+            if (c.jump && c.on_surface)
+            {
+                c.pl.y += 0.5;
+                c.pl.vy = jump_speed;
+                players.set_position(c.body, c.pl);
+            }
+        }
+        else
+        {
+            c.pl.move_upward = c.input.move_upward;
+            c.pl.vy = 0.0;
+            players.set_vy(c.body, 0.0);
+        }
+        c.jump = false;
+
+        players.steer(c.body, c.pl.move_forward, c.pl.move_sideward, c.pl.move_upward, c.pl.alpha, c.input.gravity);
+    }
+
+    players.step(w, pool, dt);
+
+    for (auto & cs : clients)
+    {
+        client_slot & c = cs.second;
+        players.get(c.body, c.pl);
+        c.on_surface = players.on_surface(c.body);
+
+        states.push_back(quantize(c.id, c.pl));
+    }
+
+    std::sort(states.begin(), states.end());
+}
+
+void server::send_snapshot (client_slot & c)
+{
+    static const std::vector<player_state> empty;
+
+    sent_frame const & base_frame = c.frames[c.acked_tick % frame_history];
+    bool has_base = c.acked_tick != 0 && base_frame.tick == c.acked_tick
+        && tick_ - c.acked_tick < static_cast<std::uint32_t>(frame_history);
+    std::vector<player_state> const & base = has_base ? base_frame.players : empty;
+
+    sent_frame & frame = c.frames[tick_ % frame_history];
+    frame.tick = tick_;
+    frame.players.clear();
+
+    auto find_base = [&base](std::uint32_t id) -> const player_state *
+    {
+        player_state key;
+        key.id = id;
+        auto it = std::lower_bound(base.begin(), base.end(), key);
+        return (it != base.end() && it->id == id) ? &*it : nullptr;
+    };
+
+    double r = relevance_radius * position_scale;
+    player_state self = quantize(c.id, c.pl);
+    auto relevant = [&](player_state const & s)
+    {
+        double dx = s.x - self.x;
+        double dy = s.y - self.y;
+        double dz = s.z - self.z;
+        return s.id == c.id || dx * dx + dy * dy + dz * dz <= r * r;
+    };
+
+    // Players that left or went out of range
+    removed.clear();
+    {
+        auto si = states.begin();
+        for (player_state const & b : base)
+        {
+            while (si != states.end() && si->id < b.id)
+                ++si;
+            if (si == states.end() || si->id != b.id || !relevant(*si))
+                removed.push_back(b.id);
+        }
+    }
+
+    // Start at a different player every tick, so that when the packet is
+    // full it is not always the same players that are left stale
+    entries.data.clear();
+    std::size_t entry_count = 0;
+    std::size_t overhead = 64 + removed.size() * 4;
+    std::size_t budget = (overhead < max_packet_size) ? max_packet_size - overhead : 0;
+    std::size_t n = states.size();
+    std::size_t start = n ? tick_ % n : 0;
+    for (std::size_t k = 0; k < n; ++k)
+    {
+        player_state const & s = states[(start + k) % n];
+        if (!relevant(s))
+            continue;
+
+        const player_state * b = find_base(s.id);
+        if (b && same_state(*b, s))
+        {
+            frame.players.push_back(*b);
+            continue;
+        }
+
+        if (entries.size() + 24 > budget)
+        {
+            if (b)
+                frame.players.push_back(*b);
+            continue;
+        }
+
+        player_state zero;
+        zero.id = s.id;
+        zero.x = zero.y = zero.z = zero.alpha = zero.beta = 0;
+
+        write_player_delta(entries, b ? *b : zero, s);
+        frame.players.push_back(s);
+        ++entry_count;
+    }
+    std::sort(frame.players.begin(), frame.players.end());
+
+    if (!c.changes_reset && c.changes_acked < changes_base)
+    {
+        // The client fell too far behind to catch up through the change
+        // log; send it the whole world again
+        queue_all_chunks(c);
+        c.changes_acked = changes_end();
+        c.changes_reset = true;
+    }
+    std::uint32_t changes_from = std::max(c.changes_acked, changes_base);
+
+    out.data.clear();
+    write_header(out, message_snapshot);
+    out.write_u32(tick_);
+    out.write_u32(has_base ? c.acked_tick : 0);
+    out.write_varint(c.id);
+    out.write_u32(c.input_sequence);
+    out.write_varint(c.edits_applied);
+    out.write_u8(c.changes_reset ? 1 : 0);
+    out.write_u32(changes_from);
+
+    out.write_varint(removed.size());
+    for (std::uint32_t id : removed)
+        out.write_varint(id);
+
+    out.write_varint(entry_count);
+    out.write_bytes(entries.data.data(), entries.size());
+
+    // Block changes fill up the snapshot, and what doesn't fit follows in
+    // change messages
+    std::size_t change_count = write_changes(changes_from, max_packet_size - std::min(out.size() + 4, max_packet_size));
+    out.write_varint(change_count);
+    out.write_bytes(change_data.data.data(), change_data.size());
+    changes_from += change_count;
+
+    stats_.snapshot_bytes += out.size();
+    send(c.address, out);
+
+    for (std::size_t k = 0; k < max_change_packets && changes_from < changes_end(); ++k)
+    {
+        out.data.clear();
+        write_header(out, message_changes);
+        out.write_u32(tick_);
+        out.write_u32(changes_from);
+        change_count = write_changes(changes_from, max_packet_size - out.size() - 4);
+        out.write_varint(change_count);
+        out.write_bytes(change_data.data.data(), change_data.size());
+        changes_from += change_count;
+
+        stats_.snapshot_bytes += out.size();
+        send(c.address, out);
+    }
+}
+
+std::size_t server::write_changes (std::uint32_t from, std::size_t budget)
+{
+    change_data.data.clear();
+    std::size_t count = 0;
+    for (std::size_t i = from - changes_base; i < changes.size(); ++i, ++count)
+    {
+        std::size_t size = change_data.size();
+        write_block_change(change_data, changes[i]);
+        if (change_data.size() > budget)
+        {
+            change_data.data.resize(size);
+            break;
+        }
+    }
+    return count;
+}
+
+void server::send_chunks (client_slot & c)
+{
+    std::size_t budget = chunk_bytes_per_tick;
+
+    for (std::size_t t = 0; t < c.transfers.size() && budget > 0; )
+    {
+        chunk_transfer & transfer = c.transfers[t];
+        if (tick_ - transfer.last_sent < static_cast<std::uint32_t>(resend_ticks))
+        {
+            ++t;
+            continue;
+        }
+
+        if (tick_ - transfer.encode_tick > static_cast<std::uint32_t>(change_history / 2))
+        {
+            // Too old to be patched up by the change log; encode it again
+            c.chunk_queue.push_front(transfer.position);
+            c.transfers.erase(c.transfers.begin() + t);
+            continue;
+        }
+
+        send_transfer(c, transfer);
+        budget -= std::min(budget, transfer.data.size());
+        ++t;
+    }
+
+    while (budget > 0 && c.transfers.size() < chunk_window && !c.chunk_queue.empty())
+    {
+        chunk_position p = c.chunk_queue.front();
+        c.chunk_queue.pop_front();
+
+        auto it = w.chunks().find(p);
+        if (it == w.chunks().end())
+            continue;
+
+        c.transfers.push_back(chunk_transfer());
+        chunk_transfer & transfer = c.transfers.back();
+        transfer.index = c.next_transfer++;
+        transfer.position = p;
+        transfer.encode_tick = tick_;
+
+        auto cached = encoded_chunks.find(p);
+        if (cached == encoded_chunks.end() || cached->second.revision != it->second.revision)
+        {
+            byte_writer data;
+            write_chunk(data, w.cells(p, it->second));
+            encoded_chunk & e = encoded_chunks[p];
+            e.revision = it->second.revision;
+            e.data.swap(data.data);
+            cached = encoded_chunks.find(p);
+        }
+        transfer.data = cached->second.data;
+
+        send_transfer(c, transfer);
+        budget -= std::min(budget, transfer.data.size());
+    }
+}
+
+void server::send_transfer (client_slot & c, chunk_transfer & t)
+{
+    std::size_t fragments = (t.data.size() + chunk_fragment_size - 1) / chunk_fragment_size;
+
+    for (std::size_t f = 0; f < fragments; ++f)
+    {
+        std::size_t begin = f * chunk_fragment_size;
+        std::size_t size = std::min(chunk_fragment_size, t.data.size() - begin);
+
+        out.data.clear();
+        write_header(out, message_chunk);
+        out.write_varint(t.index);
+        out.write_u32(t.encode_tick);
+        out.write_svarint(t.position.x);
+        out.write_svarint(t.position.y);
+        out.write_svarint(t.position.z);
+        out.write_varint(t.data.size());
+        out.write_varint(f);
+        out.write_varint(fragments);
+        out.write_bytes(t.data.data() + begin, size);
+
+        stats_.chunk_bytes += out.size();
+        send(c.address, out);
+    }
+
+    t.last_sent = tick_;
+}
+
+void server::send (const net_address & to, const byte_writer & message)
+{
+    net.send(to, message.data.data(), message.size());
+}
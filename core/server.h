@@ -0,0 +1,167 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "world.h"
+#include "player.h"
+#include "protocol.h"
+#include "transport.h"
+#include "worker_pool.h"
+#include "simulation.h"
+#include "bodies.h"
+
+#include <map>
+#include <deque>
+#include <vector>
+
+// Authoritative game server. Clients only send their input and edit
+// requests; the server simulates every player with the same physics as
+// the game and replicates players and block changes to everybody.
+//
+// Per tick and client the work is one pass over the relevant players and
+// the block changes the client has not acknowledged yet, so the cost grows
+// linearly with the number of clients in range.
+class server
+{
+public:
+    struct statistics
+    {
+        std::size_t clients;
+        std::size_t bytes_sent;
+        std::size_t bytes_received;
+        std::size_t snapshot_bytes;
+        std::size_t chunk_bytes;
+        std::size_t cell_moves;
+    };
+
+    server (transport & t, world & w);
+
+    double spawn_x, spawn_y, spawn_z;
+
+    // Players further away than this are not sent to a client
+    double relevance_radius;
+
+    // Chunk data streamed to a joining client per tick
+    std::size_t chunk_bytes_per_tick;
+
+    // One simulation step of 1 / tick_rate seconds
+    void tick ( );
+
+    std::uint32_t current_tick ( ) const { return tick_; }
+    std::size_t client_count ( ) const { return clients.size(); }
+
+    // Counters for the last tick
+    const statistics & stats ( ) const { return stats_; }
+
+private:
+    static const int frame_history = 32;
+    static const int change_history = 64;
+    static const int timeout_ticks = 5 * tick_rate;
+    static const int resend_ticks = tick_rate / 2;
+    static const std::size_t chunk_window = 16;
+    static const std::size_t max_edits_per_tick = 64;
+    // Change messages sent to one client in a tick, after the snapshot
+    static const std::size_t max_change_packets = 8;
+
+    // What the client was told in one snapshot, the baseline for later deltas
+    struct sent_frame
+    {
+        std::uint32_t tick;
+        std::vector<player_state> players;
+    };
+
+    struct chunk_transfer
+    {
+        std::uint32_t index;
+        chunk_position position;
+        std::uint32_t encode_tick;
+        std::uint32_t last_sent;
+        std::vector<unsigned char> data;
+    };
+
+    struct client_slot
+    {
+        net_address address;
+        std::uint32_t id;
+
+        // pl is the state of body in players after every tick
+        player pl;
+        std::size_t body;
+        player_input input;
+        bool jump;
+        bool on_surface;
+
+        std::uint32_t last_heard;
+        std::uint32_t input_sequence;
+        std::uint32_t acked_tick;
+        // The number of the first block change the client doesn't have
+        std::uint32_t changes_acked;
+        bool changes_reset;
+        std::uint32_t edits_applied;
+
+        std::vector<sent_frame> frames;
+
+        std::deque<chunk_position> chunk_queue;
+        std::uint32_t next_transfer;
+        std::vector<chunk_transfer> transfers;
+    };
+
+    transport & net;
+    world & w;
+
+    // Sand and water; whatever moved is replicated like an edit
+    worker_pool pool;
+    simulation cells;
+    std::vector<cube_position> moved;
+
+    std::uint32_t tick_;
+    std::uint32_t next_id;
+
+    std::map<net_address, client_slot> clients;
+
+    // Block changes of the last change_history ticks, oldest first; they
+    // are numbered in order, from changes_base for the first one here
+    std::deque<block_change> changes;
+    std::uint32_t changes_base;
+
+    std::uint32_t changes_end ( ) const { return changes_base + changes.size(); }
+
+    // The clients' players, stepped together every tick; a body per client
+    bodies players;
+    std::vector<player_state> states;
+
+    // Encoded chunks are shared by all clients that are still loading
+    struct encoded_chunk
+    {
+        unsigned int revision;
+        std::vector<unsigned char> data;
+    };
+    std::map<chunk_position, encoded_chunk> encoded_chunks;
+
+    statistics stats_;
+
+    byte_writer out;
+    byte_writer entries;
+    byte_writer change_data;
+    std::vector<std::uint32_t> removed;
+    std::vector<unsigned char> packet;
+
+    void receive ( );
+    void handle_connect (const net_address & from);
+    void handle_input (client_slot & c, byte_reader & in);
+    std::map<net_address, client_slot>::iterator drop_client (std::map<net_address, client_slot>::iterator it);
+    bool apply_edit (client_slot & c, const block_change & edit);
+    void correct (cube_position p);
+    void simulate ( );
+    void replicate_moves ( );
+    void queue_all_chunks (client_slot & c);
+    void send_welcome (const client_slot & c);
+    void send_snapshot (client_slot & c);
+    // Into change_data, as many changes from the numbered one on as fit
+    // in budget bytes; returns how many
+    std::size_t write_changes (std::uint32_t from, std::size_t budget);
+    void send_chunks (client_slot & c);
+    void send_transfer (client_slot & c, chunk_transfer & t);
+    void send (const net_address & to, const byte_writer & message);
+};
+
+#endif // SERVER_H
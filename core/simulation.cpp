@@ -0,0 +1,268 @@
+#include "simulation.h"
+
+#include <algorithm>
+
+// How far water looks sideways for a place to flow down to
+const int water_reach = 4;
+
+simulation::simulation (world & w, worker_pool & pool)
+    : w(w)
+    , pool(pool)
+    , tick_(0)
+{
+    stats_.active_cells = 0;
+    stats_.active_chunks = 0;
+    stats_.moves = 0;
+    stats_.deferred_moves = 0;
+}
+
+void simulation::activate (cube_position p)
+{
+    voxel const * v = w.find(p);
+    if (!v || !is_dynamic(v->material))
+        return;
+
+    active_chunk & a = active[chunk_of(p)];
+    if (a.queued.empty())
+        a.queued.assign(chunk_volume, false);
+
+    int index = voxel_index(p);
+    if (!a.queued[index])
+    {
+        a.queued[index] = true;
+        a.cells.push_back(index);
+    }
+}
+
+void simulation::activate_around (cube_position p)
+{
+    for (int dx = -water_reach; dx <= water_reach; ++dx)
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dz = -water_reach; dz <= water_reach; ++dz)
+                activate(cube_position(p.x + dx, p.y + dy, p.z + dz));
+}
+
+void simulation::clear ( )
+{
+    active.clear();
+}
+
+void simulation::tick ( )
+{
+    ++tick_;
+    moves_.clear();
+    stats_.active_cells = 0;
+    stats_.moves = 0;
+    stats_.deferred_moves = 0;
+
+    processing.clear();
+    for (auto & a : active)
+    {
+        stats_.active_cells += a.second.cells.size();
+        processing.emplace_back(a.first, std::move(a.second));
+    }
+    active.clear();
+    stats_.active_chunks = processing.size();
+
+    for (std::vector<std::size_t> & phase : phases)
+        phase.clear();
+    for (std::size_t i = 0; i < processing.size(); ++i)
+    {
+        chunk_position const & cp = processing[i].first;
+        phases[(cp.x & 1) | ((cp.y & 1) << 1) | ((cp.z & 1) << 2)].push_back(i);
+    }
+
+    workers.resize(pool.size());
+
+    // Workers read the neighbours of their chunk, and the cache of packed
+    // chunks is not thread-safe
+    for (auto const & entry : processing)
+        for (int dx = -1; dx <= 1; ++dx)
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dz = -1; dz <= 1; ++dz)
+                    w.thaw(chunk_position(entry.first.x + dx, entry.first.y + dy, entry.first.z + dz));
+
+    for (std::vector<std::size_t> const & phase : phases)
+    {
+        if (phase.empty()) continue;
+
+        pool.run(phase.size(), [this, &phase](std::size_t item, unsigned int worker)
+        {
+            process(phase[item], workers[worker]);
+        });
+
+        // Chunk revisions, the heightmap and the active sets are shared,
+        // so they are only touched between phases
+        for (worker_state & s : workers)
+        {
+            for (move const & m : s.local)
+                finish(m);
+            s.local.clear();
+
+            for (move const & m : s.deferred)
+            {
+                voxel const * from = w.find(m.from);
+                voxel const * to = w.find(m.to);
+                if (!from || !is_dynamic(from->material))
+                    continue;
+                if (to && !(from->material == material_sand && to->material == material_water))
+                    continue;
+
+                w.swap_cubes(m.from, m.to);
+                ++stats_.deferred_moves;
+                finish(m);
+            }
+            s.deferred.clear();
+        }
+    }
+}
+
+void simulation::finish (const move & m)
+{
+    w.refresh_top(m.from);
+    w.refresh_top(m.to);
+    w.mark_changed(chunk_of(m.from), *w.find_chunk(chunk_of(m.from)));
+
+    moves_.push_back(m);
+    ++stats_.moves;
+
+    // Whatever rested on or next to the old cell may move now
+    for (int dx = -1; dx <= 1; ++dx)
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dz = -1; dz <= 1; ++dz)
+                activate(cube_position(m.from.x + dx, m.from.y + dy, m.from.z + dz));
+    activate(m.to);
+}
+
+// 0 for an empty cell, 1 + material otherwise
+static int cell (const world & w, const chunk & c, chunk_position cp, cube_position p)
+{
+    chunk_position target = chunk_of(p);
+    chunk const * tc = &c;
+    if (!(target == cp))
+    {
+        // Missing chunks are walls, or the world would drain into the void
+        auto it = w.chunks().find(target);
+        if (it == w.chunks().end())
+            return 1 + material_cube;
+        tc = &it->second;
+    }
+
+    voxel const & v = w.cells(target, *tc)[voxel_index(p)];
+    return v.solid ? 1 + v.material : 0;
+}
+
+bool simulation::find_target (cube_position p, const chunk & c, chunk_position cp, unsigned char material, cube_position & target) const
+{
+    const int empty = 0;
+    const int water = 1 + material_water;
+
+    // Sand sinks through water
+    auto passable = [material, empty, water](int kind){ return kind == empty || (material == material_sand && kind == water); };
+    auto at = [&](int dx, int dy, int dz){ return cell(w, c, cp, cube_position(p.x + dx, p.y + dy, p.z + dz)); };
+
+    if (passable(at(0, -1, 0)))
+    {
+        target = cube_position(p.x, p.y - 1, p.z);
+        return true;
+    }
+
+    // Vary the order so piles don't lean to one side
+    static const int sides[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+    unsigned int rotation = (tick_ + static_cast<unsigned int>(p.x) * 7 + static_cast<unsigned int>(p.z) * 13) & 3;
+
+    for (int k = 0; k < 4; ++k)
+    {
+        int const * d = sides[(k + rotation) & 3];
+        if (at(d[0], 0, d[1]) == empty && passable(at(d[0], -1, d[1])))
+        {
+            target = cube_position(p.x + d[0], p.y - 1, p.z + d[1]);
+            return true;
+        }
+    }
+
+    if (material != material_water)
+        return false;
+
+    // Flow one step towards the nearest drop; every such step gets closer
+    // to a drop or down, so water always comes to rest
+    int best = water_reach + 1;
+    int const * best_side = nullptr;
+    for (int k = 0; k < 4; ++k)
+    {
+        int const * d = sides[(k + rotation) & 3];
+        for (int distance = 1; distance < best; ++distance)
+        {
+            if (at(d[0] * distance, 0, d[1] * distance) != empty)
+                break;
+            if (at(d[0] * distance, -1, d[1] * distance) == empty)
+            {
+                best = distance;
+                best_side = d;
+                break;
+            }
+        }
+    }
+
+    if (!best_side)
+        return false;
+
+    target = cube_position(p.x + best_side[0], p.y, p.z + best_side[1]);
+    return true;
+}
+
+void simulation::process (std::size_t item, worker_state & state)
+{
+    chunk_position cp = processing[item].first;
+    std::vector<unsigned short> & cells = processing[item].second.cells;
+
+    chunk * c = w.find_chunk(cp);
+    if (!c)
+        return;
+
+    // Bottom up, so a falling column moves as a whole
+    auto layer = [](unsigned short index){ return (index / chunk_size) % chunk_size; };
+    std::sort(cells.begin(), cells.end(), [&layer](unsigned short a, unsigned short b)
+    {
+        return layer(a) < layer(b) || (layer(a) == layer(b) && a < b);
+    });
+
+    state.moved.assign(chunk_volume, false);
+    voxel * voxels = nullptr;
+
+    for (unsigned short index : cells)
+    {
+        if (state.moved[index]) continue;
+
+        voxel const & v = c->voxels[index];
+        if (!v.solid || !is_dynamic(v.material)) continue;
+
+        cube_position p(cp.x * chunk_size + index / (chunk_size * chunk_size),
+                        cp.y * chunk_size + layer(index),
+                        cp.z * chunk_size + index % chunk_size);
+
+        move m;
+        m.from = p;
+        if (!find_target(p, *c, cp, v.material, m.to))
+            continue;
+
+        if (chunk_of(m.to) == cp)
+        {
+            // A snapshot may still share the voxels
+            if (!voxels)
+                voxels = c->voxels.edit();
+
+            int target = voxel_index(m.to);
+            if (!voxels[target].solid)
+            {
+                c->cell_emptied(index);
+                c->cell_filled(target);
+            }
+            std::swap(voxels[index], voxels[target]);
+            state.moved[target] = true;
+            state.local.push_back(m);
+        }
+        else
+            state.deferred.push_back(m);
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "world.h"
+#include "worker_pool.h"
+
+#include <map>
+#include <vector>
+
+// Cellular automaton for sand and water. Only active cells are looked at:
+// a cell becomes active when something next to it changes, and goes back
+// to sleep once it cannot move.
+//
+// A tick processes the active chunks in 8 phases by the parity of their
+// coordinates, so the chunks of one phase are never neighbours and can be
+// processed in parallel. Moves inside a chunk are applied right away,
+// moves into another chunk are deferred to the end of the phase.
+class simulation
+{
+public:
+    struct statistics
+    {
+        std::size_t active_cells;
+        std::size_t active_chunks;
+        std::size_t moves;
+        std::size_t deferred_moves;
+    };
+
+    // The contents of two cells were exchanged
+    struct move
+    {
+        cube_position from, to;
+    };
+
+    simulation (world & w, worker_pool & pool);
+
+    // Call after every edit that did not come from the simulation itself
+    void activate (cube_position p);
+    void activate_around (cube_position p);
+
+    void tick ( );
+
+    // Forgets all active cells, e.g. after the world was replaced
+    void clear ( );
+
+    // Everything that moved during the last tick, in order
+    const std::vector<move> & moves ( ) const { return moves_; }
+
+    bool idle ( ) const { return active.empty(); }
+
+    // Counters for the last tick
+    const statistics & stats ( ) const { return stats_; }
+
+private:
+    struct active_chunk
+    {
+        std::vector<unsigned short> cells;
+        std::vector<bool> queued;
+    };
+
+    struct worker_state
+    {
+        std::vector<move> local;
+        std::vector<move> deferred;
+        std::vector<bool> moved;
+    };
+
+    world & w;
+    worker_pool & pool;
+
+    unsigned int tick_;
+
+    std::map<chunk_position, active_chunk> active;
+    std::vector<std::pair<chunk_position, active_chunk>> processing;
+    std::vector<std::size_t> phases[8];
+    std::vector<worker_state> workers;
+
+    std::vector<move> moves_;
+    statistics stats_;
+
+    void process (std::size_t item, worker_state & state);
+    bool find_target (cube_position p, const chunk & c, chunk_position cp, unsigned char material, cube_position & target) const;
+    void finish (const move & m);
+};
+
+#endif // SIMULATION_H
@@ -0,0 +1,55 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed-size ring buffer for one producer and one consumer thread, without
+// locks. It holds up to capacity - 1 items; push fails when it is full.
+template <typename T, std::size_t capacity>
+class spsc_queue
+{
+public:
+    spsc_queue ( )
+        : head(0)
+        , tail(0)
+    { }
+
+    spsc_queue (const spsc_queue &) = delete;
+    spsc_queue & operator = (const spsc_queue &) = delete;
+
+    bool push (const T & item)
+    {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        std::size_t next = (t + 1) % capacity;
+        if (next == head.load(std::memory_order_acquire))
+            return false;
+
+        items[t] = item;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop (T & item)
+    {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+
+        item = items[h];
+        head.store((h + 1) % capacity, std::memory_order_release);
+        return true;
+    }
+
+    bool empty ( ) const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T items[capacity];
+    std::atomic<std::size_t> head;
+    std::atomic<std::size_t> tail;
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,96 @@
+#include "textures.h"
+#include "world.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Same noise for the same texel whichever thread draws it
+static unsigned int noise (int x, int y, int layer)
+{
+    std::uint32_t h = static_cast<std::uint32_t>(x) * 374761393u + static_cast<std::uint32_t>(y) * 668265263u + static_cast<std::uint32_t>(layer) * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return (h ^ (h >> 16)) & 255;
+}
+
+static void draw_texel (int layer, int size, int x, int y, unsigned char * texel)
+{
+    const double pi = 3.14159265358979323846;
+
+    unsigned int n = noise(x, y, layer);
+    unsigned int value = 255, alpha = 255;
+
+    switch (layer)
+    {
+    case material_sand:
+        // Fine grain with a few dark specks
+        value = n < 24 ? 140 : 176 + n * 79 / 255;
+        break;
+    case material_water:
+    {
+        // Ripples that wrap around at the edges
+        double wave = std::sin(2.0 * pi * (2.0 * y / size + 0.25 * std::sin(2.0 * pi * x / size)));
+        value = static_cast<unsigned int>(220.0 + 30.0 * wave) + n % 6;
+        break;
+    }
+    case material_glass:
+    {
+        // A frame, with the pane between seen through even more
+        int edge = std::min(std::min(x, size - 1 - x), std::min(y, size - 1 - y));
+        bool frame = edge < size / 16 + 1;
+        bool streak = !frame && (x + y) % (size / 2) < size / 16;
+        value = frame ? 200 : (streak ? 255 : 235);
+        alpha = frame ? 255 : (streak ? 200 : 140);
+        break;
+    }
+    default:
+        value = 192 + n * 63 / 255;
+        break;
+    }
+
+    texel[0] = texel[1] = texel[2] = value;
+    texel[3] = alpha;
+}
+
+static void generate_layer (int layer, texture_array & result)
+{
+    int size = result.size;
+    unsigned char * base = result.levels[0].data() + 4 * size * size * layer;
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+            draw_texel(layer, size, x, y, base + 4 * (y * size + x));
+
+    // Every level averages 2x2 texels of the one above it
+    for (std::size_t l = 1; l < result.levels.size(); ++l)
+    {
+        int from_size = result.level_size(l - 1), to_size = result.level_size(l);
+        unsigned char const * from = result.levels[l - 1].data() + 4 * from_size * from_size * layer;
+        unsigned char * to = result.levels[l].data() + 4 * to_size * to_size * layer;
+
+        for (int y = 0; y < to_size; ++y)
+            for (int x = 0; x < to_size; ++x)
+                for (int c = 0; c < 4; ++c)
+                {
+                    unsigned int sum = from[4 * ((2 * y) * from_size + 2 * x) + c]
+                        + from[4 * ((2 * y) * from_size + 2 * x + 1) + c]
+                        + from[4 * ((2 * y + 1) * from_size + 2 * x) + c]
+                        + from[4 * ((2 * y + 1) * from_size + 2 * x + 1) + c];
+                    to[4 * (y * to_size + x) + c] = (sum + 2) / 4;
+                }
+    }
+}
+
+void generate_material_textures (worker_pool & pool, int size, texture_array & result)
+{
+    result.size = size;
+    result.layers = material_count;
+    result.levels.clear();
+    for (int s = size; s > 0; s /= 2)
+        result.levels.push_back(std::vector<unsigned char>(4 * s * s * result.layers));
+
+    // Layers don't overlap in any level, so the workers share nothing
+    pool.run(result.layers, [&result](std::size_t layer, unsigned int)
+    {
+        generate_layer(layer, result);
+    });
+}
@@ -0,0 +1,25 @@
+#ifndef TEXTURES_H
+#define TEXTURES_H
+
+#include "worker_pool.h"
+
+#include <vector>
+
+// One square RGBA layer per material, with every mip level down to 1x1:
+// levels[l] holds all layers of size >> l texels each, layer after layer,
+// rows of texels along x. The colour of a face is multiplied in, so the
+// layers are mostly shades of grey.
+struct texture_array
+{
+    int size;
+    int layers;
+    std::vector<std::vector<unsigned char>> levels;
+
+    int level_size (int level) const { return size >> level; }
+};
+
+// Size has to be a power of two. Every layer is drawn and filtered down by
+// a worker of its own, and the result doesn't depend on how many there are.
+void generate_material_textures (worker_pool & pool, int size, texture_array & result);
+
+#endif // TEXTURES_H
@@ -0,0 +1,176 @@
+#include "transport.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <cstdlib>
+#include <sstream>
+
+bool parse_address (const std::string & text, std::uint16_t default_port, net_address & result)
+{
+    std::string host = text;
+    std::uint16_t port = default_port;
+
+    std::size_t colon = text.rfind(':');
+    if (colon != std::string::npos)
+    {
+        host = text.substr(0, colon);
+        int p = std::atoi(text.c_str() + colon + 1);
+        if (p <= 0 || p > 65535)
+            return false;
+        port = p;
+    }
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo * info = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &info) != 0 || !info)
+        return false;
+
+    result.host = ntohl(reinterpret_cast<sockaddr_in *>(info->ai_addr)->sin_addr.s_addr);
+    result.port = port;
+    freeaddrinfo(info);
+    return true;
+}
+
+std::string to_string (const net_address & a)
+{
+    std::ostringstream oss;
+    oss << (a.host >> 24) << '.' << ((a.host >> 16) & 0xff) << '.' << ((a.host >> 8) & 0xff) << '.' << (a.host & 0xff) << ':' << a.port;
+    return oss.str();
+}
+
+loopback_network::loopback_network ( )
+    : loss(0.0)
+    , next_port(1)
+    , random_state(12345)
+{ }
+
+net_address loopback_network::add_endpoint ( )
+{
+    net_address a(0x7f000001, next_port++);
+    queues[a];
+    return a;
+}
+
+void loopback_network::post (const net_address & from, const net_address & to, const unsigned char * data, std::size_t size)
+{
+    random_state = random_state * 1103515245 + 12345;
+    if ((random_state >> 16) % 10000 < loss * 10000)
+        return;
+
+    auto it = queues.find(to);
+    if (it == queues.end())
+        return;
+
+    it->second.push_back(datagram());
+    it->second.back().from = from;
+    it->second.back().data.assign(data, data + size);
+}
+
+bool loopback_network::fetch (const net_address & at, datagram & result)
+{
+    std::deque<datagram> & queue = queues[at];
+    if (queue.empty())
+        return false;
+
+    result.from = queue.front().from;
+    result.data.swap(queue.front().data);
+    queue.pop_front();
+    return true;
+}
+
+loopback_transport::loopback_transport (loopback_network & network)
+    : network(network)
+    , address_(network.add_endpoint())
+{ }
+
+bool loopback_transport::send (const net_address & to, const unsigned char * data, std::size_t size)
+{
+    network.post(address_, to, data, size);
+    bytes_sent += size;
+    return true;
+}
+
+bool loopback_transport::receive (net_address & from, std::vector<unsigned char> & data)
+{
+    if (!network.fetch(address_, incoming))
+        return false;
+
+    from = incoming.from;
+    data.swap(incoming.data);
+    bytes_received += data.size();
+    return true;
+}
+
+udp_transport::udp_transport (std::uint16_t port)
+    : socket_fd(::socket(AF_INET, SOCK_DGRAM, 0))
+{
+    if (socket_fd < 0)
+        return;
+
+    sockaddr_in local;
+    std::memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+
+    if (::bind(socket_fd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0
+        || ::fcntl(socket_fd, F_SETFL, O_NONBLOCK) != 0)
+    {
+        ::close(socket_fd);
+        socket_fd = -1;
+    }
+}
+
+udp_transport::~udp_transport ( )
+{
+    if (socket_fd >= 0)
+        ::close(socket_fd);
+}
+
+bool udp_transport::send (const net_address & to, const unsigned char * data, std::size_t size)
+{
+    sockaddr_in remote;
+    std::memset(&remote, 0, sizeof(remote));
+    remote.sin_family = AF_INET;
+    remote.sin_addr.s_addr = htonl(to.host);
+    remote.sin_port = htons(to.port);
+
+    ssize_t sent = ::sendto(socket_fd, data, size, 0, reinterpret_cast<sockaddr *>(&remote), sizeof(remote));
+    if (sent < 0)
+        return false;
+
+    bytes_sent += sent;
+    return true;
+}
+
+bool udp_transport::receive (net_address & from, std::vector<unsigned char> & data)
+{
+    const std::size_t max_datagram = 65536;
+    data.resize(max_datagram);
+
+    sockaddr_in remote;
+    socklen_t remote_size = sizeof(remote);
+    ssize_t received = ::recvfrom(socket_fd, data.data(), max_datagram, 0, reinterpret_cast<sockaddr *>(&remote), &remote_size);
+    if (received < 0)
+    {
+        data.clear();
+        return false;
+    }
+
+    data.resize(received);
+    from.host = ntohl(remote.sin_addr.s_addr);
+    from.port = ntohs(remote.sin_port);
+    bytes_received += received;
+    return true;
+}
@@ -0,0 +1,122 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// IPv4 address and port in host byte order
+struct net_address
+{
+    std::uint32_t host;
+    std::uint16_t port;
+
+    net_address ( )
+        : host(0), port(0)
+    { }
+    net_address (std::uint32_t host, std::uint16_t port)
+        : host(host), port(port)
+    { }
+};
+
+inline bool operator == (net_address const & a1, net_address const & a2)
+{
+    return a1.host == a2.host && a1.port == a2.port;
+}
+
+inline bool operator < (net_address const & a1, net_address const & a2)
+{
+    return (a1.host < a2.host) || (a1.host == a2.host && a1.port < a2.port);
+}
+
+// Accepts "host" or "host:port"
+bool parse_address (const std::string & text, std::uint16_t default_port, net_address & result);
+std::string to_string (const net_address & a);
+
+// Unreliable, unordered datagrams
+class transport
+{
+public:
+    virtual ~transport ( ) { }
+
+    virtual bool send (const net_address & to, const unsigned char * data, std::size_t size) = 0;
+
+    // Non-blocking; returns false when there is nothing to read
+    virtual bool receive (net_address & from, std::vector<unsigned char> & data) = 0;
+
+    std::size_t bytes_sent;
+    std::size_t bytes_received;
+
+protected:
+    transport ( )
+        : bytes_sent(0), bytes_received(0)
+    { }
+};
+
+// In-process network for tests and benchmarks: every endpoint gets an
+// address on a fake host and datagrams are delivered through queues
+class loopback_network
+{
+public:
+    struct datagram
+    {
+        net_address from;
+        std::vector<unsigned char> data;
+    };
+
+    // Fraction of datagrams that are silently dropped
+    double loss;
+
+    loopback_network ( );
+
+    net_address add_endpoint ( );
+    void post (const net_address & from, const net_address & to, const unsigned char * data, std::size_t size);
+    bool fetch (const net_address & at, datagram & result);
+
+private:
+    std::map<net_address, std::deque<datagram>> queues;
+    std::uint16_t next_port;
+    std::uint32_t random_state;
+};
+
+class loopback_transport
+    : public transport
+{
+public:
+    explicit loopback_transport (loopback_network & network);
+
+    const net_address & address ( ) const { return address_; }
+
+    bool send (const net_address & to, const unsigned char * data, std::size_t size) override;
+    bool receive (net_address & from, std::vector<unsigned char> & data) override;
+
+private:
+    loopback_network & network;
+    net_address address_;
+    loopback_network::datagram incoming;
+};
+
+class udp_transport
+    : public transport
+{
+public:
+    // port 0 picks any free port
+    explicit udp_transport (std::uint16_t port = 0);
+    ~udp_transport ( );
+
+    udp_transport (const udp_transport &) = delete;
+    udp_transport & operator = (const udp_transport &) = delete;
+
+    bool is_open ( ) const { return socket_fd >= 0; }
+
+    bool send (const net_address & to, const unsigned char * data, std::size_t size) override;
+    bool receive (net_address & from, std::vector<unsigned char> & data) override;
+
+private:
+    int socket_fd;
+};
+
+#endif // TRANSPORT_H
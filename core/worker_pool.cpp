@@ -0,0 +1,87 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+
+worker_pool::worker_pool (unsigned int thread_count)
+    : current(nullptr)
+    , count(0)
+    , next_item(0)
+    , generation(0)
+    , busy(0)
+    , stopping(false)
+{
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    // The thread calling run() is worker 0
+    for (unsigned int i = 1; i < thread_count; ++i)
+        threads.emplace_back(&worker_pool::work, this, i);
+}
+
+worker_pool::~worker_pool ( )
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread & t : threads)
+        t.join();
+}
+
+void worker_pool::run (std::size_t item_count, const task & f)
+{
+    if (item_count == 0)
+        return;
+
+    if (threads.empty() || item_count == 1)
+    {
+        for (std::size_t i = 0; i < item_count; ++i)
+            f(i, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = &f;
+        count = item_count;
+        next_item = 0;
+        busy = threads.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    drain(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]{ return busy == 0; });
+    current = nullptr;
+}
+
+void worker_pool::drain (unsigned int worker)
+{
+    for (std::size_t i = next_item++; i < count; i = next_item++)
+        (*current)(i, worker);
+}
+
+void worker_pool::work (unsigned int worker)
+{
+    unsigned int seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen]{ return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        drain(worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
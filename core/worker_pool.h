@@ -0,0 +1,50 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+// A fixed set of threads for data-parallel loops. run() hands out the
+// items one by one to the workers and to the calling thread, and returns
+// when all of them are done, so no synchronisation is needed around it.
+class worker_pool
+{
+public:
+    typedef std::function<void (std::size_t item, unsigned int worker)> task;
+
+    // 0 threads means one per hardware thread
+    explicit worker_pool (unsigned int threads = 0);
+    ~worker_pool ( );
+
+    worker_pool (const worker_pool &) = delete;
+    worker_pool & operator = (const worker_pool &) = delete;
+
+    // Number of distinct worker indices passed to tasks
+    unsigned int size ( ) const { return threads.size() + 1; }
+
+    void run (std::size_t count, const task & f);
+
+private:
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const task * current;
+    std::size_t count;
+    std::atomic<std::size_t> next_item;
+    unsigned int generation;
+    unsigned int busy;
+    bool stopping;
+
+    void work (unsigned int worker);
+    void drain (unsigned int worker);
+};
+
+#endif // WORKER_POOL_H
@@ -0,0 +1,792 @@
+#include "world.h"
+#include "change_journal.h"
+#include "serialize.h"
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+
+std::size_t packed_voxels::bytes ( ) const
+{
+    return palette.size() * sizeof(voxel) + indices.size() * sizeof(std::uint64_t);
+}
+
+void pack (const voxel * voxels, packed_voxels & result)
+{
+    std::vector<unsigned short> indices(chunk_volume);
+    result.palette.clear();
+
+    unsigned int last = 0;
+    for (int i = 0; i < chunk_volume; ++i)
+    {
+        if (result.palette.empty() || !same_voxel(result.palette[last], voxels[i]))
+        {
+            last = 0;
+            while (last < result.palette.size() && !same_voxel(result.palette[last], voxels[i]))
+                ++last;
+            if (last == result.palette.size())
+                result.palette.push_back(voxels[i]);
+        }
+        indices[i] = last;
+    }
+
+    pack_indices(indices.data(), result);
+}
+
+void pack_indices (const unsigned short * indices, packed_voxels & result)
+{
+    result.bits = 0;
+    while ((1u << result.bits) < result.palette.size())
+        ++result.bits;
+
+    // An index may straddle two words
+    result.indices.assign((chunk_volume * result.bits + 63) / 64, 0);
+    for (int i = 0; i < chunk_volume && result.bits > 0; ++i)
+    {
+        std::size_t bit = static_cast<std::size_t>(i) * result.bits;
+        std::size_t word = bit / 64, offset = bit % 64;
+        result.indices[word] |= static_cast<std::uint64_t>(indices[i]) << offset;
+        if (offset + result.bits > 64)
+            result.indices[word + 1] |= static_cast<std::uint64_t>(indices[i]) >> (64 - offset);
+    }
+}
+
+void unpack (const packed_voxels & packed, voxel * voxels)
+{
+    if (packed.bits == 0)
+    {
+        std::fill(voxels, voxels + chunk_volume, packed.palette[0]);
+        return;
+    }
+
+    std::uint64_t mask = (std::uint64_t(1) << packed.bits) - 1;
+    for (int i = 0; i < chunk_volume; ++i)
+    {
+        std::size_t bit = static_cast<std::size_t>(i) * packed.bits;
+        std::size_t word = bit / 64, offset = bit % 64;
+        std::uint64_t index = packed.indices[word] >> offset;
+        if (offset + packed.bits > 64)
+            index |= packed.indices[word + 1] << (64 - offset);
+        voxels[i] = packed.palette[index & mask];
+    }
+}
+
+static std::uint64_t double_bits (double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static std::uint64_t hash_voxel (std::uint64_t h, const voxel & v)
+{
+    if (!v.solid)
+        return hash_mix(h, 0);
+
+    h = hash_mix(h, 1 + v.material);
+    for (int p = 0; p < 6; ++p)
+        h = hash_mix(hash_mix(h, double_bits(v.hue[p])), double_bits(v.brightness[p]));
+    return h;
+}
+
+static const std::uint64_t hash_seed = 0x6b75626163680000ull;
+
+std::uint64_t hash_voxels (const voxel * voxels)
+{
+    std::uint64_t h = hash_seed;
+    for (int i = 0; i < chunk_volume; ++i)
+        h = hash_voxel(h, voxels[i]);
+    return h;
+}
+
+std::uint64_t hash_voxels (const voxel * palette, const unsigned short * indices)
+{
+    std::uint64_t h = hash_seed;
+    for (int i = 0; i < chunk_volume; ++i)
+        h = hash_voxel(h, palette[indices[i]]);
+    return h;
+}
+
+static bool same_cells (const voxel * a, const voxel * b)
+{
+    for (int i = 0; i < chunk_volume; ++i)
+        if (!same_voxel(a[i], b[i]))
+            return false;
+    return true;
+}
+
+voxel_array::voxel_array (std::size_t size)
+    : data_(std::make_shared<voxel_vector>(size))
+{ }
+
+voxel_array::voxel_array (voxel_vector && voxels)
+    : data_(std::make_shared<voxel_vector>(std::move(voxels)))
+{ }
+
+voxel * voxel_array::edit ( )
+{
+    if (!data_)
+        return nullptr;
+
+    if (data_.use_count() > 1)
+        data_ = std::make_shared<voxel_vector>(*data_);
+    return data_->data();
+}
+
+chunk::chunk ( )
+    : voxels(chunk_volume)
+    , count(0)
+    , occupied(0)
+    , revision(0)
+    , hash(0)
+    , hashed_revision(0)
+{
+    voxel * v = voxels.edit();
+    for (int i = 0; i < chunk_volume; ++i)
+    {
+        v[i].solid = false;
+        v[i].material = material_cube;
+    }
+    std::fill(block_cells, block_cells + blocks_per_chunk, 0);
+    std::fill(solid_cells, solid_cells + chunk_volume / 64, 0);
+}
+
+std::uint64_t chunk::content_hash ( ) const
+{
+    if (hashed_revision == revision + 1)
+        return hash;
+
+    if (cold())
+    {
+        std::vector<voxel> expanded(chunk_volume);
+        unpack(*packed, expanded.data());
+        hash = hash_voxels(expanded.data());
+    }
+    else
+        hash = hash_voxels(voxels.data());
+    hashed_revision = revision + 1;
+    return hash;
+}
+
+void chunk::cell_filled (int index)
+{
+    solid_cells[index / 64] |= std::uint64_t(1) << (index % 64);
+
+    int b = block_of(index);
+    if (block_cells[b]++ == 0)
+        occupied |= std::uint64_t(1) << b;
+}
+
+void chunk::cell_emptied (int index)
+{
+    solid_cells[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+
+    int b = block_of(index);
+    if (--block_cells[b] == 0)
+        occupied &= ~(std::uint64_t(1) << b);
+}
+
+void chunk::count_blocks ( )
+{
+    std::fill(block_cells, block_cells + blocks_per_chunk, 0);
+    std::fill(solid_cells, solid_cells + chunk_volume / 64, 0);
+    occupied = 0;
+    for (int i = 0; i < chunk_volume; ++i)
+        if (voxels[i].solid)
+            cell_filled(i);
+}
+
+const int height_tile::no_height = INT_MIN;
+
+height_tile::height_tile ( )
+    : top(chunk_size * chunk_size, no_height)
+{ }
+
+static void record_cube (change_journal & journal, world_change::kind_type kind, cube_position p)
+{
+    world_change c;
+    c.kind = kind;
+    c.x = p.x;
+    c.y = p.y;
+    c.z = p.z;
+    journal.record(c);
+}
+
+static void record_chunk (change_journal & journal, chunk_position p)
+{
+    world_change c;
+    c.kind = world_change::chunk_changed;
+    c.x = p.x;
+    c.y = p.y;
+    c.z = p.z;
+    journal.record(c);
+}
+
+world::world ( )
+    : size_(0)
+    , revisions_(0)
+    , journal_(std::make_shared<change_journal>())
+    , bottom_(INT_MAX)
+    , cache_capacity_(16)
+    , cache_hits_(0)
+    , cache_misses_(0)
+{ }
+
+bool world::has_cube (cube_position p) const
+{
+    return find(p) != nullptr;
+}
+
+const voxel * world::find (cube_position p) const
+{
+    auto it = chunks_.find(chunk_of(p));
+    if (it == chunks_.end())
+        return nullptr;
+
+    voxel const & v = cells(it->first, it->second)[voxel_index(p)];
+    return v.solid ? &v : nullptr;
+}
+
+bool world::top (int x, int z, int & y) const
+{
+    auto it = heights_.find(column_position(chunk_coord(x), chunk_coord(z)));
+    if (it == heights_.end())
+        return false;
+
+    int h = it->second.top[local_coord(x) * chunk_size + local_coord(z)];
+    if (h == height_tile::no_height)
+        return false;
+
+    y = h;
+    return true;
+}
+
+bool world::sky_exposed (cube_position p) const
+{
+    int y;
+    return !top(p.x, p.z, y) || y <= p.y;
+}
+
+chunk & world::chunk_at (chunk_position p)
+{
+    bottom_ = std::min(bottom_, p.y);
+    chunk & c = chunks_[p];
+    thaw(p, c);
+    return c;
+}
+
+chunk * world::find_hot (chunk_position p)
+{
+    auto it = chunks_.find(p);
+    if (it == chunks_.end())
+        return nullptr;
+
+    thaw(p, it->second);
+    return &it->second;
+}
+
+const voxel * world::cells (chunk_position p, const chunk & c) const
+{
+    if (!c.cold())
+        return c.voxels.data();
+
+    auto it = cache_index_.find(p);
+    if (it != cache_index_.end())
+    {
+        ++cache_hits_;
+        cache_.splice(cache_.begin(), cache_, it->second);
+        return it->second->second.data();
+    }
+
+    ++cache_misses_;
+
+    // Reuse the storage of the least recently used entry
+    voxel_vector storage;
+    if (cache_.size() >= cache_capacity_)
+    {
+        storage.swap(cache_.back().second);
+        cache_index_.erase(cache_.back().first);
+        cache_.pop_back();
+    }
+    storage.resize(chunk_volume);
+    unpack(*c.packed, storage.data());
+
+    cache_.emplace_front(p, voxel_vector());
+    cache_.front().second.swap(storage);
+    cache_index_[p] = cache_.begin();
+    return cache_.front().second.data();
+}
+
+void world::thaw (chunk_position p, chunk & c)
+{
+    if (!c.cold())
+        return;
+
+    auto it = cache_index_.find(p);
+    if (it != cache_index_.end())
+    {
+        c.voxels = voxel_array(std::move(it->second->second));
+        cache_.erase(it->second);
+        cache_index_.erase(it);
+    }
+    else
+    {
+        c.voxels = voxel_array(chunk_volume);
+        unpack(*c.packed, c.voxels.edit());
+    }
+    c.packed.reset();
+}
+
+void world::thaw (chunk_position p)
+{
+    find_hot(p);
+}
+
+void world::freeze (chunk_position p, chunk & c)
+{
+    if (c.cold())
+        return;
+
+    // Hashing a cold chunk would have to unpack it
+    c.content_hash();
+
+    std::shared_ptr<packed_voxels> packed = std::make_shared<packed_voxels>();
+    pack(c.voxels.data(), *packed);
+    c.packed = packed;
+    c.voxels = voxel_array();
+    forget_cached(p);
+}
+
+void world::forget_cached (chunk_position p)
+{
+    auto it = cache_index_.find(p);
+    if (it == cache_index_.end())
+        return;
+
+    cache_.erase(it->second);
+    cache_index_.erase(it);
+}
+
+void world::update_residency (chunk_position center, int radius)
+{
+    for (auto & c : chunks_)
+    {
+        int distance = std::max(std::max(std::abs(c.first.x - center.x), std::abs(c.first.y - center.y)), std::abs(c.first.z - center.z));
+        if (distance > radius)
+            freeze(c.first, c.second);
+        else
+            thaw(c.first, c.second);
+    }
+}
+
+void world::set_cache_capacity (std::size_t chunks)
+{
+    // One chunk and its six neighbours are often looked at together
+    cache_capacity_ = std::max<std::size_t>(chunks, 8);
+    while (cache_.size() > cache_capacity_)
+    {
+        cache_index_.erase(cache_.back().first);
+        cache_.pop_back();
+    }
+}
+
+world::sharing_statistics world::share_identical ( )
+{
+    sharing_statistics result;
+    result.chunks = chunks_.size();
+    result.shared = 0;
+    result.bytes_saved = 0;
+
+    // The first chunk seen with each hash; the cells are compared before
+    // sharing, so a collision only costs a comparison
+    std::unordered_map<std::uint64_t, chunk *> first;
+    std::vector<voxel> a(chunk_volume), b(chunk_volume);
+    for (auto & cp : chunks_)
+    {
+        chunk & c = cp.second;
+        auto it = first.insert(std::make_pair(c.content_hash(), &c)).first;
+        chunk & original = *it->second;
+        if (&original == &c || original.cold() != c.cold())
+            continue;
+
+        if (c.cold())
+        {
+            if (original.packed == c.packed)
+                continue;
+
+            unpack(*original.packed, a.data());
+            unpack(*c.packed, b.data());
+            if (!same_cells(a.data(), b.data()))
+                continue;
+
+            result.bytes_saved += c.packed->bytes();
+            c.packed = original.packed;
+        }
+        else
+        {
+            if (original.voxels.shares(c.voxels) || !same_cells(original.voxels.data(), c.voxels.data()))
+                continue;
+
+            result.bytes_saved += c.voxels.size() * sizeof(voxel);
+            c.voxels = original.voxels;
+        }
+        ++result.shared;
+    }
+    return result;
+}
+
+world::storage_statistics world::storage_stats ( ) const
+{
+    storage_statistics result;
+    result.hot_chunks = 0;
+    result.cold_chunks = 0;
+    result.cached_chunks = cache_.size();
+    result.cache_hits = cache_hits_;
+    result.cache_misses = cache_misses_;
+    result.shared_chunks = 0;
+    result.resident_bytes = cache_.size() * chunk_volume * sizeof(voxel);
+
+    std::unordered_set<const void *> counted;
+    for (auto const & c : chunks_)
+    {
+        result.resident_bytes += sizeof(c);
+        if (c.second.cold())
+            ++result.cold_chunks;
+        else
+            ++result.hot_chunks;
+
+        const void * storage = c.second.cold() ? static_cast<const void *>(c.second.packed.get()) : c.second.voxels.data();
+        if (!counted.insert(storage).second)
+        {
+            ++result.shared_chunks;
+            continue;
+        }
+
+        if (c.second.cold())
+            result.resident_bytes += c.second.packed->bytes();
+        else
+            result.resident_bytes += c.second.voxels.size() * sizeof(voxel);
+    }
+    return result;
+}
+
+int & world::top_slot (int x, int z)
+{
+    return heights_[column_position(chunk_coord(x), chunk_coord(z))].top[local_coord(x) * chunk_size + local_coord(z)];
+}
+
+int world::highest_below (int x, int z, int y) const
+{
+    int lx = local_coord(x), lz = local_coord(z);
+    for (int cy = chunk_coord(y - 1); cy >= bottom_; --cy)
+    {
+        auto it = chunks_.find(chunk_position(chunk_coord(x), cy, chunk_coord(z)));
+        if (it == chunks_.end() || it->second.count == 0)
+            continue;
+
+        int ly = std::min(y - 1 - cy * chunk_size, chunk_size - 1);
+        for (; ly >= 0; --ly)
+            if (cells(it->first, it->second)[voxel_index(lx, ly, lz)].solid)
+                return cy * chunk_size + ly;
+    }
+    return height_tile::no_height;
+}
+
+void world::add_cube (cube_position p, double hue, double brightness, int material)
+{
+    chunk & c = chunk_at(chunk_of(p));
+    voxel & v = c.voxels.edit()[voxel_index(p)];
+
+    if (!v.solid)
+    {
+        ++c.count;
+        c.cell_filled(voxel_index(p));
+        ++size_;
+
+        int & top = top_slot(p.x, p.z);
+        top = std::max(top, p.y);
+    }
+
+    v.solid = true;
+    v.material = material;
+    touch(c);
+    record_cube(*journal_, world_change::cube_added, p);
+    for (int i = 0; i < 6; ++i)
+    {
+        v.hue[i] = hue;
+        v.brightness[i] = brightness;
+    }
+}
+
+bool world::remove_cube (cube_position p)
+{
+    chunk * c = find_hot(chunk_of(p));
+    if (!c)
+        return false;
+
+    if (!c->voxels[voxel_index(p)].solid)
+        return false;
+
+    c->voxels.edit()[voxel_index(p)].solid = false;
+    --c->count;
+    c->cell_emptied(voxel_index(p));
+    touch(*c);
+    record_cube(*journal_, world_change::cube_removed, p);
+    --size_;
+
+    int & top = top_slot(p.x, p.z);
+    if (top == p.y)
+        top = highest_below(p.x, p.z, p.y);
+    return true;
+}
+
+void world::paint (cube_position p, int plane, double hue, double brightness)
+{
+    chunk * c = find_hot(chunk_of(p));
+    if (!c)
+        return;
+
+    if (!c->voxels[voxel_index(p)].solid)
+        return;
+
+    voxel & v = c->voxels.edit()[voxel_index(p)];
+    v.hue[plane] = hue;
+    v.brightness[plane] = brightness;
+    touch(*c);
+    record_cube(*journal_, world_change::cube_painted, p);
+}
+
+void world::swap_cubes (cube_position a, cube_position b)
+{
+    chunk & ca = chunk_at(chunk_of(a));
+    chunk & cb = chunk_at(chunk_of(b));
+    voxel & va = ca.voxels.edit()[voxel_index(a)];
+    voxel & vb = cb.voxels.edit()[voxel_index(b)];
+
+    if (va.solid != vb.solid)
+    {
+        int moved = va.solid ? 1 : -1;
+        ca.count -= moved;
+        cb.count += moved;
+
+        if (va.solid)
+        {
+            ca.cell_emptied(voxel_index(a));
+            cb.cell_filled(voxel_index(b));
+        }
+        else
+        {
+            cb.cell_emptied(voxel_index(b));
+            ca.cell_filled(voxel_index(a));
+        }
+    }
+
+    std::swap(va, vb);
+    touch(ca);
+    touch(cb);
+    record_cube(*journal_, va.solid ? world_change::cube_added : world_change::cube_removed, a);
+    record_cube(*journal_, vb.solid ? world_change::cube_added : world_change::cube_removed, b);
+
+    refresh_top(a);
+    refresh_top(b);
+}
+
+void world::write_box (cube_position origin, int size_x, int size_y, int size_z, const voxel * palette, const std::uint32_t * cells)
+{
+    if (size_x <= 0 || size_y <= 0 || size_z <= 0)
+        return;
+
+    cube_position last(origin.x + size_x - 1, origin.y + size_y - 1, origin.z + size_z - 1);
+    chunk_position lo = chunk_of(origin), hi = chunk_of(last);
+
+    for (int cx = lo.x; cx <= hi.x; ++cx)
+        for (int cy = lo.y; cy <= hi.y; ++cy)
+            for (int cz = lo.z; cz <= hi.z; ++cz)
+            {
+                chunk & c = chunk_at(chunk_position(cx, cy, cz));
+                voxel * target = c.voxels.edit();
+
+                int x0 = std::max(origin.x, cx * chunk_size), x1 = std::min(last.x, cx * chunk_size + chunk_size - 1);
+                int y0 = std::max(origin.y, cy * chunk_size), y1 = std::min(last.y, cy * chunk_size + chunk_size - 1);
+                int z0 = std::max(origin.z, cz * chunk_size), z1 = std::min(last.z, cz * chunk_size + chunk_size - 1);
+
+                for (int x = x0; x <= x1; ++x)
+                    for (int y = y0; y <= y1; ++y)
+                    {
+                        const std::uint32_t * row = cells + ((x - origin.x) * size_y + (y - origin.y)) * size_z + (z0 - origin.z);
+                        voxel * out = target + voxel_index(local_coord(x), local_coord(y), local_coord(z0));
+                        for (int z = z0; z <= z1; ++z)
+                            *out++ = palette[*row++];
+                    }
+
+                size_ -= c.count;
+                c.count = 0;
+                for (int i = 0; i < chunk_volume; ++i)
+                    c.count += target[i].solid;
+                size_ += c.count;
+                c.count_blocks();
+                mark_changed(chunk_position(cx, cy, cz), c);
+            }
+
+    // Columns topped above the box keep their top
+    for (int x = origin.x; x <= last.x; ++x)
+        for (int z = origin.z; z <= last.z; ++z)
+        {
+            int & top = top_slot(x, z);
+            if (top > last.y)
+                continue;
+
+            int y = size_y - 1;
+            const std::uint32_t * column = cells + (x - origin.x) * size_y * size_z + (z - origin.z);
+            while (y >= 0 && !palette[column[y * size_z]].solid)
+                --y;
+
+            if (y >= 0)
+                top = origin.y + y;
+            else if (top >= origin.y)
+                top = highest_below(x, z, origin.y);
+        }
+}
+
+std::size_t world::remove_sphere (double x, double y, double z, double radius, std::vector<std::pair<cube_position, voxel>> & removed)
+{
+    cube_position lo(std::ceil(x - radius), std::ceil(y - radius), std::ceil(z - radius));
+    cube_position hi(std::floor(x + radius), std::floor(y + radius), std::floor(z + radius));
+    if (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z)
+        return 0;
+
+    std::size_t first = removed.size();
+    chunk_position clo = chunk_of(lo), chi = chunk_of(hi);
+    for (int cx = clo.x; cx <= chi.x; ++cx)
+        for (int cy = clo.y; cy <= chi.y; ++cy)
+            for (int cz = clo.z; cz <= chi.z; ++cz)
+            {
+                chunk_position cp(cx, cy, cz);
+                auto it = chunks_.find(cp);
+                if (it == chunks_.end() || it->second.count == 0)
+                    continue;
+
+                chunk & c = *find_hot(cp);
+                voxel * target = nullptr;
+
+                int x0 = std::max(lo.x, cx * chunk_size), x1 = std::min(hi.x, cx * chunk_size + chunk_size - 1);
+                int y0 = std::max(lo.y, cy * chunk_size), y1 = std::min(hi.y, cy * chunk_size + chunk_size - 1);
+                int z0 = std::max(lo.z, cz * chunk_size), z1 = std::min(hi.z, cz * chunk_size + chunk_size - 1);
+                for (int px = x0; px <= x1; ++px)
+                    for (int py = y0; py <= y1; ++py)
+                        for (int pz = z0; pz <= z1; ++pz)
+                        {
+                            double dx = px - x, dy = py - y, dz = pz - z;
+                            int i = voxel_index(local_coord(px), local_coord(py), local_coord(pz));
+                            if (dx * dx + dy * dy + dz * dz > radius * radius || !c.voxels[i].solid)
+                                continue;
+
+                            // Chunks the sphere only grazes are not copied
+                            if (!target)
+                                target = c.voxels.edit();
+
+                            removed.push_back(std::make_pair(cube_position(px, py, pz), target[i]));
+                            target[i].solid = false;
+                            --c.count;
+                            c.cell_emptied(i);
+                        }
+
+                if (target)
+                    mark_changed(cp, c);
+            }
+
+    std::size_t count = removed.size() - first;
+    size_ -= count;
+
+    // Only columns that lost their topmost cube need a new one
+    for (int px = lo.x; px <= hi.x && count > 0; ++px)
+        for (int pz = lo.z; pz <= hi.z; ++pz)
+        {
+            auto it = heights_.find(column_position(chunk_coord(px), chunk_coord(pz)));
+            if (it == heights_.end())
+                continue;
+
+            int & top = it->second.top[local_coord(px) * chunk_size + local_coord(pz)];
+            if (top != height_tile::no_height && top >= lo.y && top <= hi.y && !has_cube(cube_position(px, top, pz)))
+                top = highest_below(px, pz, top);
+        }
+
+    return count;
+}
+
+chunk * world::find_chunk (chunk_position p)
+{
+    return find_hot(p);
+}
+
+void world::mark_changed (chunk_position p, chunk & c)
+{
+    touch(c);
+    record_chunk(*journal_, p);
+}
+
+void world::refresh_top (cube_position p)
+{
+    int & top = top_slot(p.x, p.z);
+    if (has_cube(p))
+        top = std::max(top, p.y);
+    else if (top == p.y)
+        top = highest_below(p.x, p.z, p.y);
+}
+
+void world::set_chunk (chunk_position p, const chunk & c)
+{
+    // Not through chunk_at, which would expand the chunk only to replace it
+    bottom_ = std::min(bottom_, p.y);
+    auto it = chunks_.find(p);
+    if (it == chunks_.end())
+        it = chunks_.insert(std::make_pair(p, c)).first;
+    else
+    {
+        size_ -= it->second.count;
+        it->second = c;
+    }
+
+    chunk & target = it->second;
+    mark_changed(p, target);
+    if (c.hashed_revision == c.revision + 1)
+        target.hashed_revision = target.revision + 1;
+    size_ += target.count;
+    forget_cached(p);
+
+    // Columns topped above this chunk are not affected
+    int low = p.y * chunk_size, high = low + chunk_size - 1;
+    height_tile & tile = heights_[column_position(p.x, p.z)];
+    for (int lx = 0; lx < chunk_size; ++lx)
+        for (int lz = 0; lz < chunk_size; ++lz)
+        {
+            int & top = tile.top[lx * chunk_size + lz];
+            if (top > high)
+                continue;
+
+            int ly = chunk_size - 1;
+            while (ly >= 0 && !target.solid_at(voxel_index(lx, ly, lz)))
+                --ly;
+
+            if (ly >= 0)
+                top = low + ly;
+            else if (top >= low)
+                top = highest_below(p.x * chunk_size + lx, p.z * chunk_size + lz, low);
+        }
+}
+
+void world::clear ( )
+{
+    for (auto const & c : chunks_)
+        record_chunk(*journal_, c.first);
+
+    chunks_.clear();
+    heights_.clear();
+    cache_.clear();
+    cache_index_.clear();
+    size_ = 0;
+    bottom_ = INT_MAX;
+}
@@ -0,0 +1,409 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "cube.h"
+#include "memory_stats.h"
+
+#include <map>
+#include <functional>
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+class change_journal;
+
+const int chunk_size = 16;
+const int chunk_volume = chunk_size * chunk_size * chunk_size;
+
+struct chunk_position
+{
+    int x, y, z;
+
+    chunk_position ( ) = default;
+    chunk_position (int x, int y, int z)
+        : x(x), y(y), z(z)
+    { }
+};
+
+inline bool operator < (chunk_position const & cp1, chunk_position const & cp2)
+{
+    return (cp1.x < cp2.x) || (cp1.x == cp2.x && cp1.y < cp2.y) || (cp1.x == cp2.x && cp1.y == cp2.y && cp1.z < cp2.z);
+}
+
+inline bool operator == (chunk_position const & cp1, chunk_position const & cp2)
+{
+    return cp1.x == cp2.x && cp1.y == cp2.y && cp1.z == cp2.z;
+}
+
+struct chunk_position_hash
+{
+    std::size_t operator () (chunk_position const & p) const
+    {
+        return static_cast<std::size_t>(p.x) * 73856093u ^ static_cast<std::size_t>(p.y) * 19349663u ^ static_cast<std::size_t>(p.z) * 83492791u;
+    }
+};
+
+inline int chunk_coord (int x)
+{
+    return (x >= 0) ? x / chunk_size : (x + 1) / chunk_size - 1;
+}
+
+inline int local_coord (int x)
+{
+    return x - chunk_coord(x) * chunk_size;
+}
+
+inline chunk_position chunk_of (cube_position p)
+{
+    return chunk_position(chunk_coord(p.x), chunk_coord(p.y), chunk_coord(p.z));
+}
+
+inline int voxel_index (int lx, int ly, int lz)
+{
+    return (lx * chunk_size + ly) * chunk_size + lz;
+}
+
+inline int voxel_index (cube_position p)
+{
+    return voxel_index(local_coord(p.x), local_coord(p.y), local_coord(p.z));
+}
+
+// Chunks keep a summary of which blocks of block_size³ cells have any
+// cubes, so queries can skip empty space without touching the voxels
+const int block_size = 4;
+const int chunk_blocks = chunk_size / block_size;
+const int blocks_per_chunk = chunk_blocks * chunk_blocks * chunk_blocks;
+
+inline int block_index (int bx, int by, int bz)
+{
+    return (bx * chunk_blocks + by) * chunk_blocks + bz;
+}
+
+inline int block_of (int voxel_index)
+{
+    int lx = voxel_index / (chunk_size * chunk_size);
+    int ly = voxel_index / chunk_size % chunk_size;
+    int lz = voxel_index % chunk_size;
+    return block_index(lx / block_size, ly / block_size, lz / block_size);
+}
+
+// Sand and water are moved around by the simulation; water and glass
+// can be seen through
+enum material
+{
+    material_cube = 0,
+    material_sand = 1,
+    material_water = 2,
+    material_glass = 3,
+    material_count = 4
+};
+
+inline bool is_dynamic (int material)
+{
+    return material == material_sand || material == material_water;
+}
+
+// Opacity of the faces
+inline double material_alpha (int material)
+{
+    return material == material_water ? 0.6 : (material == material_glass ? 0.3 : 1.0);
+}
+
+// Planes are indexed the same way as in make_mesh: +x, -x, +y, -y, +z, -z
+struct voxel
+{
+    bool solid;
+    unsigned char material;
+    double hue[6];
+    double brightness[6];
+};
+
+// Voxels of expanded chunks; also how the cache keeps them
+typedef std::vector<voxel, tracked_allocator<voxel, memory_voxels>> voxel_vector;
+
+// The distinct voxels of a chunk and, for every cell, the index of its
+// voxel in as few bits as the palette needs
+struct packed_voxels
+{
+    std::vector<voxel, tracked_allocator<voxel, memory_packed>> palette;
+    std::vector<std::uint64_t, tracked_allocator<std::uint64_t, memory_packed>> indices;
+    int bits;
+
+    packed_voxels ( ) : bits(0) { }
+
+    std::size_t bytes ( ) const;
+};
+
+void pack (const voxel * voxels, packed_voxels & result);
+void unpack (const packed_voxels & packed, voxel * voxels);
+
+// For cells that are already indices into result.palette, one per cell
+void pack_indices (const unsigned short * indices, packed_voxels & result);
+
+inline std::uint64_t hash_mix (std::uint64_t h, std::uint64_t value)
+{
+    h ^= value;
+    h *= 0xff51afd7ed558ccdull;
+    return h ^ (h >> 33);
+}
+
+// Equal for cells that look the same: only what same_voxel compares is
+// hashed, so empty cells with leftover colors don't matter
+std::uint64_t hash_voxels (const voxel * voxels);
+std::uint64_t hash_voxels (const voxel * palette, const unsigned short * indices);
+
+// Voxel storage that copies share until one of them is written to
+class voxel_array
+{
+public:
+    voxel_array ( ) { }
+    explicit voxel_array (std::size_t size);
+    explicit voxel_array (voxel_vector && voxels);
+
+    bool empty ( ) const { return !data_ || data_->empty(); }
+    std::size_t size ( ) const { return data_ ? data_->size() : 0; }
+    const voxel * data ( ) const { return data_ ? data_->data() : nullptr; }
+    const voxel & operator [] (std::size_t i) const { return (*data_)[i]; }
+
+    bool shares (const voxel_array & other) const { return data_ && data_ == other.data_; }
+
+    // Copies the storage first if another array still refers to it
+    voxel * edit ( );
+
+private:
+    std::shared_ptr<voxel_vector> data_;
+};
+
+// A chunk is either hot, with all its voxels expanded, or cold, with
+// voxels empty and only the packed form kept; see world::cells. Copying
+// a chunk doesn't copy either of them.
+struct chunk
+{
+    voxel_array voxels;
+    std::shared_ptr<const packed_voxels> packed;
+    int count;
+
+    // Solid cells per block, and a bit per block that has any
+    unsigned char block_cells[blocks_per_chunk];
+    std::uint64_t occupied;
+
+    // A bit per cell in voxel_index order, for queries that only ask
+    // whether a cell is solid; kept even while the chunk is packed
+    std::uint64_t solid_cells[chunk_volume / 64];
+
+    // Changes on every edit to a value the world has not used before, so
+    // derived data can tell it is stale
+    unsigned int revision;
+
+    // The last content_hash, good while hashed_revision is revision + 1
+    mutable std::uint64_t hash;
+    mutable unsigned int hashed_revision;
+
+    chunk ( );
+
+    bool cold ( ) const { return voxels.empty(); }
+
+    bool solid_at (int index) const { return (solid_cells[index / 64] >> (index % 64)) & 1; }
+
+    // hash_voxels of the cells, computed on first use after a change
+    std::uint64_t content_hash ( ) const;
+
+    // Keep the block summary and the cell bits right when a cell changes
+    // between empty and solid; count_blocks rebuilds them from the voxels
+    // of a hot chunk
+    void cell_filled (int index);
+    void cell_emptied (int index);
+    void count_blocks ( );
+};
+
+// Chunk coordinates of a vertical stack of chunks
+struct column_position
+{
+    int x, z;
+
+    column_position ( ) = default;
+    column_position (int x, int z)
+        : x(x), z(z)
+    { }
+};
+
+inline bool operator == (column_position const & cp1, column_position const & cp2)
+{
+    return cp1.x == cp2.x && cp1.z == cp2.z;
+}
+
+struct column_position_hash
+{
+    std::size_t operator () (column_position const & p) const
+    {
+        return static_cast<std::size_t>(p.x) * 73856093u ^ static_cast<std::size_t>(p.z) * 19349663u;
+    }
+};
+
+// Topmost solid y for every x, z of a chunk column
+struct height_tile
+{
+    static const int no_height;
+
+    std::vector<int, tracked_allocator<int, memory_heightmap>> top;
+
+    height_tile ( );
+};
+
+class world
+{
+public:
+    typedef std::map<chunk_position, chunk, std::less<chunk_position>,
+        tracked_allocator<std::pair<const chunk_position, chunk>, memory_chunks>> chunk_map;
+    typedef std::unordered_map<column_position, height_tile, column_position_hash, std::equal_to<column_position>,
+        tracked_allocator<std::pair<const column_position, height_tile>, memory_heightmap>> height_map;
+
+    struct storage_statistics
+    {
+        std::size_t hot_chunks;
+        std::size_t cold_chunks;
+        std::size_t cached_chunks;
+        std::size_t cache_hits;
+        std::size_t cache_misses;
+        // Shared storage is counted once
+        std::size_t shared_chunks;
+        std::size_t resident_bytes;
+    };
+
+    struct sharing_statistics
+    {
+        std::size_t chunks;
+        std::size_t shared;
+        std::size_t bytes_saved;
+    };
+
+    world ( );
+
+    bool has_cube (cube_position p) const;
+    const voxel * find (cube_position p) const;
+
+    // The topmost solid cube in the column, kept up to date by every edit
+    bool top (int x, int z, int & y) const;
+
+    // Nothing solid above p, so it sees the sky
+    bool sky_exposed (cube_position p) const;
+
+    void add_cube (cube_position p, double hue, double brightness, int material = material_cube);
+    bool remove_cube (cube_position p);
+    void paint (cube_position p, int plane, double hue, double brightness);
+
+    // Exchanges two cells, either of which may be empty
+    void swap_cubes (cube_position a, cube_position b);
+
+    // Overwrites the box of size_x * size_y * size_z cells starting at
+    // origin with palette[cells[i]]; cells are ordered like voxel_index,
+    // z fastest. Every chunk is filled row by row and marked changed once.
+    void write_box (cube_position origin, int size_x, int size_y, int size_z, const voxel * palette, const std::uint32_t * cells);
+
+    // Empties every cell whose centre is within radius of x, y, z, with
+    // one mark_changed per chunk touched, and appends the cubes it removed
+    // to removed. Returns how many there were.
+    std::size_t remove_sphere (double x, double y, double z, double radius, std::vector<std::pair<cube_position, voxel>> & removed);
+
+    // Direct access for bulk updates that don't add chunks. Callers have
+    // to keep the chunk count right, write through voxels.edit(), and call
+    // mark_changed and refresh_top for what they changed.
+    chunk * find_chunk (chunk_position p);
+    void mark_changed (chunk_position p, chunk & c);
+    void refresh_top (cube_position p);
+
+    // Every edit is recorded here, for the readers of the journal
+    const std::shared_ptr<change_journal> & journal ( ) const { return journal_; }
+
+    // Replaces a whole chunk, e.g. one received from the network; a packed
+    // one stays packed
+    void set_chunk (chunk_position p, const chunk & c);
+    void clear ( );
+
+    std::size_t size ( ) const { return size_; }
+
+    const chunk_map & chunks ( ) const { return chunks_; }
+    const height_map & heights ( ) const { return heights_; }
+
+    // A consistent copy of all chunks that later edits don't affect. It
+    // shares the voxels with the world, so it costs a map node per chunk,
+    // and may be read from another thread.
+    chunk_map snapshot ( ) const { return chunks_; }
+
+    // The voxels of a chunk in voxel_index order. Cold chunks are expanded
+    // into a small LRU cache, so the pointer is only good until
+    // cache_capacity other cold chunks have been looked at. Not thread-safe
+    // for cold chunks; see thaw.
+    const voxel * cells (chunk_position p, const chunk & c) const;
+
+    // Chunks further than radius chunks from center are packed, those
+    // within it are expanded again
+    void update_residency (chunk_position center, int radius);
+
+    // Expands a chunk for good, e.g. before it is read from several threads
+    void thaw (chunk_position p);
+
+    // Makes chunks with the same contents use one copy of their voxels,
+    // expanded or packed alike. Sharing is copy-on-write, so nothing
+    // changes for the callers; shared reports the chunks that started
+    // sharing.
+    sharing_statistics share_identical ( );
+
+    void set_cache_capacity (std::size_t chunks);
+    storage_statistics storage_stats ( ) const;
+
+    template <typename F>
+    void for_each_cube (F f) const
+    {
+        for (auto const & c : chunks_)
+        {
+            if (c.second.count == 0) continue;
+
+            const voxel * voxels = cells(c.first, c.second);
+            for (int x = 0; x < chunk_size; ++x)
+                for (int y = 0; y < chunk_size; ++y)
+                    for (int z = 0; z < chunk_size; ++z)
+                    {
+                        voxel const & v = voxels[voxel_index(x, y, z)];
+                        if (v.solid)
+                            f(cube_position(c.first.x * chunk_size + x, c.first.y * chunk_size + y, c.first.z * chunk_size + z), v);
+                    }
+        }
+    }
+
+private:
+    chunk_map chunks_;
+    height_map heights_;
+    std::size_t size_;
+    unsigned int revisions_;
+    std::shared_ptr<change_journal> journal_;
+
+    // Lowest chunk y ever created, where downward scans can stop
+    int bottom_;
+
+    // Expanded cold chunks, most recently used first
+    typedef std::list<std::pair<chunk_position, voxel_vector>> cache_list;
+    mutable cache_list cache_;
+    mutable std::map<chunk_position, cache_list::iterator> cache_index_;
+    std::size_t cache_capacity_;
+    mutable std::size_t cache_hits_, cache_misses_;
+
+    void thaw (chunk_position p, chunk & c);
+    void freeze (chunk_position p, chunk & c);
+    void forget_cached (chunk_position p);
+
+    // Every write goes through these, so the chunk is hot afterwards
+    chunk & chunk_at (chunk_position p);
+    chunk * find_hot (chunk_position p);
+
+    int & top_slot (int x, int z);
+    int highest_below (int x, int z, int y) const;
+
+    // A new revision, for edits that record themselves cell by cell
+    void touch (chunk & c) { c.revision = ++revisions_; }
+};
+
+#endif // WORLD_H
@@ -0,0 +1,421 @@
+#include "world_file.h"
+#include "serialize.h"
+
+#include <fstream>
+#include <chrono>
+#include <unordered_map>
+
+typedef std::chrono::high_resolution_clock clock_type;
+
+static double milliseconds_since (clock_type::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+static const std::uint32_t world_magic = 0x5742554b; // "KUBW"
+static const std::uint32_t world_version = 2;
+static const std::size_t header_size = 8;
+static const std::size_t trailer_size = 8;
+
+// Cold chunks are expanded into scratch rather than through the world's
+// cache, which belongs to the thread that owns the world
+static const voxel * cells_of (const chunk & c, std::vector<voxel> & scratch)
+{
+    if (!c.cold())
+        return c.voxels.data();
+
+    scratch.resize(chunk_volume);
+    unpack(*c.packed, scratch.data());
+    return scratch.data();
+}
+
+static bool same_contents (const chunk & a, const chunk & b, std::vector<voxel> & scratch_a, std::vector<voxel> & scratch_b)
+{
+    if (a.voxels.shares(b.voxels) || (a.cold() && a.packed == b.packed))
+        return true;
+
+    const voxel * va = cells_of(a, scratch_a);
+    const voxel * vb = cells_of(b, scratch_b);
+    for (int i = 0; i < chunk_volume; ++i)
+        if (!same_voxel(va[i], vb[i]))
+            return false;
+    return true;
+}
+
+bool write_world (const world::chunk_map & chunks, const std::string & path, std::size_t & bytes)
+{
+    bytes = 0;
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    byte_writer out;
+    out.write_u32(world_magic);
+    out.write_u32(world_version);
+
+    // Every distinct chunk is written once; records with the same hash are
+    // compared, so a collision only costs a second record
+    std::unordered_map<std::uint64_t, std::vector<std::size_t>> by_hash;
+    std::vector<const chunk *> records;
+    std::vector<std::size_t> record_sizes;
+
+    byte_writer index;
+    index.write_varint(chunks.size());
+
+    std::vector<voxel> scratch, other;
+    byte_writer data;
+    for (auto const & c : chunks)
+    {
+        std::uint64_t hash = c.second.content_hash();
+        std::vector<std::size_t> & candidates = by_hash[hash];
+
+        std::size_t record = records.size();
+        for (std::size_t r : candidates)
+            if (same_contents(*records[r], c.second, scratch, other))
+            {
+                record = r;
+                break;
+            }
+
+        if (record == records.size())
+        {
+            candidates.push_back(record);
+            records.push_back(&c.second);
+
+            data.data.clear();
+            write_chunk(data, cells_of(c.second, scratch));
+            out.write_bytes(data.data.data(), data.size());
+            record_sizes.push_back(data.size());
+        }
+
+        index.write_svarint(c.first.x);
+        index.write_svarint(c.first.y);
+        index.write_svarint(c.first.z);
+        index.write_u64(hash);
+        index.write_varint(record);
+
+        // Write in pieces, so the buffer stays small for big worlds
+        if (out.size() >= (1 << 20))
+        {
+            file.write(reinterpret_cast<const char *>(out.data.data()), out.size());
+            bytes += out.size();
+            out.data.clear();
+        }
+    }
+
+    std::uint64_t index_offset = bytes + out.size();
+    out.write_varint(record_sizes.size());
+    for (std::size_t size : record_sizes)
+        out.write_varint(size);
+    out.write_bytes(index.data.data(), index.size());
+    out.write_u64(index_offset);
+
+    file.write(reinterpret_cast<const char *>(out.data.data()), out.size());
+    bytes += out.size();
+    file.close();
+    return !file.fail();
+}
+
+namespace
+{
+    struct index_entry
+    {
+        chunk_position position;
+        std::uint64_t hash;
+        std::size_t record;
+    };
+}
+
+static bool read_index (byte_reader & in, std::vector<std::size_t> & record_sizes, std::vector<index_entry> & entries)
+{
+    std::size_t records = in.read_varint();
+    if (!in.ok() || records > in.remaining())
+        return false;
+
+    record_sizes.resize(records);
+    for (std::size_t & size : record_sizes)
+        size = in.read_varint();
+
+    std::size_t count = in.read_varint();
+    if (!in.ok() || count > in.remaining())
+        return false;
+
+    entries.resize(count);
+    for (index_entry & e : entries)
+    {
+        e.position.x = in.read_svarint();
+        e.position.y = in.read_svarint();
+        e.position.z = in.read_svarint();
+        e.hash = in.read_u64();
+        e.record = in.read_varint();
+        if (e.record >= records)
+            return false;
+    }
+    return in.ok();
+}
+
+static bool read_chunks_v1 (byte_reader & in, world::chunk_map & chunks)
+{
+    std::size_t count = in.read_varint();
+    for (std::size_t i = 0; i < count && in.ok(); ++i)
+    {
+        chunk_position p;
+        p.x = in.read_svarint();
+        p.y = in.read_svarint();
+        p.z = in.read_svarint();
+        std::size_t size = in.read_varint();
+        const unsigned char * data = in.read_bytes(size);
+        if (!in.ok())
+            break;
+
+        byte_reader chunk_in(data, size);
+        if (!read_chunk(chunk_in, chunks[p]))
+            return false;
+    }
+
+    return in.ok() && chunks.size() == count;
+}
+
+bool read_world (const std::string & path, world::chunk_map & chunks, std::size_t & bytes)
+{
+    bytes = 0;
+    chunks.clear();
+
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    std::vector<unsigned char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    bytes = contents.size();
+
+    byte_reader in(contents.data(), contents.size());
+    if (in.read_u32() != world_magic)
+        return false;
+
+    std::uint32_t version = in.read_u32();
+    if (version == 1)
+        return read_chunks_v1(in, chunks);
+    if (version != world_version || bytes < header_size + trailer_size)
+        return false;
+
+    byte_reader trailer(contents.data() + bytes - trailer_size, trailer_size);
+    std::uint64_t index_offset = trailer.read_u64();
+    if (index_offset < header_size || index_offset > bytes - trailer_size)
+        return false;
+
+    byte_reader index_in(contents.data() + index_offset, bytes - trailer_size - index_offset);
+    std::vector<std::size_t> record_sizes;
+    std::vector<index_entry> entries;
+    if (!read_index(index_in, record_sizes, entries))
+        return false;
+
+    std::vector<std::size_t> record_offsets(record_sizes.size());
+    std::size_t offset = header_size;
+    for (std::size_t r = 0; r < record_sizes.size(); ++r)
+    {
+        record_offsets[r] = offset;
+        offset += record_sizes[r];
+        if (offset > index_offset)
+            return false;
+    }
+
+    // Chunks of one record share their voxels, and the stored hash checks
+    // the record once
+    std::vector<chunk> decoded(record_sizes.size());
+    std::vector<bool> done(record_sizes.size(), false);
+    for (index_entry const & e : entries)
+    {
+        if (!done[e.record])
+        {
+            byte_reader chunk_in(contents.data() + record_offsets[e.record], record_sizes[e.record]);
+            if (!read_chunk(chunk_in, decoded[e.record]) || decoded[e.record].content_hash() != e.hash)
+                return false;
+            done[e.record] = true;
+        }
+        chunks[e.position] = decoded[e.record];
+    }
+
+    return chunks.size() == entries.size();
+}
+
+bool read_world_index (const std::string & path, chunk_index & result)
+{
+    result.clear();
+
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    unsigned char header[header_size];
+    file.read(reinterpret_cast<char *>(header), header_size);
+    byte_reader header_in(header, file.gcount());
+    if (header_in.read_u32() != world_magic)
+        return false;
+
+    // Older files have no hashes, so they are read whole
+    if (header_in.read_u32() != world_version)
+    {
+        world::chunk_map chunks;
+        std::size_t bytes;
+        if (!read_world(path, chunks, bytes))
+            return false;
+        index_chunks(chunks, result);
+        return true;
+    }
+
+    file.seekg(0, std::ios::end);
+    std::size_t size = file.tellg();
+    if (size < header_size + trailer_size)
+        return false;
+
+    unsigned char trailer[trailer_size];
+    file.seekg(size - trailer_size);
+    file.read(reinterpret_cast<char *>(trailer), trailer_size);
+    std::uint64_t index_offset = byte_reader(trailer, file.gcount()).read_u64();
+    if (!file || index_offset < header_size || index_offset > size - trailer_size)
+        return false;
+
+    std::vector<unsigned char> contents(size - trailer_size - index_offset);
+    file.seekg(index_offset);
+    file.read(reinterpret_cast<char *>(contents.data()), contents.size());
+    if (!file)
+        return false;
+
+    byte_reader in(contents.data(), contents.size());
+    std::vector<std::size_t> record_sizes;
+    std::vector<index_entry> entries;
+    if (!read_index(in, record_sizes, entries))
+        return false;
+
+    for (index_entry const & e : entries)
+        result[e.position] = e.hash;
+    return result.size() == entries.size();
+}
+
+void index_chunks (const world::chunk_map & chunks, chunk_index & result)
+{
+    result.clear();
+    for (auto const & c : chunks)
+        result.insert(result.end(), std::make_pair(c.first, c.second.content_hash()));
+}
+
+void diff_worlds (const chunk_index & from, const chunk_index & to, world_diff & result)
+{
+    result.added.clear();
+    result.removed.clear();
+    result.changed.clear();
+
+    // Both are ordered the same way
+    auto a = from.begin(), b = to.begin();
+    while (a != from.end() || b != to.end())
+    {
+        if (b == to.end() || (a != from.end() && a->first < b->first))
+            result.removed.push_back((a++)->first);
+        else if (a == from.end() || b->first < a->first)
+            result.added.push_back((b++)->first);
+        else
+        {
+            if (a->second != b->second)
+                result.changed.push_back(a->first);
+            ++a;
+            ++b;
+        }
+    }
+}
+
+world_storage::world_storage ( )
+    : running(job_none)
+    , done(false)
+{
+    stats_.kind = job_none;
+    stats_.ok = false;
+    stats_.chunks = stats_.bytes = 0;
+    stats_.pause_ms = stats_.io_ms = 0.0;
+}
+
+world_storage::~world_storage ( )
+{
+    if (worker.joinable())
+        worker.join();
+}
+
+bool world_storage::save (const world & w, const std::string & path)
+{
+    if (busy())
+        return false;
+
+    auto t = clock_type::now();
+    chunks = w.snapshot();
+    pending.pause_ms = milliseconds_since(t);
+
+    this->path = path;
+    start(job_save);
+    return true;
+}
+
+bool world_storage::load (const std::string & path)
+{
+    if (busy())
+        return false;
+
+    this->path = path;
+    start(job_load);
+    return true;
+}
+
+void world_storage::start (job kind)
+{
+    running = kind;
+    pending.kind = kind;
+    done = false;
+
+    worker = std::thread([this, kind]
+    {
+        auto t = clock_type::now();
+        if (kind == job_save)
+        {
+            pending.ok = write_world(chunks, path, pending.bytes);
+            pending.chunks = chunks.size();
+        }
+        else
+        {
+            pending.ok = read_world(path, chunks, pending.bytes);
+            pending.chunks = chunks.size();
+        }
+        pending.io_ms = milliseconds_since(t);
+        done = true;
+    });
+}
+
+world_storage::job world_storage::poll (world & w)
+{
+    if (!busy() || !done)
+        return job_none;
+
+    worker.join();
+    job kind = running;
+    running = job_none;
+
+    if (kind == job_load)
+    {
+        auto t = clock_type::now();
+        if (pending.ok)
+        {
+            w.clear();
+            for (auto const & c : chunks)
+                w.set_chunk(c.first, c.second);
+        }
+        chunks.clear();
+        pending.pause_ms = milliseconds_since(t);
+    }
+    else
+    {
+        // Only after the join: once the snapshot is gone, edits write the
+        // voxels it shared in place, and the saving thread must be done
+        // reading them by then
+        chunks.clear();
+    }
+
+    stats_ = pending;
+    return kind;
+}
@@ -0,0 +1,100 @@
+#ifndef WORLD_FILE_H
+#define WORLD_FILE_H
+
+#include "world.h"
+
+#include <map>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A world file is a header, the write_chunk encoding of every distinct
+// chunk, and an index at the end: the size of every encoding, then the
+// position, content hash and encoding number of every chunk. The last 8
+// bytes are where the index starts. Identical chunks are stored once and
+// share their voxels again when read. Files of the first version, the
+// chunk count followed by the position and encoding of every chunk, can
+// still be read.
+
+bool write_world (const world::chunk_map & chunks, const std::string & path, std::size_t & bytes);
+bool read_world (const std::string & path, world::chunk_map & chunks, std::size_t & bytes);
+
+// The content hash of every chunk
+typedef std::map<chunk_position, std::uint64_t> chunk_index;
+
+// Reads only the index of a file, so it costs as much as the chunk count
+bool read_world_index (const std::string & path, chunk_index & result);
+void index_chunks (const world::chunk_map & chunks, chunk_index & result);
+
+// What turns one world into the other, e.g. the chunks a backup or a
+// client that has the older one needs
+struct world_diff
+{
+    std::vector<chunk_position> added;
+    std::vector<chunk_position> removed;
+    std::vector<chunk_position> changed;
+};
+
+void diff_worlds (const chunk_index & from, const chunk_index & to, world_diff & result);
+
+// Saves and loads on a background thread. A save only stops the caller for
+// the time it takes to snapshot the world; a load is read completely on the
+// other thread and replaces the world in poll().
+class world_storage
+{
+public:
+    enum job
+    {
+        job_none,
+        job_save,
+        job_load
+    };
+
+    struct statistics
+    {
+        job kind;
+        bool ok;
+        std::size_t chunks;
+        std::size_t bytes;
+        // Time the calling thread was stopped: the snapshot for a save,
+        // replacing the world for a load
+        double pause_ms;
+        double io_ms;
+    };
+
+    world_storage ( );
+    ~world_storage ( );
+
+    world_storage (const world_storage &) = delete;
+    world_storage & operator = (const world_storage &) = delete;
+
+    bool busy ( ) const { return running != job_none; }
+
+    // Both return false if another job is still running
+    bool save (const world & w, const std::string & path);
+    bool load (const std::string & path);
+
+    // Completes a finished job and returns what it was; a successful load
+    // replaces the contents of w
+    job poll (world & w);
+
+    // Of the last completed job
+    const statistics & stats ( ) const { return stats_; }
+
+private:
+    job running;
+    std::atomic<bool> done;
+    std::thread worker;
+
+    world::chunk_map chunks;
+    std::string path;
+    statistics pending;
+    statistics stats_;
+
+    void start (job kind);
+};
+
+#endif // WORLD_FILE_H
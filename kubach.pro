@@ -1,18 +1,12 @@
-######################################################################
-# Automatically generated by qmake (2.01a) Tue Jun 18 02:38:08 2013
-######################################################################
+TEMPLATE = subdirs
 
-TEMPLATE = app
-TARGET = kubach
-DEPENDPATH += .
-INCLUDEPATH += .
+# core   - world, generator, physics and meshing; no Qt or OpenGL
+# app    - the game window
+# server - headless binary for simulation and benchmarks
+# bench  - microbenchmarks of the core with machine-readable output
 
-QMAKE_CXXFLAGS += -std=c++0x -O3 -DGL_GLEXT_PROTOTYPES
-QT += core gui opengl
-LIBS += -lGLU
+SUBDIRS = core app server bench
 
-# Input
-HEADERS += cube.h main_window.h player.h \
-    kubeman.h
-SOURCES += cube.cpp main.cpp main_window.cpp player.cpp \
-    kubeman.cpp
+app.depends = core
+server.depends = core
+bench.depends = core
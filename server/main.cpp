@@ -0,0 +1,769 @@
+#include "world.h"
+#include "generator.h"
+#include "heightmap_import.h"
+#include "physics.h"
+#include "mesh.h"
+#include "frame_arena.h"
+#include "simulation.h"
+#include "server.h"
+#include "client.h"
+#include "transport.h"
+#include "world_file.h"
+#include "region.h"
+#include "schematic.h"
+#include "navigation.h"
+#include "crowd.h"
+#include "debris.h"
+#include "memory_stats.h"
+
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <random>
+#include <iostream>
+#include <string>
+
+typedef std::chrono::high_resolution_clock clock_type;
+
+static double milliseconds_since (clock_type::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+struct options
+{
+    int world_size;
+    int ticks;
+    int frames;
+    int listen_port;
+    int clients;
+    double loss;
+    std::string world_path;
+    int memory_log;
+    std::string heightmap;
+    std::string colors;
+    int relief;
+
+    options ( )
+        : world_size(70)
+        , ticks(1000)
+        , frames(100)
+        , listen_port(0)
+        , clients(0)
+        , loss(0.0)
+        , memory_log(0)
+        , relief(32)
+    { }
+};
+
+static void usage (const char * name)
+{
+    std::cerr << "Usage: " << name << " [--size N] [--ticks N] [--frames N]\n"
+        << "       " << name << " --listen [PORT] [--size N]\n"
+        << "       " << name << " --clients N [--ticks N] [--loss F] [--size N]\n"
+        << "  --size N     side of the generated world (default 70)\n"
+        << "  --ticks N    physics or server ticks to simulate (default 1000)\n"
+        << "  --frames N   meshes to build (default 100)\n"
+        << "  --listen     serve the world over UDP (default port " << default_port << ")\n"
+        << "  --clients N  run a server with N simulated clients over loopback\n"
+        << "  --loss F     fraction of loopback packets to drop\n"
+        << "  --world PATH load the world from PATH if it exists, and save it there;\n"
+        << "               the server saves every minute, the benchmark once while editing\n"
+        << "  --memory-log N  print the memory used by each part every N seconds while serving\n"
+        << "  --heightmap PATH  import the world from a binary PGM instead of generating it\n"
+        << "  --colors PATH     colour the top of the imported terrain from a binary PPM\n"
+        << "  --relief N        cubes between the lowest and highest heightmap samples (default 32)\n";
+}
+
+static const int start = -1;
+
+// Imports the heightmap if there is one, or generates the world; returns
+// the side of the square to play in, or 0 if the import failed
+static int generate (world & w, const options & opt)
+{
+    int world_size = opt.world_size;
+    auto t = clock_type::now();
+    if (!opt.heightmap.empty())
+    {
+        worker_pool pool;
+        heightmap_import_options o;
+        o.base_height = start;
+        o.height_range = opt.relief;
+        o.colors = opt.colors;
+
+        heightmap_import_statistics s;
+        bool ok = import_heightmap(w, pool, opt.heightmap, o, s);
+        std::cout << "import: " << s.width << 'x' << s.height << " pixels, " << s.cubes << " cubes in " << s.chunks << " chunks ("
+            << s.solid_chunks << " solid) in " << s.total_ms << " ms; reading " << s.read_ms << " ms, building " << s.build_ms
+            << " ms, inserting " << s.insert_ms << " ms, " << s.peak_band_bytes / 1024 << " KiB of bands\n";
+        if (!ok)
+        {
+            std::cerr << "Failed to import " << opt.heightmap << '\n';
+            return 0;
+        }
+        world_size = std::min(s.width, s.height);
+    }
+    else
+    {
+        generate_world(w, world_size, start, 0.5, 0.25);
+        std::cout << "generate: " << milliseconds_since(t) << " ms, " << w.size() << " cubes in " << w.chunks().size() << " chunks\n";
+    }
+
+    t = clock_type::now();
+    world::sharing_statistics shared = w.share_identical();
+    std::cout << "share: " << shared.shared << " of " << shared.chunks << " chunks identical to another, "
+        << shared.bytes_saved / 1024 << " KiB saved in " << milliseconds_since(t) << " ms\n";
+    return world_size;
+}
+
+// Packs everything but the chunks around the player, then meshes the
+// whole world through the decompression cache
+static void run_storage_benchmark (world & w, const player & pl)
+{
+    std::size_t hot_bytes = w.storage_stats().resident_bytes;
+
+    cube_position eye(std::floor(pl._x + 0.5), std::floor(pl._y + 0.5), std::floor(pl._z + 0.5));
+    auto t = clock_type::now();
+    w.update_residency(chunk_of(eye), 1);
+    double pack_time = milliseconds_since(t);
+
+    world::storage_statistics before = w.storage_stats();
+
+    frame_arena arena;
+    mesh m(arena);
+    t = clock_type::now();
+    build_mesh(w, pl._x, pl._y, pl._z, m);
+    double mesh_time = milliseconds_since(t);
+
+    world::storage_statistics after = w.storage_stats();
+    std::size_t hits = after.cache_hits - before.cache_hits;
+    std::size_t lookups = std::max<std::size_t>(hits + after.cache_misses - before.cache_misses, 1);
+
+    std::cout << "storage: " << hot_bytes / 1024 << " KiB expanded, " << before.resident_bytes / 1024 << " KiB with "
+        << before.cold_chunks << " of " << w.chunks().size() << " chunks packed in " << pack_time << " ms; "
+        << "cold mesh " << mesh_time << " ms, " << hits * 100 / lookups << "% cache hits\n";
+
+    w.update_residency(chunk_of(eye), 1 << 20);
+}
+
+// Drops a block of sand and a block of water onto the terrain and lets
+// them settle
+static void run_simulation_benchmark (world & w, int world_size)
+{
+    worker_pool pool;
+    simulation sim(w, pool);
+
+    int size = std::max(world_size / 4, 2);
+    int x0 = world_size / 2 - size, z0 = world_size / 2 - size / 2;
+    for (int x = 0; x < size; ++x)
+        for (int y = 0; y < size; ++y)
+            for (int z = 0; z < size; ++z)
+            {
+                w.add_cube(cube_position(x0 + x, start + 20 + y, z0 + z), 1.0, 1.2, material_sand);
+                w.add_cube(cube_position(x0 + size + x, start + 20 + y, z0 + z), 3.5, 0.8, material_water);
+            }
+    for (int x = 0; x < 2 * size; ++x)
+        for (int y = 0; y < size; ++y)
+            for (int z = 0; z < size; ++z)
+                sim.activate(cube_position(x0 + x, start + 20 + y, z0 + z));
+
+    const int max_ticks = 2000;
+    std::size_t moves = 0, peak_active = 0;
+    double busy = 0.0, worst = 0.0;
+    int ticks = 0;
+    for (; ticks < max_ticks && !sim.idle(); ++ticks)
+    {
+        auto t = clock_type::now();
+        sim.tick();
+        double elapsed = milliseconds_since(t);
+        busy += elapsed;
+        worst = std::max(worst, elapsed);
+        moves += sim.stats().moves;
+        peak_active = std::max(peak_active, sim.stats().active_cells);
+    }
+
+    std::cout << "simulation: " << 2 * size * size * size << " cells settled in " << ticks << " ticks on " << pool.size() << " threads, "
+        << moves << " moves, " << busy / std::max(ticks, 1) << " ms/tick average, " << worst << " ms worst, "
+        << peak_active << " active cells at most\n";
+}
+
+// Random boxes and spheres, counted through the block summaries and by
+// looking at every cube of the world
+static void run_query_benchmark (const world & w, int world_size)
+{
+    const int queries = 200;
+
+    std::default_random_engine random;
+    std::uniform_int_distribution<int> coord(0, world_size), size(2, 16);
+    std::vector<region> regions;
+    for (int i = 0; i < queries; ++i)
+    {
+        cube_position p(coord(random), coord(random) / 4 - 4, coord(random));
+        int s = size(random);
+        if (i % 2)
+            regions.push_back(region::box(p, cube_position(p.x + s, p.y + s, p.z + s)));
+        else
+            regions.push_back(region::sphere(p.x, p.y, p.z, s * 0.5));
+    }
+
+    std::size_t found = 0;
+    auto t = clock_type::now();
+    for (region const & r : regions)
+        found += count_cubes(w, r);
+    double query_time = milliseconds_since(t);
+
+    std::size_t scanned = 0;
+    t = clock_type::now();
+    for (region const & r : regions)
+        w.for_each_cube([&](cube_position p, const voxel &)
+        {
+            if (r.contains(p))
+                ++scanned;
+        });
+    double scan_time = milliseconds_since(t);
+
+    // Faces colored like the generator's ground
+    std::size_t colored = 0;
+    cube_filter ground = cube_filter::colored(-1, 0.5, 0.25, 0.01);
+    t = clock_type::now();
+    for (region const & r : regions)
+        colored += count_cubes(w, r, ground);
+    double colored_time = milliseconds_since(t);
+
+    std::cout << "queries: " << queries << " regions, " << found << " cubes (" << scanned << " by scanning), "
+        << query_time * 1000.0 / queries << " us/query vs " << scan_time * 1000.0 / queries << " us/scan, "
+        << found / std::max(query_time * 0.001, 1e-9) / 1e6 << " M cubes/s; "
+        << colored << " with a ground face in " << colored_time * 1000.0 / queries << " us/query\n";
+}
+
+// Copies the middle of the world and stamps it elsewhere, compared with
+// placing the same cells one by one
+static void run_schematic_benchmark (world & w, int world_size)
+{
+    int half = std::max(world_size / 4, 2);
+    cube_position a(world_size / 2 - half, start - 4, world_size / 2 - half);
+    cube_position b(world_size / 2 + half - 1, start + 12, world_size / 2 + half - 1);
+
+    schematic s;
+    auto t = clock_type::now();
+    copy_schematic(w, a, b, s);
+    double copy_time = milliseconds_since(t);
+
+    byte_writer out;
+    write_schematic(out, s);
+
+    t = clock_type::now();
+    schematic turned = rotated(s, 1);
+    double rotate_time = milliseconds_since(t);
+
+    // Both write the turned copy back over the original, so they find the
+    // same chunks already there
+    const int stamps = 10;
+    t = clock_type::now();
+    for (int i = 0; i < stamps; ++i)
+        stamp(w, turned, a);
+    double stamp_time = milliseconds_since(t) / stamps;
+
+    cube_position origin = a;
+    t = clock_type::now();
+    for (int x = 0; x < turned.size_x; ++x)
+        for (int y = 0; y < turned.size_y; ++y)
+            for (int z = 0; z < turned.size_z; ++z)
+            {
+                voxel const & v = turned.palette[turned.cells[(static_cast<std::size_t>(x) * turned.size_y + y) * turned.size_z + z]];
+                cube_position p(origin.x + x, origin.y + y, origin.z + z);
+                if (!v.solid)
+                    w.remove_cube(p);
+                else
+                {
+                    w.add_cube(p, v.hue[0], v.brightness[0], v.material);
+                    for (int f = 1; f < 6; ++f)
+                        w.paint(p, f, v.hue[f], v.brightness[f]);
+                }
+            }
+    double single_time = milliseconds_since(t);
+
+    std::cout << "schematic: " << s.volume() << " cells, " << s.palette.size() << " distinct, "
+        << out.size() / 1024 << " KiB encoded (" << s.volume() * sizeof(voxel) / 1024 << " KiB raw); copy " << copy_time
+        << " ms, rotate " << rotate_time << " ms, stamp " << stamp_time << " ms ("
+        << s.volume() / std::max(stamp_time * 0.001, 1e-9) / 1e6 << " M cells/s) vs " << single_time << " ms cell by cell\n";
+}
+
+// Saves while the world keeps changing, by hand and by sand falling on
+// the workers, then loads the file back
+static void run_save_benchmark (world & w, const std::string & path)
+{
+    worker_pool pool(4);
+    simulation sim(w, pool);
+    for (int x = 0; x < 32; ++x)
+        for (int z = 0; z < 32; ++z)
+        {
+            w.add_cube(cube_position(x, start + 40, z), 1.0, 1.2, material_sand);
+            sim.activate(cube_position(x, start + 40, z));
+        }
+
+    chunk_index before;
+    index_chunks(w.chunks(), before);
+
+    // Unpacked chunks, as recently edited ones are, share their voxels
+    // with the save; one of them is written for the first time each round
+    std::vector<chunk_position> untouched;
+    for (auto const & c : w.chunks())
+        if (untouched.size() < 128)
+        {
+            w.thaw(c.first);
+            untouched.push_back(c.first);
+        }
+    std::size_t touched = 0;
+
+    world_storage storage;
+    storage.save(w, path);
+
+    // The snapshot must not see these
+    std::size_t saved_size = w.size();
+    int edits = 0, ticks = 0;
+    while (storage.busy() && storage.poll(w) == world_storage::job_none)
+    {
+        w.add_cube(cube_position(edits % 64, 40, edits / 64 % 64), 0.0, 1.0);
+        ++edits;
+        if (touched < untouched.size())
+        {
+            chunk_position p = untouched[touched++];
+            w.add_cube(cube_position(p.x * chunk_size + 8, p.y * chunk_size + 8, p.z * chunk_size + 8), 0.0, 1.0);
+            ++edits;
+        }
+        if (!sim.idle())
+        {
+            sim.tick();
+            ++ticks;
+        }
+    }
+
+    world_storage::statistics s = storage.stats();
+    std::cout << "save: " << s.chunks << " chunks, " << s.bytes / 1024 << " KiB in " << s.io_ms << " ms ("
+        << s.bytes / 1048576.0 / std::max(s.io_ms * 0.001, 1e-6) << " MiB/s), " << s.pause_ms << " ms pause, "
+        << edits << " edits and " << ticks << " simulation ticks meanwhile" << (s.ok ? "" : ", failed") << '\n';
+
+    // The edits made while saving, found from the hashes alone
+    chunk_index saved, current;
+    world_diff diff;
+    auto t = clock_type::now();
+    bool indexed = read_world_index(path, saved);
+    double index_time = milliseconds_since(t);
+
+    world_diff leaked;
+    diff_worlds(before, saved, leaked);
+    std::size_t leaked_chunks = leaked.added.size() + leaked.removed.size() + leaked.changed.size();
+    std::cout << "snapshot: " << leaked_chunks << " chunks differ from the world when the save started\n";
+
+    t = clock_type::now();
+    index_chunks(w.chunks(), current);
+    diff_worlds(saved, current, diff);
+    double diff_time = milliseconds_since(t);
+    std::cout << "diff: " << diff.added.size() << " added, " << diff.removed.size() << " removed, " << diff.changed.size()
+        << " changed chunks since the save; index read in " << index_time << " ms, compared in " << diff_time << " ms"
+        << (indexed ? "" : ", failed") << '\n';
+
+    world loaded;
+    storage.load(path);
+    while (storage.poll(loaded) == world_storage::job_none)
+        std::this_thread::yield();
+
+    s = storage.stats();
+    std::cout << "load: " << s.chunks << " chunks, " << loaded.size() << " cubes (" << saved_size << " saved) in "
+        << s.io_ms << " ms, " << s.pause_ms << " ms to install" << (s.ok ? "" : ", failed") << '\n';
+}
+
+// Builds the navigation graph, plans routes between random places, and
+// lets a crowd walk with a fixed planning budget per tick
+static void run_path_benchmark (world & w, int world_size)
+{
+    nav_graph graph;
+    auto t = clock_type::now();
+    graph.update(w);
+    double build_time = milliseconds_since(t);
+    nav_graph::statistics s = graph.stats();
+
+    std::default_random_engine random;
+    std::uniform_int_distribution<int> coordinate(0, world_size - 1);
+    int queries = 0, found = 0;
+    std::size_t expanded = 0, steps = 0;
+    double route_time = 0.0, refine_time = 0.0;
+    std::vector<cube_position> route, path;
+    for (int i = 0; i < 200; ++i)
+    {
+        int x0 = coordinate(random), z0 = coordinate(random), x1 = coordinate(random), z1 = coordinate(random), y0, y1;
+        if (!w.top(x0, z0, y0) || !w.top(x1, z1, y1))
+            continue;
+
+        cube_position from(x0, y0 + 1, z0), to(x1, y1 + 1, z1);
+        if (!graph.walkable(from) || !graph.walkable(to))
+            continue;
+
+        ++queries;
+        t = clock_type::now();
+        bool ok = graph.find_route(from, to, route);
+        route_time += milliseconds_since(t);
+        expanded += graph.stats().expanded;
+        if (!ok)
+            continue;
+
+        ++found;
+        path.clear();
+        t = clock_type::now();
+        for (std::size_t k = 1; k < route.size(); ++k)
+            graph.refine(route[k - 1], route[k], path);
+        refine_time += milliseconds_since(t);
+        steps += path.size();
+    }
+
+    w.add_cube(cube_position(world_size / 2, start + 12, world_size / 2), 0.0, 1.0);
+    t = clock_type::now();
+    std::size_t rebuilt = graph.update(w);
+    double edit_time = milliseconds_since(t);
+    w.remove_cube(cube_position(world_size / 2, start + 12, world_size / 2));
+
+    const int walkers = 500, ticks = 300;
+    const double budget_ms = 2.0;
+    crowd people;
+    people.spawn(w, world_size * 0.5, world_size * 0.5, walkers, world_size / 2);
+    double tick_sum = 0.0, tick_max = 0.0;
+    for (int i = 0; i < ticks; ++i)
+    {
+        t = clock_type::now();
+        people.tick(w, 0.01, budget_ms);
+        double tick_time = milliseconds_since(t);
+        tick_sum += tick_time;
+        tick_max = std::max(tick_max, tick_time);
+    }
+
+    std::cout << "paths: " << s.columns << " columns, " << s.nodes << " nodes, " << s.edges << " edges in " << build_time << " ms, "
+        << edit_time << " ms for " << rebuilt << " columns after an edit; " << found << " of " << queries << " routes, "
+        << route_time * 1000.0 / std::max(queries, 1) << " us/route with " << expanded / std::max(queries, 1) << " nodes expanded, "
+        << refine_time * 1000.0 / std::max(found, 1) << " us to refine " << steps / std::max(found, 1) << " steps; "
+        << people.size() << " walkers " << tick_sum / ticks << " ms/tick, " << tick_max << " ms max with a " << budget_ms << " ms budget\n";
+}
+
+// Blows a hole into the middle of the world, then adds falling particles
+// until there are 100k and lets them land
+static void run_explosion_benchmark (world & w, int world_size)
+{
+    const double radius = 6.0;
+    const std::size_t particles = 100000;
+
+    double x = world_size * 0.5, z = world_size * 0.5;
+    int top = start;
+    w.top(x, z, top);
+
+    std::vector<std::pair<cube_position, voxel>> removed;
+    auto t = clock_type::now();
+    w.remove_sphere(x, top, z, radius, removed);
+    double remove_time = milliseconds_since(t);
+
+    debris d;
+    t = clock_type::now();
+    d.spawn(removed, x, top, z, 8.0);
+    double spawn_time = milliseconds_since(t);
+    std::size_t from_cubes = d.size();
+
+    std::default_random_engine random;
+    std::uniform_real_distribution<float> coordinate(0.0f, world_size), height(0.0f, 20.0f), speed(-2.0f, 2.0f);
+    while (d.size() < particles)
+        d.add(coordinate(random), top + height(random), coordinate(random), speed(random), speed(random), speed(random), 0xffffffffu, 10.0f);
+
+    const int ticks = 120;
+    std::size_t crossings = 0, collisions = 0;
+    double busy = 0.0, worst = 0.0;
+    for (int i = 0; i < ticks; ++i)
+    {
+        t = clock_type::now();
+        d.tick(w, 1.0 / 60.0);
+        double elapsed = milliseconds_since(t);
+        busy += elapsed;
+        worst = std::max(worst, elapsed);
+        crossings += d.stats().crossings;
+        collisions += d.stats().collisions;
+    }
+
+    std::cout << "explosion: " << removed.size() << " cubes removed in " << remove_time << " ms, " << from_cubes << " particles spawned in "
+        << spawn_time << " ms; " << particles << " particles " << busy / ticks << " ms/tick, " << worst << " ms max, "
+        << crossings / ticks << " cell crossings and " << collisions / ticks << " collisions per tick, " << d.size() << " left\n";
+}
+
+static int run_benchmark (const options & opt)
+{
+    world w;
+    int world_size = generate(w, opt);
+    if (world_size == 0)
+        return 1;
+
+    player pl;
+    pl.x = world_size * 0.5;
+    pl.z = world_size * 0.5;
+    pl.y = standing_height(w, pl.x, pl.z, start + 10);
+    pl.init();
+    pl.move_forward = 1;
+
+    // Fixed 10 ms step, walking in a wide circle
+    const double dt = 0.01;
+
+    auto t = clock_type::now();
+    int on_surface = 0;
+    for (int i = 0; i < opt.ticks; ++i)
+    {
+        pl.alpha += 0.002;
+        advance(pl, dt, true);
+        if (collide(pl, w))
+            ++on_surface;
+    }
+    double physics_time = milliseconds_since(t);
+    std::cout << "physics: " << opt.ticks << " ticks, " << physics_time * 1000.0 / std::max(opt.ticks, 1) << " us/tick, "
+        << on_surface << " on surface, final position " << pl.x << ' ' << pl.y << ' ' << pl.z << '\n';
+
+    frame_arena arena;
+    std::size_t faces = 0;
+
+    t = clock_type::now();
+    for (int i = 0; i < opt.frames; ++i)
+    {
+        arena.reset();
+        mesh m(arena);
+        build_mesh(w, pl._x, pl._y, pl._z, m);
+        faces = m.faces;
+    }
+    double mesh_time = milliseconds_since(t);
+    arena.reset();
+    std::cout << "mesh: " << faces << " faces, " << mesh_time / std::max(opt.frames, 1) << " ms/build, "
+        << arena.stats().last_frame_bytes / 1024 << " KiB/frame, "
+        << arena.stats().last_frame_heap_allocations << " heap allocations in the last frame\n";
+
+    mesh_cache cache;
+    t = clock_type::now();
+    std::size_t rebuilt = cache.update(w);
+    double full_time = milliseconds_since(t);
+    std::size_t copied = cache.reused();
+
+    w.add_cube(cube_position(pl._x, pl._y + 3, pl._z), 0.0, 1.0);
+    t = clock_type::now();
+    std::size_t rebuilt_after_edit = cache.update(w);
+    double edit_time = milliseconds_since(t);
+    std::cout << "mesh cache: " << cache.faces() << " faces, " << full_time << " ms for all " << rebuilt << " chunks ("
+        << copied << " copied from identical ones), " << edit_time << " ms for " << rebuilt_after_edit << " after an edit\n";
+    dump_memory_stats(std::cout);
+
+    run_query_benchmark(w, world_size);
+    run_storage_benchmark(w, pl);
+    run_simulation_benchmark(w, world_size);
+    run_schematic_benchmark(w, world_size);
+    run_path_benchmark(w, world_size);
+    run_explosion_benchmark(w, world_size);
+    if (!opt.world_path.empty())
+        run_save_benchmark(w, opt.world_path);
+    return 0;
+}
+
+static void place_spawn (server & srv, const world & srv_world, int world_size)
+{
+    srv.spawn_x = world_size * 0.5;
+    srv.spawn_z = world_size * 0.5;
+    srv.spawn_y = standing_height(srv_world, srv.spawn_x, srv.spawn_z, start + 10);
+}
+
+static int run_server (const options & opt)
+{
+    udp_transport net(opt.listen_port);
+    if (!net.is_open())
+    {
+        std::cerr << "Failed to open UDP port " << opt.listen_port << '\n';
+        return 1;
+    }
+
+    world w;
+    world_storage storage;
+    if (!opt.world_path.empty() && storage.load(opt.world_path))
+    {
+        while (storage.poll(w) == world_storage::job_none)
+            std::this_thread::yield();
+        if (storage.stats().ok)
+            std::cout << "loaded " << opt.world_path << ": " << w.size() << " cubes in " << w.chunks().size() << " chunks\n";
+    }
+    int world_size = opt.world_size;
+    if (w.chunks().empty())
+        world_size = generate(w, opt);
+    if (world_size == 0)
+        return 1;
+
+    server srv(net, w);
+    place_spawn(srv, w, world_size);
+
+    std::cout << "listening on port " << opt.listen_port << '\n';
+
+    const auto tick = std::chrono::microseconds(1000000 / tick_rate);
+    auto next = clock_type::now();
+
+    double busy = 0.0;
+    std::size_t sent = 0;
+    for (;;)
+    {
+        auto t = clock_type::now();
+        srv.tick();
+        busy += milliseconds_since(t);
+        sent += srv.stats().bytes_sent;
+
+        if (srv.current_tick() % (5 * tick_rate) == 0)
+        {
+            std::cout << "tick " << srv.current_tick() << ": " << srv.client_count() << " clients, "
+                << busy / (5 * tick_rate) << " ms/tick, " << sent / 5 / 1024 << " KiB/s sent\n";
+            busy = 0.0;
+            sent = 0;
+        }
+
+        if (storage.poll(w) == world_storage::job_save)
+        {
+            world_storage::statistics const & s = storage.stats();
+            std::cout << "saved " << s.chunks << " chunks, " << s.bytes / 1024 << " KiB in " << s.io_ms << " ms, "
+                << s.pause_ms << " ms pause" << (s.ok ? "" : ", failed") << '\n';
+        }
+        if (!opt.world_path.empty() && srv.current_tick() % (60 * tick_rate) == 0)
+            storage.save(w, opt.world_path);
+        if (opt.memory_log > 0 && srv.current_tick() % (opt.memory_log * tick_rate) == 0)
+            dump_memory_stats(std::cout);
+
+        next += tick;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+static int run_load_test (const options & opt)
+{
+    world w;
+    int world_size = generate(w, opt);
+    if (world_size == 0)
+        return 1;
+
+    loopback_network network;
+    network.loss = opt.loss;
+
+    loopback_transport server_transport(network);
+    server srv(server_transport, w);
+    place_spawn(srv, w, world_size);
+
+    // Only the first client keeps a replica of the world, to check it
+    world replica;
+    std::vector<std::unique_ptr<loopback_transport>> transports;
+    std::vector<std::unique_ptr<client>> clients;
+    for (int i = 0; i < opt.clients; ++i)
+    {
+        transports.emplace_back(new loopback_transport(network));
+        clients.emplace_back(new client(*transports.back(), server_transport.address(), i == 0 ? &replica : nullptr));
+    }
+
+    const double dt = 1.0 / tick_rate;
+
+    double busy = 0.0, worst = 0.0;
+    std::size_t snapshot_bytes = 0, chunk_bytes = 0;
+    for (int tick = 0; tick < opt.ticks; ++tick)
+    {
+        for (int i = 0; i < opt.clients; ++i)
+        {
+            player_input input;
+            input.move_forward = 1;
+            input.move_sideward = 0;
+            input.move_upward = 0;
+            input.alpha = i * 0.7 + tick * 0.1;
+            input.beta = 0.0;
+            input.jump = (tick + i) % 40 == 0;
+            input.gravity = true;
+
+            clients[i]->update(dt, input);
+
+            // Every other cube is sand, which the server lets fall
+            kubeman self;
+            if (i == 0 && tick % 10 == 0 && !clients[i]->loading() && clients[i]->own_state(self))
+                clients[i]->add_cube(cube_position(self.x + 3, self.y + 2, self.z), 3.0, 1.0, (tick / 10) % 2 ? material_sand : material_cube);
+        }
+
+        auto t = clock_type::now();
+        srv.tick();
+        double elapsed = milliseconds_since(t);
+        busy += elapsed;
+        worst = std::max(worst, elapsed);
+        snapshot_bytes += srv.stats().snapshot_bytes;
+        chunk_bytes += srv.stats().chunk_bytes;
+    }
+
+    double seconds = opt.ticks * dt;
+    std::cout << "server: " << srv.client_count() << " clients, " << busy / std::max(opt.ticks, 1) << " ms/tick average, "
+        << worst << " ms worst, " << tick_rate << " ticks/s budget " << 1000.0 / tick_rate << " ms\n";
+    std::cout << "traffic: " << snapshot_bytes / seconds / std::max(opt.clients, 1) << " snapshot bytes/s per client, "
+        << chunk_bytes / 1024 << " KiB of chunk data\n";
+
+    if (!clients.empty())
+    {
+        std::vector<kubeman> others;
+        clients[0]->remote_players(others);
+        std::size_t differ = 0;
+        w.for_each_cube([&replica, &differ](cube_position p, voxel const & v)
+        {
+            voxel const * r = replica.find(p);
+            if (!r || r->material != v.material)
+                ++differ;
+        });
+
+        std::cout << "client 0: " << clients[0]->chunks_received() << '/' << clients[0]->chunks_expected() << " chunks, "
+            << replica.size() << " cubes (server has " << w.size() << ", " << differ << " differ), " << others.size() << " remote players\n";
+    }
+    return 0;
+}
+
+int main (int argc, char ** argv)
+{
+    options opt;
+    bool listen = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            opt.world_size = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+            opt.ticks = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            opt.frames = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--listen") == 0)
+        {
+            listen = true;
+            opt.listen_port = default_port;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                opt.listen_port = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+            opt.clients = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--loss") == 0 && i + 1 < argc)
+            opt.loss = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--world") == 0 && i + 1 < argc)
+            opt.world_path = argv[++i];
+        else if (std::strcmp(argv[i], "--memory-log") == 0 && i + 1 < argc)
+            opt.memory_log = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--heightmap") == 0 && i + 1 < argc)
+            opt.heightmap = argv[++i];
+        else if (std::strcmp(argv[i], "--colors") == 0 && i + 1 < argc)
+            opt.colors = argv[++i];
+        else if (std::strcmp(argv[i], "--relief") == 0 && i + 1 < argc)
+            opt.relief = std::atoi(argv[++i]);
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (listen)
+        return run_server(opt);
+    if (opt.clients > 0)
+        return run_load_test(opt);
+    return run_benchmark(opt);
+}
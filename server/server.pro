@@ -0,0 +1,13 @@
+TEMPLATE = app
+TARGET = kubach-server
+CONFIG += console
+CONFIG -= qt app_bundle
+DEPENDPATH += .
+INCLUDEPATH += .
+
+QMAKE_CXXFLAGS += -std=c++0x -O3
+
+include(../core/core.pri)
+
+# Input
+SOURCES += main.cpp